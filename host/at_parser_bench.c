@@ -0,0 +1,194 @@
+/*******************************************************************************
+* Title                 :   AT tokenizer benchmark
+* Filename              :   at_parser_bench.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Feeds recorded modem transcripts through at_parser.c
+*                           in UART-sized chunks and reports MB/s, next to the
+*                           accumulate-and-strstr scan it replaced.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "at_parser.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define BENCH_INPUT_SIZE                    (1024U * 1024U) /* Transcript repeated up to this size */
+#define BENCH_CHUNK_SIZE                    (64U)           /* Bytes per UART wake-up */
+#define BENCH_MIN_TIME_S                    (0.5)
+#define BENCH_MAILBOX_SIZE                  (1024U)         /* AT_BUFFER_SIZE of the strstr scan */
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+typedef struct
+{
+    const char *file;
+    const char *expected;           // What sim7600.c waits for on this traffic
+} bench_transcript_t;
+
+typedef struct
+{
+    unsigned long results;          // Expected/error results seen
+    unsigned long urcs;
+} bench_count_t;
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static const bench_transcript_t bench_default[] = {
+    { BENCH_TRANSCRIPT_DIR "/at_status.log", "OK" },
+    { BENCH_TRANSCRIPT_DIR "/http_get.log", "#XHTTPCRSP:0,1" },
+};
+
+static const char* const bench_urc_prefix[] = {"#XHTTPCRSP:", "+CEREG:", "+CSCON:", "%CESQ:"};
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static double __bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Transcript repeated until BENCH_INPUT_SIZE bytes
+static uint8_t *__bench_load(const char *file, size_t *size)
+{
+    FILE *fp = fopen(file, "rb");
+    if (NULL == fp)
+        return NULL;
+    uint8_t record[64 * 1024];
+    size_t record_len = fread(record, 1, sizeof(record), fp);
+    fclose(fp);
+    if (0 == record_len)
+        return NULL;
+
+    size_t repeat = (BENCH_INPUT_SIZE + record_len - 1) / record_len;
+    uint8_t *input = malloc(repeat * record_len);
+    if (NULL == input)
+        return NULL;
+    for (size_t idx = 0; idx < repeat; idx++)
+        memcpy(&input[idx * record_len], record, record_len);
+    *size = repeat * record_len;
+    return input;
+}
+
+static void __bench_parser(at_parser_t *parser, const uint8_t *input, size_t size, bench_count_t *count)
+{
+    at_parser__reset(parser);
+    for (size_t offset = 0; offset < size; offset += BENCH_CHUNK_SIZE)
+    {
+        uint16_t chunk_len = (size - offset < BENCH_CHUNK_SIZE) ? (uint16_t)(size - offset) : BENCH_CHUNK_SIZE;
+        for (uint16_t done = 0; done < chunk_len; )
+        {
+            at_match_t match;
+            done += at_parser__feed(parser, &input[offset + done], chunk_len - done, &match);
+            if (AT_TOKEN_URC == match.token)
+                count->urcs++;
+            else if ((AT_TOKEN_NONE != match.token) && (AT_TOKEN_OK != match.token))
+                count->results++;
+        }
+    }
+}
+
+// The scan __sim7600__wait_4response() used to do: append each chunk, strstr the data of the wait for "ERR" and the expected text
+static void __bench_strstr(const char *expected, const uint8_t *input, size_t size, bench_count_t *count)
+{
+    static char mailbox[BENCH_MAILBOX_SIZE + 1];
+    size_t mailbox_len = 0;
+    for (size_t offset = 0; offset < size; offset += BENCH_CHUNK_SIZE)
+    {
+        size_t chunk_len = (size - offset < BENCH_CHUNK_SIZE) ? size - offset : BENCH_CHUNK_SIZE;
+        if (mailbox_len + chunk_len > BENCH_MAILBOX_SIZE)
+            mailbox_len = 0; // Buffer full: the wait failed, the next command starts a new one
+        memcpy(&mailbox[mailbox_len], &input[offset], chunk_len);
+        mailbox_len += chunk_len;
+        mailbox[mailbox_len] = '\0';
+        if ((strstr(mailbox, "ERR") != NULL) || (strstr(mailbox, expected) != NULL))
+        {
+            count->results++;
+            mailbox_len = 0; // Wait finished, the next command flushes the mailbox
+        }
+    }
+}
+
+static int __bench_run(const bench_transcript_t *transcript)
+{
+    size_t size = 0;
+    uint8_t *input = __bench_load(transcript->file, &size);
+    if (NULL == input)
+    {
+        fprintf(stderr, "Cannot read %s\n", transcript->file);
+        return -1;
+    }
+
+    at_parser_t parser;
+    at_parser__init(&parser);
+    for (size_t idx = 0; idx < sizeof(bench_urc_prefix) / sizeof(bench_urc_prefix[0]); idx++)
+        at_parser__add(&parser, bench_urc_prefix[idx], AT_TOKEN_URC, AT_PARSER_LINE_START);
+    if (at_parser__expect(&parser, transcript->expected) != 0)
+    {
+        fprintf(stderr, "Cannot compile \"%s\"\n", transcript->expected);
+        free(input);
+        return -1;
+    }
+
+    bench_count_t parser_count = {0}, strstr_count = {0};
+    unsigned passes = 0;
+    double start = __bench_now(), elapsed;
+    do
+    {
+        __bench_parser(&parser, input, size, &parser_count);
+        passes++;
+    } while ((elapsed = __bench_now() - start) < BENCH_MIN_TIME_S);
+    double parser_mbps = (double)size * passes / elapsed / 1e6;
+    unsigned long parser_results = parser_count.results / passes;
+    unsigned long parser_urcs = parser_count.urcs / passes;
+
+    passes = 0;
+    start = __bench_now();
+    do
+    {
+        __bench_strstr(transcript->expected, input, size, &strstr_count);
+        passes++;
+    } while ((elapsed = __bench_now() - start) < BENCH_MIN_TIME_S);
+    double strstr_mbps = (double)size * passes / elapsed / 1e6;
+
+    printf("%s (%zu B, %u B chunks, expect \"%s\")\n", transcript->file, size, BENCH_CHUNK_SIZE, transcript->expected);
+    printf("  at_parser   %9.1f MB/s  %8lu results %8lu URCs\n", parser_mbps, parser_results, parser_urcs);
+    printf("  strstr      %9.1f MB/s  %8lu results\n", strstr_mbps, strstr_count.results / passes);
+    free(input);
+    return 0;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+// Usage: at_parser_bench [transcript expected]...
+int main(int argc, char **argv)
+{
+    int ret = 0;
+    if (argc > 1)
+    {
+        for (int idx = 1; idx + 1 < argc; idx += 2)
+        {
+            bench_transcript_t transcript = { .file = argv[idx], .expected = argv[idx + 1] };
+            ret |= __bench_run(&transcript);
+        }
+        return (0 == ret) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    for (size_t idx = 0; idx < sizeof(bench_default) / sizeof(bench_default[0]); idx++)
+        ret |= __bench_run(&bench_default[idx]);
+    return (0 == ret) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
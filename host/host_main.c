@@ -0,0 +1,522 @@
+/*******************************************************************************
+* Title                 :   LTE driver host runner
+* Filename              :   host_main.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Runs hal_uart.c and sim7600.c unmodified on Linux.
+*                           The modem UART is a socketpair served by sim_peer.c,
+*                           or with --pty a pseudo-terminal for an external peer.
+*                           With -m the link runs multiplexed (GSM 07.10).
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "uart_posix.h"
+#include "ota_posix.h"
+#include "sim_peer.h"
+#include "hal.h"
+#include "sim7600.h"
+#include "lte_ota.h"
+#include "cmux.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define LTE_HOST_UART_PORT                  (UART_NUM_2)    /* AT_DEFAULT_UART_PORT in sim7600.c */
+#define LTE_HOST_MAX_BAUDRATE               (921600UL)
+#define LTE_HOST_DEFAULT_ITERATIONS         (100U)
+#define LTE_HOST_MAX_TASKS                  (8U)
+#define LTE_HOST_OP_COUNT                   (4U)
+#define LTE_HOST_RECORD_LEN                 (26U)           /* {"seq":00000000,"t":21.5}\n */
+#define LTE_HOST_POST_RECORDS               (300U)
+#define LTE_HOST_DOWNLOAD_SIZE              (20000U)        /* Binary body of GET /bin/<size> */
+#define LTE_HOST_SOCK_MESSAGES              (50U)           /* Telemetry records sent over one TCP socket */
+#define LTE_HOST_SOCK_TIMEOUT_MS            (5000U)
+#define LTE_HOST_OTA_SIZE                   (200000U)       /* Firmware image of GET /bin/<size> */
+#define LTE_HOST_OTA_URL                    "example.com/bin/200000?cut=70000"  /* First transfer drops after 70000 B */
+#define LTE_HOST_OTA_WRITE_US_PER_KB        (250U)          /* Flash write speed, about 4 MB/s */
+#define LTE_HOST_POLL_PERIOD_MS             (100U)          /* Signal query period of the supervisory task during the OTA */
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+typedef struct
+{
+    const char *name;
+    long (*call)(void);
+    uint32_t fails;
+    int64_t min_us;
+    int64_t max_us;
+    int64_t total_us;
+} lte_host_op_t;
+
+// One application task sharing the modem with the others
+typedef struct
+{
+    lte_host_op_t ops[LTE_HOST_OP_COUNT];
+    uint32_t iterations;
+    SemaphoreHandle_t done;
+} lte_host_worker_t;
+
+// sim7600__httpsGET_stream() receiver: nothing is kept but a running check of the bytes
+typedef struct
+{
+    int64_t start_us;
+    int64_t first_chunk_us;
+    uint32_t chunks;
+    uint32_t bytes;
+    uint32_t line_ends;
+} lte_host_stream_t;
+
+// sim7600__sock_open() receiver: counts the echoed telemetry
+typedef struct
+{
+    uint32_t bytes;
+    uint32_t expected;
+    bool closed;
+    SemaphoreHandle_t done;
+} lte_host_sock_t;
+
+// Supervisory task querying the signal while a transfer runs
+typedef struct
+{
+    volatile bool stop;
+    uint32_t answered;
+    uint32_t fails;
+    int64_t max_us;
+    SemaphoreHandle_t done;
+} lte_host_poll_t;
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static volatile uint32_t lte_host_cereg_count = 0;
+static lte_host_worker_t lte_host_worker[LTE_HOST_MAX_TASKS];
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static long __op_rssi(void)     { return sim7600__get_rssi(); }
+static long __op_connected(void) { return sim7600__connected(); }
+static long __op_sim(void)      { return sim7600__get_SimPresent(); }
+static long __op_time(void)     { return sim7600__get_time(); }
+
+// Runs on the driver's reader task
+static void __on_cereg(const char *line, uint16_t len, void *ctx)
+{
+    (void)line;
+    (void)len;
+    (void)ctx;
+    lte_host_cereg_count++;
+}
+
+// Completion of the asynchronous AT+CESQ, runs on the driver's engine task
+static void __on_cesq_done(sim7600_cmd_t *cmd, int status, char *resp, uint16_t resp_len, void *ctx)
+{
+    (void)cmd;
+    printf("Async AT+CESQ: %s, %u B \"%.*s\"\n", (SUCCESS == status) ? "ok" : "failed", resp_len,
+           (int)strcspn(resp + strspn(resp, "\r\n"), "\r\n"), resp + strspn(resp, "\r\n"));
+    xSemaphoreGive((SemaphoreHandle_t)ctx);
+}
+
+// Streamed HTTPS response piece, runs on the driver's reader task
+static int __on_http_chunk(const uint8_t *data, uint16_t len, void *ctx)
+{
+    lte_host_stream_t *stream = (lte_host_stream_t *)ctx;
+    if (0 == stream->chunks++)
+        stream->first_chunk_us = esp_timer_get_time() - stream->start_us;
+    for (uint16_t idx = 0; idx < len; idx++)
+        stream->line_ends += ('\n' == data[idx]);
+    stream->bytes += len;
+    return SUCCESS;
+}
+
+// Batched sensor records generated on the fly, runs on the driver's engine task
+static int __read_http_body(uint8_t *buf, uint16_t size, void *ctx)
+{
+    uint32_t *record = (uint32_t *)ctx;
+    uint16_t len = 0;
+    char line[LTE_HOST_RECORD_LEN + 1];
+    while ((uint32_t)(size - len) >= LTE_HOST_RECORD_LEN)
+    {
+        snprintf(line, sizeof(line), "{\"seq\":%08" PRIu32 ",\"t\":21.5}\n", (*record)++ % 100000000U);
+        memcpy(&buf[len], line, LTE_HOST_RECORD_LEN);
+        len += LTE_HOST_RECORD_LEN;
+    }
+    return len;
+}
+
+// Socket data, runs on the driver's reader task
+static void __on_sock_rx(int sock, const uint8_t *data, uint16_t len, void *ctx)
+{
+    lte_host_sock_t *rx = (lte_host_sock_t *)ctx;
+    (void)sock;
+    (void)data;
+    rx->closed |= (0 == len);
+    if ((rx->bytes < rx->expected) && (rx->bytes + len >= rx->expected))
+        xSemaphoreGive(rx->done);
+    rx->bytes += len;
+}
+
+static void __worker_task(void *pvParameters)
+{
+    lte_host_worker_t *worker = (lte_host_worker_t *)pvParameters;
+    for (uint32_t round = 0; round < worker->iterations; round++)
+    {
+        for (size_t op = 0; op < LTE_HOST_OP_COUNT; op++)
+        {
+            int64_t start_us = esp_timer_get_time();
+            long ret = worker->ops[op].call();
+            int64_t elapsed_us = esp_timer_get_time() - start_us;
+            if (FAILURE == ret) // RSSI is a negative dBm value, only -1 is an error
+                worker->ops[op].fails++;
+            worker->ops[op].total_us += elapsed_us;
+            worker->ops[op].min_us = (elapsed_us < worker->ops[op].min_us) ? elapsed_us : worker->ops[op].min_us;
+            worker->ops[op].max_us = (elapsed_us > worker->ops[op].max_us) ? elapsed_us : worker->ops[op].max_us;
+        }
+    }
+    xSemaphoreGive(worker->done);
+    vTaskDelete(NULL);
+}
+
+// AT+CESQ every LTE_HOST_POLL_PERIOD_MS at SIM7600_PRIO_HIGH until told to stop, the latency is what counts
+static void __poll_task(void *pvParameters)
+{
+    lte_host_poll_t *poll = (lte_host_poll_t *)pvParameters;
+    char resp[128];
+    while (!poll->stop)
+    {
+        sim7600_cmd_req_t req = { .command = "AT+CESQ\r\n", .expected = "OK", .timeout_ms = 1000, .priority = SIM7600_PRIO_HIGH,
+                                  .resp = resp, .resp_size = sizeof(resp) };
+        int64_t start_us = esp_timer_get_time();
+        int len = sim7600__cmd_wait(sim7600__cmd_submit(&req), SIM7600_WAIT_FOREVER);
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        if (len < 0)
+            poll->fails++;
+        else
+            poll->answered++;
+        poll->max_us = (elapsed_us > poll->max_us) ? elapsed_us : poll->max_us;
+        vTaskDelay(pdMS_TO_TICKS(LTE_HOST_POLL_PERIOD_MS));
+    }
+    xSemaphoreGive(poll->done);
+    vTaskDelete(NULL);
+}
+
+static void __usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--pty | -s scenario] [-n iterations] [-t tasks] [-m] [-v]\n"
+                    "  --pty   expose the modem UART as a pseudo-terminal and wait for an external peer\n"
+                    "  -s      simulated modem timing, faults and replies from a script (host/scenarios)\n"
+                    "  -n      rounds of RSSI/COPS/CPIN/time queries per task (default %u)\n"
+                    "  -t      application tasks querying the modem at the same time (default 1, max %u)\n"
+                    "  -m      run the link multiplexed (AT+CMUX), status queries on their own channel\n"
+                    "  -v      keep driver logs\n", prog, LTE_HOST_DEFAULT_ITERATIONS, LTE_HOST_MAX_TASKS);
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+int main(int argc, char **argv)
+{
+    bool use_pty = false;
+    bool verbose = false;
+    bool use_cmux = false;
+    uint32_t iterations = LTE_HOST_DEFAULT_ITERATIONS;
+    uint32_t task_count = 1;
+    const char *scenario = NULL;
+    for (int idx = 1; idx < argc; idx++)
+    {
+        if (strcmp(argv[idx], "--pty") == 0)
+            use_pty = true;
+        else if ((strcmp(argv[idx], "-n") == 0) && (idx + 1 < argc))
+            iterations = (uint32_t)strtoul(argv[++idx], NULL, 0);
+        else if ((strcmp(argv[idx], "-s") == 0) && (idx + 1 < argc))
+            scenario = argv[++idx];
+        else if ((strcmp(argv[idx], "-t") == 0) && (idx + 1 < argc))
+            task_count = (uint32_t)strtoul(argv[++idx], NULL, 0);
+        else if (strcmp(argv[idx], "-v") == 0)
+            verbose = true;
+        else if (strcmp(argv[idx], "-m") == 0)
+            use_cmux = true;
+        else
+        {
+            __usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ((task_count < 1) || (task_count > LTE_HOST_MAX_TASKS) || (use_pty && (NULL != scenario)))
+    {
+        __usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!verbose)
+        esp_log_level_set("*", ESP_LOG_WARN);
+
+    if (use_pty)
+    {
+        char peer_name[64];
+        if (uart_posix_open_pty(LTE_HOST_UART_PORT, peer_name, sizeof(peer_name)) < 0)
+        {
+            perror("uart_posix_open_pty");
+            return EXIT_FAILURE;
+        }
+        printf("Modem UART on %s, connect the peer and press Enter\n", peer_name);
+        fflush(stdout);
+        getchar();
+    }
+    else
+    {
+        if ((NULL != scenario) && (sim_peer_load(scenario) != 0))
+            return EXIT_FAILURE;
+        int peer_fd = uart_posix_open_socketpair(LTE_HOST_UART_PORT);
+        if ((peer_fd < 0) || (sim_peer_start(peer_fd, NULL) != 0))
+        {
+            perror("uart_posix_open_socketpair");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (__InitUART() != SUCCESS)
+    {
+        fprintf(stderr, "__InitUART() failed\n");
+        return EXIT_FAILURE;
+    }
+    sim7600__register_urc("+CEREG:", __on_cereg, NULL);
+    if (sim7600__negotiate_baudrate(LTE_HOST_MAX_BAUDRATE, true) != SUCCESS)
+    {
+        fprintf(stderr, "Modem does not answer\n");
+        return EXIT_FAILURE;
+    }
+    if (use_cmux && (sim7600__cmux_start() != SUCCESS))
+    {
+        fprintf(stderr, "Modem did not start the multiplexer\n");
+        return EXIT_FAILURE;
+    }
+
+    const lte_host_op_t op_template[LTE_HOST_OP_COUNT] = {
+        { .name = "AT+CESQ",     .call = __op_rssi,      .min_us = INT64_MAX },
+        { .name = "AT+COPS?",    .call = __op_connected, .min_us = INT64_MAX },
+        { .name = "AT+CPIN?",    .call = __op_sim,       .min_us = INT64_MAX },
+        { .name = "AT#XCARRIER", .call = __op_time,      .min_us = INT64_MAX },
+    };
+    const size_t op_count = LTE_HOST_OP_COUNT;
+    // Round trips are what is measured, not the state cache
+    for (uint32_t field = 0; field < SIM7600_STATE_COUNT; field++)
+        sim7600__set_state_ttl((sim7600_state_t)field, 0);
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(LTE_HOST_MAX_TASKS, 0);
+
+    int64_t run_start_us = esp_timer_get_time();
+    for (uint32_t task = 0; task < task_count; task++)
+    {
+        memcpy(lte_host_worker[task].ops, op_template, sizeof(op_template));
+        lte_host_worker[task].iterations = iterations;
+        lte_host_worker[task].done = done;
+        if (xTaskCreate(__worker_task, "lte_host_worker", 4096, &lte_host_worker[task], 5, NULL) != pdPASS)
+        {
+            fprintf(stderr, "Cannot start worker task\n");
+            return EXIT_FAILURE;
+        }
+    }
+    for (uint32_t task = 0; task < task_count; task++)
+        xSemaphoreTake(done, portMAX_DELAY);
+    int64_t run_us = esp_timer_get_time() - run_start_us;
+
+    // All tasks together
+    lte_host_op_t ops[LTE_HOST_OP_COUNT];
+    memcpy(ops, op_template, sizeof(op_template));
+    for (uint32_t task = 0; task < task_count; task++)
+    {
+        for (size_t op = 0; op < op_count; op++)
+        {
+            const lte_host_op_t *part = &lte_host_worker[task].ops[op];
+            ops[op].fails += part->fails;
+            ops[op].total_us += part->total_us;
+            ops[op].min_us = (part->min_us < ops[op].min_us) ? part->min_us : ops[op].min_us;
+            ops[op].max_us = (part->max_us > ops[op].max_us) ? part->max_us : ops[op].max_us;
+        }
+    }
+    uint32_t calls = iterations * task_count;
+
+    // Whole HTTPS GET exchange: connect, request, response, no fixed delays in between
+    static char http_resp[512];
+    int64_t http_start_us = esp_timer_get_time();
+    int http_ret = sim7600__httpsGET("example.com/get", http_resp, sizeof(http_resp));
+    printf("HTTPS GET: %s in %" PRId64 " us\n", (SUCCESS == http_ret) ? "ok" : "failed", esp_timer_get_time() - http_start_us);
+
+    // Same exchange streamed, the payload is AT syntax ("OK", "#XHTTPCRSP:0,1", "+CME ERROR:") and must come through untouched
+    lte_host_stream_t stream = { .start_us = esp_timer_get_time() };
+    int stream_ret = sim7600__httpsGET_stream("example.com/raw", __on_http_chunk, &stream);
+    printf("HTTPS GET stream: %s, %" PRIu32 " B (%" PRIu32 " line ends) in %" PRIu32 " chunks, first after %" PRId64 " us, done in %" PRId64 " us\n",
+           (SUCCESS == stream_ret) ? "ok" : "failed", stream.bytes, stream.line_ends, stream.chunks, stream.first_chunk_us,
+           esp_timer_get_time() - stream.start_us);
+
+    // Binary body: every byte value, split across #XHTTPCRSP pieces, must arrive intact with its exact length
+    static uint8_t download[LTE_HOST_DOWNLOAD_SIZE + 64];
+    int http_status = 0;
+    int64_t download_start_us = esp_timer_get_time();
+    int download_len = sim7600__httpsGET_body("example.com/bin/20000", download, sizeof(download), &http_status);
+    int64_t download_us = esp_timer_get_time() - download_start_us;
+    uint32_t download_bad = (LTE_HOST_DOWNLOAD_SIZE == download_len) ? 0 : 1;
+    for (int offset = 0; offset < download_len; offset++)
+        download_bad += (download[offset] != sim_peer_download_byte((uint32_t)offset));
+    printf("HTTPS GET body: status %d, %d B (%" PRIu32 " wrong) in %" PRId64 " us\n", http_status, download_len, download_bad, download_us);
+
+    // All requests went to example.com over one session, one TLS handshake
+    uint32_t connects = sim_peer_matches("AT#XHTTPCCON=1");
+    sim7600__httpsClose();
+    printf("HTTPS handshakes: %" PRIu32 " for 3 requests\n", connects);
+
+    // Supervisory loop polling the signal: answered from the state cache, at most one AT+CESQ
+    sim7600__set_state_ttl(SIM7600_STATE_RSSI, 2000);
+    uint32_t cesq_before = sim_peer_matches("AT+CESQ");
+    int64_t poll_start_us = esp_timer_get_time();
+    for (uint32_t poll = 0; poll < 1000; poll++)
+        sim7600__get_rssi();
+    printf("1000 cached RSSI queries: %" PRId64 " us, %" PRIu32 " AT+CESQ sent\n", esp_timer_get_time() - poll_start_us,
+           sim_peer_matches("AT+CESQ") - cesq_before);
+
+    // Response longer than the mailbox ring, it moves into the larger block and back
+    static char cmng_resp[4096];
+    sim7600_cmd_req_t cmng_req = { .command = "AT%CMNG=1\r\n", .expected = "OK", .timeout_ms = 1000, .priority = SIM7600_PRIO_NORMAL,
+                                   .resp = cmng_resp, .resp_size = sizeof(cmng_resp) };
+    int cmng_len = sim7600__cmd_wait(sim7600__cmd_submit(&cmng_req), SIM7600_WAIT_FOREVER);
+    printf("AT%%CMNG=1: %d B\n", cmng_len);
+
+    // Multi-kilobyte body pulled from a callback, sent in data mode behind its length
+    uint32_t record = 0;
+    sim7600_http_body_t body = { .content_type = "application/x-ndjson", .len = LTE_HOST_POST_RECORDS * LTE_HOST_RECORD_LEN,
+                                 .read = __read_http_body, .ctx = &record };
+    lte_host_stream_t post_stream = { .start_us = esp_timer_get_time() };
+    int post_ret = sim7600__httpsPOST_stream("example.com/batch", "lte_host", &body, __on_http_chunk, &post_stream);
+    printf("HTTPS POST stream: %s, %" PRIu32 " B body, %" PRIu32 " B response in %" PRId64 " us\n", (SUCCESS == post_ret) ? "ok" : "failed",
+           body.len, post_stream.bytes, esp_timer_get_time() - post_stream.start_us);
+
+    // Telemetry over one socket kept open: no handshake or HTTP headers per record, the echo comes back through the callback
+    lte_host_sock_t sock_rx = { .expected = LTE_HOST_SOCK_MESSAGES * LTE_HOST_RECORD_LEN, .done = xSemaphoreCreateBinary() };
+    uint32_t sock_fails = 0;
+    int64_t sock_start_us = esp_timer_get_time();
+    int sock = sim7600__sock_open(SIM7600_SOCK_TCP, false, "telemetry.example.com", 4000, __on_sock_rx, &sock_rx);
+    for (uint32_t msg = 0; (msg < LTE_HOST_SOCK_MESSAGES) && (sock >= 0); msg++)
+    {
+        uint8_t line[LTE_HOST_RECORD_LEN];
+        __read_http_body(line, sizeof(line), &record);
+        sock_fails += (sim7600__sock_send(sock, line, sizeof(line)) != (int)sizeof(line));
+    }
+    bool echoed = (sock >= 0) && (xSemaphoreTake(sock_rx.done, pdMS_TO_TICKS(LTE_HOST_SOCK_TIMEOUT_MS)) == pdTRUE);
+    int64_t sock_us = esp_timer_get_time() - sock_start_us;
+    sock_fails += (sock < 0) || !echoed || (sim7600__sock_close(sock) != SUCCESS);
+    printf("TCP socket: %u records, %" PRIu32 " B echoed in %" PRId64 " us, %" PRId64 " us per record, %" PRIu32 " failures\n",
+           LTE_HOST_SOCK_MESSAGES, sock_rx.bytes, sock_us, sock_us / LTE_HOST_SOCK_MESSAGES, sock_fails);
+
+    // Pull style: one datagram out, read back with sim7600__sock_recv()
+    static const char udp_msg[] = "{\"seq\":0,\"t\":21.5}";
+    uint8_t udp_buf[64];
+    int udp_len = FAILURE;
+    int udp = sim7600__sock_open(SIM7600_SOCK_UDP, false, "telemetry.example.com", 4001, NULL, NULL);
+    if ((udp >= 0) && (sim7600__sock_send(udp, udp_msg, strlen(udp_msg)) == (int)strlen(udp_msg)))
+        udp_len = sim7600__sock_recv(udp, udp_buf, sizeof(udp_buf), 1000);
+    sock_fails += (udp < 0) || (sim7600__sock_close(udp) != SUCCESS) || (udp_len != (int)strlen(udp_msg)) ||
+                  (memcmp(udp_buf, udp_msg, strlen(udp_msg)) != 0);
+    printf("UDP socket: %d B received back\n", udp_len);
+
+    // Firmware update: the transfer drops part way, resumes with a Range and the image is only booted if its hash matches
+    uint8_t ota_sha256[LTE_OTA_SHA256_LEN];
+    mbedtls_sha256_context ota_sha_ctx;
+    mbedtls_sha256_init(&ota_sha_ctx);
+    mbedtls_sha256_starts(&ota_sha_ctx, 0);
+    for (uint32_t offset = 0; offset < LTE_HOST_OTA_SIZE; offset++)
+    {
+        uint8_t byte = sim_peer_download_byte(offset);
+        mbedtls_sha256_update(&ota_sha_ctx, &byte, 1);
+    }
+    mbedtls_sha256_finish(&ota_sha_ctx, ota_sha256);
+    mbedtls_sha256_free(&ota_sha_ctx);
+    ota_posix_set_write_us_per_kb(LTE_HOST_OTA_WRITE_US_PER_KB);
+    // The signal is watched all along: multiplexed, the queries do not wait for the download to end
+    lte_host_poll_t poll = { .done = xSemaphoreCreateBinary() };
+    bool polling = (xTaskCreate(__poll_task, "lte_host_poll", 4096, &poll, 5, NULL) == pdPASS);
+    lte_ota_stats_t ota_stats;
+    int ota_ret = lte_ota__update(LTE_HOST_OTA_URL, ota_sha256, &ota_stats);
+    poll.stop = true;
+    if (polling)
+        xSemaphoreTake(poll.done, portMAX_DELAY);
+    uint32_t ota_len = 0;
+    const uint8_t *ota_image = ota_posix_image(esp_ota_get_boot_partition(), &ota_len);
+    uint32_t ota_bad = (SUCCESS == ota_ret) && (esp_ota_get_boot_partition() != esp_ota_get_running_partition()) &&
+                       (LTE_HOST_OTA_SIZE == ota_len) ? 0 : 1;
+    for (uint32_t offset = 0; (0 == ota_bad) && (offset < ota_len); offset++)
+        ota_bad += (ota_image[offset] != sim_peer_download_byte(offset));
+    printf("LTE OTA: %s, %" PRIu32 " B to %s in %" PRIu32 " ms (%" PRIu32 " ms writing), %" PRIu32 " writes, %" PRIu32 " resumes\n",
+           (0 == ota_bad) ? "ok" : "failed", ota_stats.image_len, esp_ota_get_boot_partition()->label, ota_stats.total_ms,
+           ota_stats.write_ms, ota_stats.writes, ota_stats.resumes);
+    printf("AT+CESQ during the OTA: %" PRIu32 " answered, %" PRIu32 " failed, max %" PRId64 " us\n", poll.answered, poll.fails, poll.max_us);
+
+    // Callback style: submit, keep going, get called back on completion
+    static char cesq_resp[128];
+    sim7600_cmd_req_t cesq_req = { .command = "AT+CESQ\r\n", .expected = "OK", .timeout_ms = 1000, .priority = SIM7600_PRIO_HIGH,
+                                   .resp = cesq_resp, .resp_size = sizeof(cesq_resp), .cb = __on_cesq_done, .ctx = done };
+    if (sim7600__cmd_submit(&cesq_req) != NULL)
+        xSemaphoreTake(done, portMAX_DELAY);
+
+    printf("\n%-12s %8s %10s %10s %10s\n", "command", "fails", "min[us]", "avg[us]", "max[us]");
+    for (size_t op = 0; op < op_count; op++)
+    {
+        printf("%-12s %8" PRIu32 " %10" PRId64 " %10" PRId64 " %10" PRId64 "\n", ops[op].name, ops[op].fails,
+               (calls > 0) ? ops[op].min_us : 0, (calls > 0) ? ops[op].total_us / calls : 0, ops[op].max_us);
+    }
+
+    hal_uart_stats_t stats;
+    if (hal__UARTGetStats(LTE_HOST_UART_PORT, &stats) == SUCCESS)
+    {
+        printf("\n%" PRIu32 " commands from %" PRIu32 " task(s) in %" PRId64 " ms, %" PRIu32 " B out, %" PRIu32 " B in, RX ring peak %" PRIu32 " B, "
+               "consumer latency max %" PRIu32 " us\n",
+               calls * (uint32_t)op_count, task_count, run_us / 1000, stats.tx_bytes, stats.rx_bytes, stats.rx_ring_max,
+               stats.rx_latency_max_us);
+    }
+    printf("%" PRIu32 " +CEREG URCs dispatched\n", lte_host_cereg_count);
+    // Where the time went, per command: round trip of the status queries, handshake vs response wait for HTTPS
+    printf("\n");
+    sim7600__dump_trace();
+    printf("\n");
+    sim7600__dump_stack_usage();
+    if (NULL != scenario)
+        printf("Scenario %s: %" PRIu32 " faults injected\n", scenario, sim_peer_faults());
+
+    // Channel counters, then back to plain AT commands and one query to show the link still answers
+    uint32_t cmux_fails = 0;
+    if (use_cmux)
+    {
+        printf("\n%-6s %10s %10s %8s %8s %8s %10s\n", "DLCI", "rx[B]", "tx[B]", "rx fr", "flow off", "stalls", "ring max");
+        for (uint8_t dlci = 1; dlci <= CMUX_MAX_DLCI; dlci++)
+        {
+            cmux_stats_t cmux_stats;
+            if ((cmux__get_stats(dlci, &cmux_stats) != SUCCESS) || (0 == cmux_stats.rx_frames + cmux_stats.tx_frames))
+                continue;
+            printf("%-6u %10" PRIu32 " %10" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %10" PRIu32 "\n", dlci, cmux_stats.rx_bytes,
+                   cmux_stats.tx_bytes, cmux_stats.rx_frames, cmux_stats.flow_off, cmux_stats.stalls, cmux_stats.rx_ring_max);
+        }
+        cmux_fails = (sim7600__cmux_stop() != SUCCESS) || (sim7600__get_SimPresent() == FAILURE);
+        printf("Multiplexer closed: plain AT link %s\n", (0 == cmux_fails) ? "ok" : "failed");
+    }
+
+    uint32_t total_fails = (SUCCESS == http_ret) && (SUCCESS == stream_ret) && (cmng_len > 0) && (SUCCESS == post_ret) ? 0 : 1;
+    total_fails += sock_fails + download_bad + ota_bad + cmux_fails + poll.fails;
+    for (size_t op = 0; op < op_count; op++)
+        total_fails += ops[op].fails;
+    return (0 == total_fails) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
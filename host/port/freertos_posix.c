@@ -0,0 +1,402 @@
+/*******************************************************************************
+* Title                 :   FreeRTOS host shim
+* Filename              :   freertos_posix.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Tasks, queues and semaphores on pthreads, plus the
+*                           esp_timer and esp_log calls used by main/
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#define _GNU_SOURCE                     /* pthread_getattr_np() */
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define HOST_TASK_MIN_STACK_SIZE            (64U * 1024U)   /* Host libc (printf, sscanf) needs far more than on target */
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+struct host_task
+{
+    TaskFunction_t code;
+    void *param;
+    uint8_t *stack_start;       // Lowest address of the thread stack
+};
+
+struct QueueDefinition
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;           // NULL for semaphores
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;           // Index of the oldest item
+};
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static __thread struct host_task *host_current_task = NULL;
+static esp_log_level_t host_log_level = ESP_LOG_INFO;
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static struct timespec __host_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now;
+}
+
+static uint64_t __host_clock_us(void)
+{
+    struct timespec now = __host_now();
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000ULL;
+}
+
+// Time base of xTaskGetTickCount()/esp_timer_get_time(), taken before any task can run
+static uint64_t host_start_us = 0;
+__attribute__((constructor)) static void __host_clock_init(void)
+{
+    host_start_us = __host_clock_us();
+}
+
+static uint64_t __host_now_us(void)
+{
+    return __host_clock_us() - host_start_us;
+}
+
+// Absolute CLOCK_MONOTONIC deadline ticks from now
+static struct timespec __host_deadline(TickType_t ticks)
+{
+    struct timespec deadline = __host_now();
+    uint64_t ms = (uint64_t)ticks * portTICK_PERIOD_MS;
+    deadline.tv_sec += (time_t)(ms / 1000U);
+    deadline.tv_nsec += (long)(ms % 1000U) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+// Blocks until the queue has room (for_space) or an item, at most ticks. Called with q->lock held
+static BaseType_t __host_queue_wait(QueueHandle_t q, bool for_space, TickType_t ticks)
+{
+    pthread_cond_t *cond = for_space ? &q->not_full : &q->not_empty;
+    #define QUEUE_READY()   (for_space ? (q->count < q->length) : (q->count > 0))
+    if (portMAX_DELAY == ticks)
+    {
+        while (!QUEUE_READY())
+            pthread_cond_wait(cond, &q->lock);
+    }
+    else if ((0 != ticks) && !QUEUE_READY())
+    {
+        struct timespec deadline = __host_deadline(ticks);
+        while (!QUEUE_READY() && (pthread_cond_timedwait(cond, &q->lock, &deadline) != ETIMEDOUT))
+            ;
+    }
+    BaseType_t ready = QUEUE_READY() ? pdTRUE : pdFALSE;
+    #undef QUEUE_READY
+    return ready;
+}
+
+static void *__host_task_entry(void *arg)
+{
+    host_current_task = (struct host_task *)arg;
+    pthread_attr_t attr;
+    if (0 == pthread_getattr_np(pthread_self(), &attr))
+    {
+        void *stack_addr;
+        size_t stack_size;
+        if (0 == pthread_attr_getstack(&attr, &stack_addr, &stack_size))
+            host_current_task->stack_start = (uint8_t *)stack_addr;
+        pthread_attr_destroy(&attr);
+    }
+    host_current_task->code(host_current_task->param);
+    // FreeRTOS tasks must not return, treat it as vTaskDelete(NULL)
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+static BaseType_t __host_queue_send(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    if (NULL == q)
+        return pdFAIL;
+    pthread_mutex_lock(&q->lock);
+    BaseType_t ret = __host_queue_wait(q, true, ticks);
+    if (pdTRUE == ret)
+    {
+        UBaseType_t idx;
+        if (front)
+        {
+            q->head = (q->head + q->length - 1) % q->length;
+            idx = q->head;
+        }
+        else
+            idx = (q->head + q->count) % q->length;
+        if ((NULL != q->storage) && (NULL != item))
+            memcpy(&q->storage[idx * q->item_size], item, q->item_size);
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask,
+                                   BaseType_t xCoreID)
+{
+    (void)pcName;
+    (void)uxPriority;
+    (void)xCoreID;
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (NULL == task)
+        return pdFAIL;
+    task->code = pxTaskCode;
+    task->param = pvParameters;
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, (usStackDepth < HOST_TASK_MIN_STACK_SIZE) ? HOST_TASK_MIN_STACK_SIZE : usStackDepth);
+    int err = pthread_create(&thread, &attr, __host_task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (0 != err)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    if (NULL != pxCreatedTask)
+        *pxCreatedTask = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    return xTaskCreatePinnedToCore(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if ((NULL != xTaskToDelete) && (xTaskToDelete != host_current_task))
+    {
+        fprintf(stderr, "vTaskDelete(): deleting another task is not supported on the host\n");
+        abort();
+    }
+    free(host_current_task);
+    host_current_task = NULL;
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    struct timespec delay = {
+        .tv_sec = (time_t)((xTicksToDelay * portTICK_PERIOD_MS) / 1000U),
+        .tv_nsec = (long)((xTicksToDelay * portTICK_PERIOD_MS) % 1000U) * 1000000L,
+    };
+    while ((nanosleep(&delay, &delay) != 0) && (EINTR == errno))
+        ;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(__host_now_us() / (1000U * portTICK_PERIOD_MS));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return host_current_task;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+    (void)xTask; // Thread stacks are not painted, nothing to measure
+    return 0;
+}
+
+uint8_t *pxTaskGetStackStart(TaskHandle_t xTask)
+{
+    struct host_task *task = (NULL != xTask) ? xTask : host_current_task;
+    return (NULL != task) ? task->stack_start : NULL;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    if (0 == uxQueueLength)
+        return NULL;
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (NULL == q)
+        return NULL;
+    if (0 != uxItemSize)
+    {
+        q->storage = malloc(uxQueueLength * uxItemSize);
+        if (NULL == q->storage)
+        {
+            free(q);
+            return NULL;
+        }
+    }
+    q->length = uxQueueLength;
+    q->item_size = uxItemSize;
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, &cattr);
+    pthread_cond_init(&q->not_full, &cattr);
+    pthread_condattr_destroy(&cattr);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    if (NULL == xQueue)
+        return;
+    pthread_cond_destroy(&xQueue->not_empty);
+    pthread_cond_destroy(&xQueue->not_full);
+    pthread_mutex_destroy(&xQueue->lock);
+    free(xQueue->storage);
+    free(xQueue);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return __host_queue_send(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return __host_queue_send(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    if (NULL == xQueue)
+        return pdFAIL;
+    pthread_mutex_lock(&xQueue->lock);
+    BaseType_t ret = __host_queue_wait(xQueue, false, xTicksToWait);
+    if (pdTRUE == ret)
+    {
+        if ((NULL != xQueue->storage) && (NULL != pvBuffer))
+            memcpy(pvBuffer, &xQueue->storage[xQueue->head * xQueue->item_size], xQueue->item_size);
+        xQueue->head = (xQueue->head + 1) % xQueue->length;
+        xQueue->count--;
+        pthread_cond_signal(&xQueue->not_full);
+    }
+    pthread_mutex_unlock(&xQueue->lock);
+    return ret;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    if (NULL == xQueue)
+        return 0;
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    if (NULL == xQueue)
+        return pdFAIL;
+    pthread_mutex_lock(&xQueue->lock);
+    xQueue->count = 0;
+    xQueue->head = 0;
+    pthread_cond_broadcast(&xQueue->not_full);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if (NULL != mutex)
+        xSemaphoreGive(mutex); // Mutexes start out available
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    SemaphoreHandle_t sem = xQueueCreate(uxMaxCount, 0);
+    for (UBaseType_t idx = 0; (NULL != sem) && (idx < uxInitialCount); idx++)
+        xSemaphoreGive(sem);
+    return sem;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)__host_now_us();
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    host_log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char level_char[] = "NEWIDV";
+    if (level > host_log_level)
+        return;
+    va_list args;
+    va_start(args, format);
+    flockfile(stderr);
+    fprintf(stderr, "%c (%lu) %s: ", level_char[level], (unsigned long)(esp_timer_get_time() / 1000), tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+    va_end(args);
+}
+
+void esp_log_buffer_hexdump_internal(const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t level)
+{
+    const uint8_t *data = (const uint8_t *)buffer;
+    if (level > host_log_level)
+        return;
+    for (uint16_t offset = 0; offset < buff_len; offset += 16)
+    {
+        char hex[16 * 3 + 1] = {0};
+        char ascii[16 + 1] = {0};
+        for (uint16_t idx = 0; (idx < 16) && (offset + idx < buff_len); idx++)
+        {
+            uint8_t c = data[offset + idx];
+            snprintf(&hex[idx * 3], 4, "%02x ", c);
+            ascii[idx] = ((c >= 0x20) && (c < 0x7f)) ? (char)c : '.';
+        }
+        esp_log_write(level, tag, "0x%04x   %-48s |%s|", offset, hex, ascii);
+    }
+}
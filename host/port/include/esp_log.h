@@ -0,0 +1,47 @@
+/*******************************************************************************
+* Title                 :   ESP-IDF host shim
+* Filename              :   esp_log.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Logs to stderr in the IDF "L (ms) TAG: msg" format.
+*                           Per-tag levels are not supported, the tag is ignored.
+*******************************************************************************/
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdint.h>
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void esp_log_buffer_hexdump_internal(const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t level);
+
+/******************************************************************************
+* Preprocessor Macros
+*******************************************************************************/
+#define ESP_LOGE(tag, format, ...)  esp_log_write(ESP_LOG_ERROR,   (tag), format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  esp_log_write(ESP_LOG_WARN,    (tag), format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  esp_log_write(ESP_LOG_INFO,    (tag), format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  esp_log_write(ESP_LOG_DEBUG,   (tag), format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)  esp_log_write(ESP_LOG_VERBOSE, (tag), format, ##__VA_ARGS__)
+#define ESP_LOG_BUFFER_HEXDUMP(tag, buffer, buff_len, level) \
+                                    esp_log_buffer_hexdump_internal((tag), (buffer), (buff_len), (level))
+
+#endif /* ESP_LOG_H */
@@ -0,0 +1,42 @@
+/*******************************************************************************
+* Title                 :   ESP-IDF host shim
+* Filename              :   esp_ota_ops.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Two app partitions in RAM, see ota_posix.c. Writes
+*                           must be sequential and stay inside the partition.
+*******************************************************************************/
+#ifndef ESP_OTA_OPS_H
+#define ESP_OTA_OPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+/******************************************************************************
+* Preprocessor Constants
+*******************************************************************************/
+#define OTA_SIZE_UNKNOWN            0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES  0xfffffffe
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef uint32_t esp_ota_handle_t;
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_boot_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+
+#endif /* ESP_OTA_OPS_H */
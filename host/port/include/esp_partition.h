@@ -0,0 +1,26 @@
+/*******************************************************************************
+* Title                 :   ESP-IDF host shim
+* Filename              :   esp_partition.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Partition descriptor only, the fields esp_ota_ops.h
+*                           users read. See ota_posix.c for the partitions.
+*******************************************************************************/
+#ifndef ESP_PARTITION_H
+#define ESP_PARTITION_H
+
+#include <stdint.h>
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+#endif /* ESP_PARTITION_H */
@@ -0,0 +1,17 @@
+/*******************************************************************************
+* Title                 :   ESP-IDF host shim
+* Filename              :   esp_timer.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   CLOCK_MONOTONIC since process start
+*******************************************************************************/
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void); // Microseconds since start-up
+
+#endif /* ESP_TIMER_H */
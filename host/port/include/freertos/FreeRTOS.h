@@ -0,0 +1,41 @@
+/*******************************************************************************
+* Title                 :   FreeRTOS host shim
+* Filename              :   FreeRTOS.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Subset of the FreeRTOS API used by main/, implemented
+*                           on pthreads in freertos_posix.c. 1 tick = 1 ms.
+*******************************************************************************/
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+* Preprocessor Constants
+*******************************************************************************/
+#define configTICK_RATE_HZ          (1000U)
+#define portTICK_PERIOD_MS          (1000U / configTICK_RATE_HZ)
+#define portMAX_DELAY               ((TickType_t)0xFFFFFFFFUL)
+
+#define pdFALSE                     ((BaseType_t)0)
+#define pdTRUE                      ((BaseType_t)1)
+#define pdPASS                      (pdTRUE)
+#define pdFAIL                      (pdFALSE)
+
+#define tskNO_AFFINITY              ((BaseType_t)0x7FFFFFFF)
+
+#define pdMS_TO_TICKS(MS)           ((TickType_t)(((TickType_t)(MS) * configTICK_RATE_HZ) / 1000U))
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#endif /* FREERTOS_H */
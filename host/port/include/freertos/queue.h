@@ -0,0 +1,38 @@
+/*******************************************************************************
+* Title                 :   FreeRTOS host shim
+* Filename              :   queue.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Copy-in/copy-out queues on a pthread mutex and two
+*                           condition variables. Semaphores are zero-size queues.
+*******************************************************************************/
+#ifndef FREERTOS_QUEUE_H
+#define FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef struct QueueDefinition *QueueHandle_t;
+
+/******************************************************************************
+* Preprocessor Macros
+*******************************************************************************/
+#define xQueueSend(xQueue, pvItemToQueue, xTicksToWait)         xQueueSendToBack((xQueue), (pvItemToQueue), (xTicksToWait))
+#define xQueueSendFromISR(xQueue, pvItemToQueue, pxWoken)       xQueueSendToBack((xQueue), (pvItemToQueue), 0)
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize);
+void vQueueDelete(QueueHandle_t xQueue);
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait);
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait);
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue);
+BaseType_t xQueueReset(QueueHandle_t xQueue);
+
+#endif /* FREERTOS_QUEUE_H */
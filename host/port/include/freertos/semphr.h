@@ -0,0 +1,36 @@
+/*******************************************************************************
+* Title                 :   FreeRTOS host shim
+* Filename              :   semphr.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Semaphores and (non-recursive) mutexes on top of
+*                           zero-size queues, as in FreeRTOS itself.
+*******************************************************************************/
+#ifndef FREERTOS_SEMPHR_H
+#define FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef QueueHandle_t SemaphoreHandle_t;
+
+/******************************************************************************
+* Preprocessor Macros
+*******************************************************************************/
+#define xSemaphoreCreateBinary()                        xQueueCreate(1, 0)
+#define xSemaphoreTake(xSemaphore, xBlockTime)          xQueueReceive((xSemaphore), NULL, (xBlockTime))
+#define xSemaphoreGive(xSemaphore)                      xQueueSendToBack((xSemaphore), NULL, 0)
+#define xSemaphoreGiveFromISR(xSemaphore, pxWoken)      xQueueSendToBack((xSemaphore), NULL, 0)
+#define vSemaphoreDelete(xSemaphore)                    vQueueDelete(xSemaphore)
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount);
+
+#endif /* FREERTOS_SEMPHR_H */
@@ -0,0 +1,37 @@
+/*******************************************************************************
+* Title                 :   FreeRTOS host shim
+* Filename              :   task.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Tasks are detached pthreads. Priorities and core
+*                           affinity are accepted and ignored.
+*******************************************************************************/
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask,
+                                   BaseType_t xCoreID);
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask);
+void vTaskDelete(TaskHandle_t xTaskToDelete);   // Only NULL (the calling task) is supported
+void vTaskDelay(TickType_t xTicksToDelay);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);  // NULL outside tasks created through the shim
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask); // Not measured on the host, always 0
+uint8_t *pxTaskGetStackStart(TaskHandle_t xTask); // Lowest address of the task stack (the pthread stack), NULL outside tasks
+
+#endif /* FREERTOS_TASK_H */
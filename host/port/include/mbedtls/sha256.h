@@ -0,0 +1,37 @@
+/*******************************************************************************
+* Title                 :   mbedTLS host shim
+* Filename              :   sha256.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   The mbedTLS 3.x SHA-256 calls the firmware uses, see
+*                           sha256_posix.c. SHA-224 (is224) is not supported.
+*******************************************************************************/
+#ifndef MBEDTLS_SHA256_H
+#define MBEDTLS_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t total;                 // Bytes hashed so far
+    uint8_t buffer[64];             // Partial block
+} mbedtls_sha256_context;
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32]);
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char output[32], int is224);
+
+#endif /* MBEDTLS_SHA256_H */
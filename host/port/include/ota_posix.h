@@ -0,0 +1,23 @@
+/*******************************************************************************
+* Title                 :   Host OTA partitions
+* Filename              :   ota_posix.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Reads back what esp_ota_write() stored, for checks
+*                           after an update. See ota_posix.c.
+*******************************************************************************/
+#ifndef OTA_POSIX_H
+#define OTA_POSIX_H
+
+#include <stdint.h>
+#include "esp_partition.h"
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+const uint8_t *ota_posix_image(const esp_partition_t *partition, uint32_t *len); //Contents of partition and the length of the image last written to it by a completed update. Returns NULL if partition is not an OTA partition.
+void ota_posix_set_write_us_per_kb(uint32_t us_per_kb); //Make esp_ota_write() as slow as flash: sleep us_per_kb for each KB written. 0 (default) writes at memory speed.
+
+#endif /* OTA_POSIX_H */
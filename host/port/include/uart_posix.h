@@ -0,0 +1,25 @@
+/*******************************************************************************
+* Title                 :   Host UART backend
+* Filename              :   uart_posix.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Binds a UART port to a Linux file descriptor before
+*                           __InitUART() installs the driver on it. A reader
+*                           thread plays the part of the RX interrupt.
+*******************************************************************************/
+#ifndef UART_POSIX_H
+#define UART_POSIX_H
+
+#include <stddef.h>
+#include "driver/uart.h"
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+int uart_posix_attach(uart_port_t uart_num, int fd); //Use fd as the wire of uart_num. Returns 0 on success, -1 on failure.
+int uart_posix_open_pty(uart_port_t uart_num, char *peer_name, size_t peer_name_len); //Attach the master side of a new raw pseudo-terminal. Copies the slave path for the peer into peer_name. Returns the master fd on success, -1 on failure.
+int uart_posix_open_socketpair(uart_port_t uart_num); //Attach one end of a new stream socketpair. Returns the peer end on success, -1 on failure.
+
+#endif /* UART_POSIX_H */
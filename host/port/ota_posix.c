@@ -0,0 +1,185 @@
+/*******************************************************************************
+* Title                 :   Host OTA partitions
+* Filename              :   ota_posix.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   ota_0 and ota_1 as RAM arrays, the application runs
+*                           from ota_0. One update at a time, writes only append,
+*                           like OTA_WITH_SEQUENTIAL_WRITES on target. Image
+*                           validation by esp_ota_end() is not modelled.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "ota_posix.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define MODULE_NAME                         "OTA_POSIX"
+#define OTA_POSIX_PARTITION_SIZE            (1536U * 1024U)
+#define OTA_POSIX_PARTITION_COUNT           (2U)
+#define OTA_POSIX_HANDLE                    (1U)    /* The only handle esp_ota_begin() hands out */
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static const esp_partition_t ota_posix_partition[OTA_POSIX_PARTITION_COUNT] =
+{
+    { .address = 0x10000, .size = OTA_POSIX_PARTITION_SIZE, .label = "ota_0" },
+    { .address = 0x10000 + OTA_POSIX_PARTITION_SIZE, .size = OTA_POSIX_PARTITION_SIZE, .label = "ota_1" },
+};
+static uint8_t ota_posix_flash[OTA_POSIX_PARTITION_COUNT][OTA_POSIX_PARTITION_SIZE];
+static uint32_t ota_posix_image_len[OTA_POSIX_PARTITION_COUNT];
+
+static pthread_mutex_t ota_posix_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t ota_posix_boot = 0;                  // Partition index
+static int ota_posix_target = -1;                   // Partition being written, -1 if no update is open
+static uint32_t ota_posix_written = 0;
+static uint32_t ota_posix_write_us_per_kb = 0;
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static int __ota_posix_index(const esp_partition_t *partition)
+{
+    for (uint8_t idx = 0; idx < OTA_POSIX_PARTITION_COUNT; idx++)
+    {
+        if (partition == &ota_posix_partition[idx])
+            return idx;
+    }
+    return -1;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &ota_posix_partition[0];
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+    return &ota_posix_partition[ota_posix_boot];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    int idx = __ota_posix_index((start_from != NULL) ? start_from : esp_ota_get_running_partition());
+    if (idx < 0)
+        return NULL;
+    return &ota_posix_partition[(idx + 1) % OTA_POSIX_PARTITION_COUNT];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    int idx = __ota_posix_index(partition);
+    if ((idx < 0) || (out_handle == NULL))
+        return ESP_ERR_INVALID_ARG;
+    if (partition == esp_ota_get_running_partition())
+        return ESP_ERR_INVALID_ARG;
+    if ((image_size != OTA_SIZE_UNKNOWN) && (image_size != OTA_WITH_SEQUENTIAL_WRITES) && (image_size > partition->size))
+        return ESP_ERR_INVALID_SIZE;
+    pthread_mutex_lock(&ota_posix_lock);
+    if (ota_posix_target >= 0)
+    {
+        pthread_mutex_unlock(&ota_posix_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    ota_posix_target = idx;
+    ota_posix_written = 0;
+    ota_posix_image_len[idx] = 0;
+    pthread_mutex_unlock(&ota_posix_lock);
+    *out_handle = OTA_POSIX_HANDLE;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if ((handle != OTA_POSIX_HANDLE) || (data == NULL))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&ota_posix_lock);
+    if (ota_posix_target < 0)
+    {
+        pthread_mutex_unlock(&ota_posix_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (size > OTA_POSIX_PARTITION_SIZE - ota_posix_written)
+    {
+        pthread_mutex_unlock(&ota_posix_lock);
+        ESP_LOGE(MODULE_NAME, "Image larger than %s", ota_posix_partition[ota_posix_target].label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&ota_posix_flash[ota_posix_target][ota_posix_written], data, size);
+    ota_posix_written += size;
+    uint32_t delay_us = (uint32_t)(((uint64_t)size * ota_posix_write_us_per_kb) / 1024U);
+    pthread_mutex_unlock(&ota_posix_lock);
+    if (delay_us != 0)
+    {
+        struct timespec delay = { .tv_sec = delay_us / 1000000U, .tv_nsec = (long)(delay_us % 1000000U) * 1000L };
+        nanosleep(&delay, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    if (handle != OTA_POSIX_HANDLE)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&ota_posix_lock);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (ota_posix_target >= 0)
+    {
+        err = (ota_posix_written != 0) ? ESP_OK : ESP_ERR_INVALID_SIZE; // Target: ESP_ERR_OTA_VALIDATE_FAILED
+        if (err == ESP_OK)
+            ota_posix_image_len[ota_posix_target] = ota_posix_written;
+        ota_posix_target = -1;
+    }
+    pthread_mutex_unlock(&ota_posix_lock);
+    return err;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    if (handle != OTA_POSIX_HANDLE)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&ota_posix_lock);
+    ota_posix_target = -1;
+    pthread_mutex_unlock(&ota_posix_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    int idx = __ota_posix_index(partition);
+    if (idx < 0)
+        return ESP_ERR_INVALID_ARG;
+    if (ota_posix_image_len[idx] == 0)
+        return ESP_ERR_INVALID_STATE; // Nothing valid written
+    ota_posix_boot = (uint8_t)idx;
+    return ESP_OK;
+}
+
+const uint8_t *ota_posix_image(const esp_partition_t *partition, uint32_t *len)
+{
+    int idx = __ota_posix_index(partition);
+    if (idx < 0)
+        return NULL;
+    if (len != NULL)
+        *len = ota_posix_image_len[idx];
+    return ota_posix_flash[idx];
+}
+
+void ota_posix_set_write_us_per_kb(uint32_t us_per_kb)
+{
+    ota_posix_write_us_per_kb = us_per_kb;
+}
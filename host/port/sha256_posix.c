@@ -0,0 +1,138 @@
+/*******************************************************************************
+* Title                 :   Host SHA-256
+* Filename              :   sha256_posix.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   FIPS 180-4 SHA-256 behind the mbedTLS calls, so the
+*                           host build needs no mbedTLS. Not constant time.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <string.h>
+#include "mbedtls/sha256.h"
+
+/******************************************************************************
+* Module Preprocessor Macros
+*******************************************************************************/
+#define ROTR(x, n)                  (((x) >> (n)) | ((x) << (32 - (n))))
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static const uint32_t sha256_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static void __sha256_block(mbedtls_sha256_context *ctx, const uint8_t *block)
+{
+    uint32_t w[64];
+    for (int idx = 0; idx < 16; idx++)
+        w[idx] = ((uint32_t)block[idx * 4] << 24) | ((uint32_t)block[idx * 4 + 1] << 16) |
+                 ((uint32_t)block[idx * 4 + 2] << 8) | (uint32_t)block[idx * 4 + 3];
+    for (int idx = 16; idx < 64; idx++)
+    {
+        uint32_t s0 = ROTR(w[idx - 15], 7) ^ ROTR(w[idx - 15], 18) ^ (w[idx - 15] >> 3);
+        uint32_t s1 = ROTR(w[idx - 2], 17) ^ ROTR(w[idx - 2], 19) ^ (w[idx - 2] >> 10);
+        w[idx] = w[idx - 16] + s0 + w[idx - 7] + s1;
+    }
+
+    uint32_t v[8];
+    memcpy(v, ctx->state, sizeof(v));
+    for (int idx = 0; idx < 64; idx++)
+    {
+        uint32_t s1 = ROTR(v[4], 6) ^ ROTR(v[4], 11) ^ ROTR(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + sha256_k[idx] + w[idx];
+        uint32_t s0 = ROTR(v[0], 2) ^ ROTR(v[0], 13) ^ ROTR(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        memmove(&v[1], &v[0], 7 * sizeof(v[0]));
+        v[4] += t1;
+        v[0] = t1 + s0 + maj;
+    }
+    for (int idx = 0; idx < 8; idx++)
+        ctx->state[idx] += v[idx];
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx)
+{
+    if (ctx != NULL)
+        memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224)
+{
+    static const uint32_t init[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    if (is224 != 0)
+        return -1;
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->total = 0;
+    return 0;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen)
+{
+    size_t fill = (size_t)(ctx->total % 64);
+    ctx->total += ilen;
+    if ((fill != 0) && (fill + ilen >= 64))
+    {
+        memcpy(&ctx->buffer[fill], input, 64 - fill);
+        __sha256_block(ctx, ctx->buffer);
+        input += 64 - fill;
+        ilen -= 64 - fill;
+        fill = 0;
+    }
+    // fill is 0 here unless all of input fits in the partial block
+    for (; ilen >= 64; input += 64, ilen -= 64)
+        __sha256_block(ctx, input);
+    memcpy(&ctx->buffer[fill], input, ilen);
+    return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32])
+{
+    uint64_t bits = ctx->total * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t pad_len = ((ctx->total % 64) < 56) ? (56 - ctx->total % 64) : (120 - ctx->total % 64);
+    for (int idx = 0; idx < 8; idx++)
+        pad[pad_len + idx] = (uint8_t)(bits >> (56 - idx * 8));
+    mbedtls_sha256_update(ctx, pad, pad_len + 8);
+    for (int idx = 0; idx < 32; idx++)
+        output[idx] = (uint8_t)(ctx->state[idx / 4] >> (24 - (idx % 4) * 8));
+    return 0;
+}
+
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char output[32], int is224)
+{
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    int ret = mbedtls_sha256_starts(&ctx, is224);
+    if (ret == 0)
+        ret = mbedtls_sha256_update(&ctx, input, ilen);
+    if (ret == 0)
+        ret = mbedtls_sha256_finish(&ctx, output);
+    mbedtls_sha256_free(&ctx);
+    return ret;
+}
@@ -0,0 +1,488 @@
+/*******************************************************************************
+* Title                 :   Host UART backend
+* Filename              :   uart_posix.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   ESP-IDF UART driver semantics over a pty or socket:
+*                           a reader thread stands in for the RX interrupt, fills
+*                           the driver RX buffer, tracks pattern positions relative
+*                           to the read pointer and posts uart_event_t events.
+*                           Baud rate and flow control are recorded only, bytes
+*                           move at host speed.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "uart_posix.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define MODULE_NAME                         "UART_POSIX"
+#define UART_POSIX_READ_CHUNK               (256U)  /* Largest read() per wake-up, about two hardware FIFOs */
+#define UART_POSIX_MIN_RX_BUFFER            (128U)  /* Same lower bound as the IDF driver (SOC_UART_FIFO_LEN) */
+
+/******************************************************************************
+* Module Preprocessor Macros
+*******************************************************************************/
+#define uart_posix_check(port)              if ( ((port) < 0) || ((port) >= UART_NUM_MAX) ) return ESP_ERR_INVALID_ARG
+#define uart_posix_check_installed(port)    if ( ((port) < 0) || ((port) >= UART_NUM_MAX) || !uart_posix[(port)].installed ) return ESP_FAIL
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+typedef struct
+{
+    int fd;                             // Wire, -1 until uart_posix_attach()
+    bool installed;
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;             // Data arrived or space freed in the RX buffer
+    QueueHandle_t event_queue;
+
+    uint8_t *rx_buf;                    // Driver RX buffer (IDF: ring buffer behind uart_read_bytes)
+    size_t rx_size;
+    size_t rx_head;                     // Next write index
+    size_t rx_count;
+    bool rx_full_posted;                // UART_BUFFER_FULL already reported for this fill
+
+    bool pattern_en;
+    char pattern_chr;
+    int *pattern_pos;                   // Positions relative to the read pointer, oldest first
+    int pattern_len;
+    int pattern_count;
+
+    uint32_t baud_rate;
+    uart_hw_flowcontrol_t flow_ctrl;
+} uart_posix_port_t;
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static uart_posix_port_t uart_posix[UART_NUM_MAX] = {
+    [UART_NUM_0] = { .fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER },
+    [UART_NUM_1] = { .fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER },
+    [UART_NUM_2] = { .fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static void __uart_posix_post(uart_posix_port_t *p, uart_event_type_t type, size_t size)
+{
+    uart_event_t event = { .type = type, .size = size };
+    // Like the ISR: never block, drop the event when the queue is full
+    if (NULL != p->event_queue)
+        xQueueSend(p->event_queue, &event, 0);
+}
+
+// Called with p->lock held
+static void __uart_posix_rx_put(uart_posix_port_t *p, const uint8_t *data, size_t len, bool *pattern_found)
+{
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        if (p->pattern_en && (data[idx] == (uint8_t)p->pattern_chr) && (p->pattern_count < p->pattern_len))
+        {
+            p->pattern_pos[p->pattern_count++] = (int)p->rx_count;
+            *pattern_found = true;
+        }
+        p->rx_buf[p->rx_head] = data[idx];
+        p->rx_head = (p->rx_head + 1) % p->rx_size;
+        p->rx_count++;
+    }
+}
+
+// Stands in for the UART RX interrupt: moves bytes from the wire into the driver RX buffer
+static void *__uart_posix_reader(void *arg)
+{
+    uart_posix_port_t *p = (uart_posix_port_t *)arg;
+    uint8_t chunk[UART_POSIX_READ_CHUNK];
+    while (1)
+    {
+        ssize_t read_len = read(p->fd, chunk, sizeof(chunk));
+        if (read_len < 0)
+        {
+            if ((EINTR == errno) || (EAGAIN == errno))
+                continue;
+            ESP_LOGE(MODULE_NAME, "read() failed: %s", strerror(errno));
+            break;
+        }
+        if (0 == read_len)
+            break; // Peer closed the line
+
+        size_t done = 0;
+        pthread_mutex_lock(&p->lock);
+        while (done < (size_t)read_len)
+        {
+            size_t space = p->rx_size - p->rx_count;
+            if (0 == space)
+            {
+                // Stop reading until the application frees space, the wire backs up like with RTS deasserted
+                if (!p->rx_full_posted)
+                {
+                    p->rx_full_posted = true;
+                    __uart_posix_post(p, UART_BUFFER_FULL, 0);
+                }
+                pthread_cond_wait(&p->changed, &p->lock);
+                continue;
+            }
+            size_t put_len = ((size_t)read_len - done < space) ? (size_t)read_len - done : space;
+            bool pattern_found = false;
+            __uart_posix_rx_put(p, &chunk[done], put_len, &pattern_found);
+            done += put_len;
+            __uart_posix_post(p, pattern_found ? UART_PATTERN_DET : UART_DATA, put_len);
+            pthread_cond_broadcast(&p->changed);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+
+static int __uart_posix_set_raw(int fd)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+        return -1;
+    cfmakeraw(&tio);
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+int uart_posix_attach(uart_port_t uart_num, int fd)
+{
+    if ((uart_num < 0) || (uart_num >= UART_NUM_MAX) || (fd < 0) || uart_posix[uart_num].installed)
+        return -1;
+    uart_posix[uart_num].fd = fd;
+    return 0;
+}
+
+int uart_posix_open_pty(uart_port_t uart_num, char *peer_name, size_t peer_name_len)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0)
+        return -1;
+    if ((grantpt(fd) != 0) || (unlockpt(fd) != 0) || (__uart_posix_set_raw(fd) != 0) ||
+        (ptsname_r(fd, peer_name, peer_name_len) != 0) || (uart_posix_attach(uart_num, fd) != 0))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int uart_posix_open_socketpair(uart_port_t uart_num)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+        return -1;
+    if (uart_posix_attach(uart_num, sv[0]) != 0)
+    {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    return sv[1];
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    (void)tx_buffer_size; // write() to the fd already buffers
+    (void)intr_alloc_flags;
+    uart_posix_check(uart_num);
+    uart_posix_port_t *p = &uart_posix[uart_num];
+    if (p->installed || (rx_buffer_size <= (int)UART_POSIX_MIN_RX_BUFFER))
+        return ESP_ERR_INVALID_ARG;
+    if (p->fd < 0)
+    {
+        ESP_LOGE(MODULE_NAME, "UART%d is not attached, call uart_posix_attach() first", uart_num);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    p->rx_buf = malloc((size_t)rx_buffer_size);
+    if (NULL == p->rx_buf)
+        return ESP_ERR_NO_MEM;
+    p->rx_size = (size_t)rx_buffer_size;
+    p->rx_head = 0;
+    p->rx_count = 0;
+    p->event_queue = NULL;
+    if ((queue_size > 0) && (NULL != uart_queue))
+    {
+        p->event_queue = xQueueCreate((UBaseType_t)queue_size, sizeof(uart_event_t));
+        if (NULL == p->event_queue)
+        {
+            free(p->rx_buf);
+            return ESP_ERR_NO_MEM;
+        }
+        *uart_queue = p->event_queue;
+    }
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&p->changed, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    p->installed = true;
+    if (pthread_create(&p->reader, NULL, __uart_posix_reader, p) != 0)
+    {
+        p->installed = false;
+        vQueueDelete(p->event_queue);
+        free(p->rx_buf);
+        return ESP_FAIL;
+    }
+    pthread_detach(p->reader);
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    // The reader thread may be blocked in read() on a shared fd, the host build never tears ports down
+    uart_posix_check_installed(uart_num);
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config)
+{
+    uart_posix_check(uart_num);
+    if (NULL == uart_config)
+        return ESP_ERR_INVALID_ARG;
+    uart_posix[uart_num].baud_rate = (uint32_t)uart_config->baud_rate;
+    uart_posix[uart_num].flow_ctrl = uart_config->flow_ctrl;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num)
+{
+    (void)tx_io_num;
+    (void)rx_io_num;
+    (void)rts_io_num;
+    (void)cts_io_num;
+    uart_posix_check(uart_num);
+    return ESP_OK;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate)
+{
+    uart_posix_check(uart_num);
+    uart_posix[uart_num].baud_rate = baudrate;
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t *baudrate)
+{
+    uart_posix_check(uart_num);
+    if (NULL == baudrate)
+        return ESP_ERR_INVALID_ARG;
+    *baudrate = uart_posix[uart_num].baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_hw_flow_ctrl(uart_port_t uart_num, uart_hw_flowcontrol_t flow_ctrl, uint8_t rx_thresh)
+{
+    (void)rx_thresh;
+    uart_posix_check(uart_num);
+    uart_posix[uart_num].flow_ctrl = flow_ctrl;
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    uart_posix_check_installed(uart_num);
+    uart_posix_port_t *p = &uart_posix[uart_num];
+    uint8_t *dst = (uint8_t *)buf;
+    uint32_t copied = 0;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t wait_ms = (uint64_t)ticks_to_wait * portTICK_PERIOD_MS;
+    deadline.tv_sec += (time_t)(wait_ms / 1000U);
+    deadline.tv_nsec += (long)(wait_ms % 1000U) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    while (copied < length)
+    {
+        if (0 == p->rx_count)
+        {
+            if (0 == ticks_to_wait)
+                break;
+            int err = (portMAX_DELAY == ticks_to_wait) ? pthread_cond_wait(&p->changed, &p->lock)
+                                                       : pthread_cond_timedwait(&p->changed, &p->lock, &deadline);
+            if (ETIMEDOUT == err)
+                break;
+            continue;
+        }
+        size_t tail = (p->rx_head + p->rx_size - p->rx_count) % p->rx_size;
+        size_t span = p->rx_size - tail;
+        size_t take = length - copied;
+        if (take > p->rx_count)
+            take = p->rx_count;
+        if (take > span)
+            take = span;
+        memcpy(&dst[copied], &p->rx_buf[tail], take);
+        copied += (uint32_t)take;
+        p->rx_count -= take;
+    }
+
+    // Pattern positions are relative to the read pointer, drop the ones that were read past
+    int kept = 0;
+    for (int idx = 0; idx < p->pattern_count; idx++)
+    {
+        int pos = p->pattern_pos[idx] - (int)copied;
+        if (pos >= 0)
+            p->pattern_pos[kept++] = pos;
+    }
+    p->pattern_count = kept;
+
+    if (copied > 0)
+    {
+        p->rx_full_posted = false;
+        pthread_cond_broadcast(&p->changed);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return (int)copied;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+    uart_posix_check_installed(uart_num);
+    const uint8_t *data = (const uint8_t *)src;
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t ret = write(uart_posix[uart_num].fd, &data[written], size - written);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            return -1;
+        }
+        written += (size_t)ret;
+    }
+    return (int)written;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait; // uart_write_bytes() only returns once the kernel has the bytes
+    uart_posix_check_installed(uart_num);
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    uart_posix_check_installed(uart_num);
+    if (NULL == size)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart_posix[uart_num].lock);
+    *size = uart_posix[uart_num].rx_count;
+    pthread_mutex_unlock(&uart_posix[uart_num].lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    uart_posix_check_installed(uart_num);
+    uart_posix_port_t *p = &uart_posix[uart_num];
+    pthread_mutex_lock(&p->lock);
+    p->rx_count = 0;
+    p->pattern_count = 0;
+    p->rx_full_posted = false;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_enable_pattern_det_baud_intr(uart_port_t uart_num, char pattern_chr, uint8_t chr_num,
+                                            int chr_tout, int post_idle, int pre_idle)
+{
+    (void)chr_tout;
+    (void)post_idle;
+    (void)pre_idle;
+    uart_posix_check_installed(uart_num);
+    if (1 != chr_num)
+        return ESP_ERR_INVALID_ARG; // Only single-character patterns are emulated
+    pthread_mutex_lock(&uart_posix[uart_num].lock);
+    uart_posix[uart_num].pattern_chr = pattern_chr;
+    uart_posix[uart_num].pattern_en = true;
+    pthread_mutex_unlock(&uart_posix[uart_num].lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_disable_pattern_det_intr(uart_port_t uart_num)
+{
+    uart_posix_check_installed(uart_num);
+    pthread_mutex_lock(&uart_posix[uart_num].lock);
+    uart_posix[uart_num].pattern_en = false;
+    pthread_mutex_unlock(&uart_posix[uart_num].lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_pattern_queue_reset(uart_port_t uart_num, int queue_length)
+{
+    uart_posix_check_installed(uart_num);
+    if (queue_length <= 0)
+        return ESP_ERR_INVALID_ARG;
+    uart_posix_port_t *p = &uart_posix[uart_num];
+    int *pos = malloc(sizeof(int) * (size_t)queue_length);
+    if (NULL == pos)
+        return ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&p->lock);
+    free(p->pattern_pos);
+    p->pattern_pos = pos;
+    p->pattern_len = queue_length;
+    p->pattern_count = 0;
+    pthread_mutex_unlock(&p->lock);
+    return ESP_OK;
+}
+
+int uart_pattern_pop_pos(uart_port_t uart_num)
+{
+    uart_posix_check_installed(uart_num);
+    uart_posix_port_t *p = &uart_posix[uart_num];
+    int pos = -1;
+    pthread_mutex_lock(&p->lock);
+    if (p->pattern_count > 0)
+    {
+        pos = p->pattern_pos[0];
+        memmove(&p->pattern_pos[0], &p->pattern_pos[1], sizeof(int) * (size_t)(p->pattern_count - 1));
+        p->pattern_count--;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return pos;
+}
+
+int uart_pattern_get_pos(uart_port_t uart_num)
+{
+    uart_posix_check_installed(uart_num);
+    uart_posix_port_t *p = &uart_posix[uart_num];
+    pthread_mutex_lock(&p->lock);
+    int pos = (p->pattern_count > 0) ? p->pattern_pos[0] : -1;
+    pthread_mutex_unlock(&p->lock);
+    return pos;
+}
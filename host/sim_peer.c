@@ -0,0 +1,882 @@
+/*******************************************************************************
+* Title                 :   Simulated modem peer
+* Filename              :   sim_peer.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Line-at-a-time responder, first matching prefix wins.
+*                           No echo, like the SLM with ATE0. Delays, write
+*                           fragmentation and faults come from a seeded
+*                           generator, so a scenario replays identically.
+*                           Entries without a reply are answered by models:
+*                           an echo server behind the SLM socket commands and
+*                           a binary download of any size. After AT+CMUX=0 the
+*                           link carries GSM 07.10 frames, every channel then
+*                           has its own worker thread answering its commands.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim_peer.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define SIM_PEER_LINE_SIZE                  (8192U) /* Longest command kept, the rest of a longer line is ignored */
+#define SIM_PEER_MAX_ENTRIES                (64U)   /* Table entries with a hit counter, scenario and built-in together */
+#define SIM_PEER_SCRIPT_LINE_SIZE           (4096U)
+#define SIM_PEER_SOCKETS                    (8U)
+#define SIM_PEER_SOCKET_BUF_SIZE            (4096U) /* Echoed bytes waiting for #XRECV, the rest is dropped */
+#define SIM_PEER_QUIT_STR                   "+++"   /* Ends #XSEND data mode when it ends a received chunk */
+#define SIM_PEER_HTTP_PIECE_SIZE            (1024U) /* #XHTTPCRSP payload per piece, the header shares the first one */
+#define SIM_PEER_CMUX_DLCIS                 (4U)    /* DLCI 0 (multiplexer control) and three channels */
+#define SIM_PEER_CMUX_N1                    (31U)   /* Longest information field sent, the AT+CMUX=0 default */
+#define SIM_PEER_CMUX_FRAME_SIZE            (256U)  /* Longest frame taken from the host, longer ones are dropped */
+#define SIM_PEER_CMUX_RX_SIZE               (65536U) /* Received channel data waiting for its worker */
+
+#define SIM_PEER_CMUX_FLAG                  (0xF9U)
+#define SIM_PEER_CMUX_EA                    (0x01U)
+#define SIM_PEER_CMUX_CR                    (0x02U)
+#define SIM_PEER_CMUX_PF                    (0x10U)
+#define SIM_PEER_CMUX_SABM                  (0x2FU)
+#define SIM_PEER_CMUX_UA                    (0x63U)
+#define SIM_PEER_CMUX_DISC                  (0x43U)
+#define SIM_PEER_CMUX_UIH                   (0xEFU)
+#define SIM_PEER_CMUX_UI                    (0x03U)
+#define SIM_PEER_CMUX_MSG_NSC               (0x10U)
+#define SIM_PEER_CMUX_MSG_TEST              (0x20U)
+#define SIM_PEER_CMUX_MSG_CLD               (0xC0U)
+#define SIM_PEER_CMUX_MSG_MSC               (0xE0U)
+#define SIM_PEER_CMUX_V24_FC                (0x02U)
+
+/* One stored credential as listed by AT%CMNG=1: sec tag, type, SHA-256 */
+#define SIM_PEER_CMNG_LINE  "%CMNG: 12354,0,\"2C43952EE9E000FF2ACC4E2ED0897C0A72AD5FA72C3D934E81741CBD54F05BD1\"\r\n"
+#define SIM_PEER_CMNG_4     SIM_PEER_CMNG_LINE SIM_PEER_CMNG_LINE SIM_PEER_CMNG_LINE SIM_PEER_CMNG_LINE
+#define SIM_PEER_CMNG_16    SIM_PEER_CMNG_4 SIM_PEER_CMNG_4 SIM_PEER_CMNG_4 SIM_PEER_CMNG_4
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+typedef struct
+{
+    int fd;
+    const sim_peer_reply_t *table;
+} sim_peer_t;
+
+typedef struct
+{
+    bool open;
+    size_t echo_len;
+    char echo[SIM_PEER_SOCKET_BUF_SIZE];
+} sim_peer_socket_t;
+
+// Command line assembly of one byte stream: the plain link, or one multiplexer channel
+typedef struct
+{
+    char line[SIM_PEER_LINE_SIZE];
+    size_t line_len;
+    unsigned long data_left;
+    const char *after_data;
+    bool skip_lf;               // "\n" of the "\r\n" that started data mode is not data
+    bool in_quotes;             // CR/LF inside a quoted argument (HTTP headers) do not end the command
+} sim_peer_stream_t;
+
+// Multiplexer channel: the reader thread queues its data, a worker thread answers it (guarded by sim_peer_cmux_lock)
+typedef struct
+{
+    bool open;
+    bool host_fc;               // Host asked to hold the channel off (MSC FC)
+    bool worker;                // Worker thread started
+    size_t rx_len;
+    char rx[SIM_PEER_CMUX_RX_SIZE];
+    sim_peer_stream_t stream;
+} sim_peer_dlci_t;
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static const sim_peer_reply_t sim_peer_default_table[] = {
+    { .prefix = "AT+CESQ",        .reply = "\r\n+CESQ: 99,99,255,255,31,62\r\n\r\nOK\r\n" },
+    { .prefix = "AT+COPS?",       .reply = "\r\n+COPS: 0,2,\"26201\",7\r\n+CEREG: 1,\"0A1B\",\"01234567\",7\r\n\r\nOK\r\n" }, /* Registration URC inside the response */
+    { .prefix = "AT+CFUN?",       .reply = "\r\n+CFUN: 1\r\n\r\nOK\r\n" },
+    { .prefix = "AT+CPIN?",       .reply = "\r\n+CPIN: READY\r\n\r\nOK\r\n" },
+    { .prefix = "AT#XCARRIER",    .reply = "\r\n#XCARRIER: UTC_TIME: 2022-12-30T14:56:46Z, UTC_OFFSET: 60, TIMEZONE: Europe/Paris\r\n\r\nOK\r\n" },
+    { .prefix = "AT%CMNG=1",      .reply = "\r\n" SIM_PEER_CMNG_16 SIM_PEER_CMNG_16 "\r\nOK\r\n" }, /* Longer than one mailbox */
+    { .prefix = "AT#XHTTPCCON=1", .reply = "\r\n#XHTTPCCON: 1\r\n\r\nOK\r\n" },
+    { .prefix = "AT#XHTTPCCON=0", .reply = "\r\n#XHTTPCCON: 0\r\n\r\nOK\r\n" },
+    { .prefix = "AT#XHTTPCREQ=\"POST\"",   /* Data mode for <content_length> bytes, then the request goes out */
+                        .reply = "\r\n#XHTTPCREQ: 1\r\n",
+                        .after_data = "\r\n#XHTTPCREQ: 0\r\n"
+                        "\r\n#XHTTPCRSP:43,0\r\n"
+                        "HTTP/1.1 201 Created\r\n"
+                        "Content-Length: 0\r\n"
+                        "\r\n"
+                        "\r\n#XHTTPCRSP:0,1\r\n" },
+    { .prefix = "AT#XHTTPCREQ=\"GET\",\"/bin/", .reply = NULL }, /* "/bin/<size>": sim_peer_download_byte() body, Range and ?cut=<n> */
+    { .prefix = "AT#XHTTPCREQ=\"GET\",\"/raw\"", /* Payload made of AT syntax, only the announced lengths tell it apart */
+                        .reply = "\r\nOK\r\n\r\n#XHTTPCREQ: 0\r\n"
+                        "\r\n#XHTTPCRSP:79,0\r\n"
+                        "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: application/octet-stream\r\n"
+                        "Content-Length: 39\r\n"
+                        "\r\n"
+                        "\r\n#XHTTPCRSP:22,0\r\n"
+                        "\r\nOK\r\n#XHTTPCRSP:0,1\r\n"
+                        "\r\n#XHTTPCRSP:17,0\r\n"
+                        "+CME ERROR: 3\r\n\r\n"
+                        "\r\n#XHTTPCRSP:0,1\r\n" },
+    { .prefix = "AT#XHTTPCREQ=\"GET\"",    /* Header lines start with "\r\n", the <len> payload bytes follow raw */
+                        .reply = "\r\nOK\r\n\r\n#XHTTPCREQ: 0\r\n"
+                        "\r\n#XHTTPCRSP:95,0\r\n"
+                        "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: application/json\r\n"
+                        "Content-Length: 15\r\n"
+                        "Connection: keep-alive\r\n"
+                        "\r\n"
+                        "\r\n#XHTTPCRSP:15,0\r\n"
+                        "{\"status\":\"ok\"}"
+                        "\r\n#XHTTPCRSP:0,1\r\n" },
+    { .prefix = "AT#XSOCKET=",    .reply = NULL },     /* Echo socket model */
+    { .prefix = "AT#XSSOCKET=",   .reply = NULL },
+    { .prefix = "AT#XSOCKETSELECT=", .reply = NULL },
+    { .prefix = "AT#XCONNECT=",   .reply = NULL },
+    { .prefix = "AT#XSEND",       .reply = NULL },
+    { .prefix = "AT#XRECV=",      .reply = NULL },
+    { .prefix = "AT#XAPOLL=",     .reply = NULL },
+    { .prefix = "AT+CMUX=0",      .reply = NULL },     /* GSM 07.10 multiplexer until CLD */
+    { .prefix = "AT",             .reply = "\r\nOK\r\n" },
+    { .prefix = NULL,             .reply = NULL },
+};
+
+static sim_peer_t sim_peer;
+static volatile uint32_t sim_peer_cmd_count = 0;
+static volatile uint32_t sim_peer_hits[SIM_PEER_MAX_ENTRIES];
+static volatile uint32_t sim_peer_fault_count = 0;
+
+static sim_peer_config_t sim_peer_config = { .seed = 1 };
+static uint32_t sim_peer_random_state = 1;
+static sim_peer_reply_t sim_peer_script_table[SIM_PEER_MAX_ENTRIES + 1];
+static bool sim_peer_script_loaded = false;
+
+// Peer thread, or the worker of the channel that sends the socket commands
+static sim_peer_socket_t sim_peer_socket[SIM_PEER_SOCKETS];
+static int sim_peer_socket_selected = -1;
+static bool sim_peer_socket_poll = false;       // #XAPOLL on: new echo data is reported
+static bool sim_peer_socket_data_mode = false;  // #XSEND: data until SIM_PEER_QUIT_STR
+static uint8_t sim_peer_socket_data_dlci = 0;   // Channel in data mode, the others still take commands
+
+static pthread_mutex_t sim_peer_random_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t sim_peer_tx_lock = PTHREAD_MUTEX_INITIALIZER;       // One write (frame) at a time on fd
+static pthread_mutex_t sim_peer_cmux_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_peer_cmux_cond = PTHREAD_COND_INITIALIZER;       // Channel data queued or flow control changed
+static volatile bool sim_peer_cmux = false;     // Frames on fd instead of plain AT lines
+static sim_peer_dlci_t sim_peer_dlci[SIM_PEER_CMUX_DLCIS];
+static _Thread_local uint8_t sim_peer_cur_dlci = 0; // Channel answered by this thread, 0 on the plain link
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+// xorshift32, uniform in [0, 1)
+static double __sim_peer_random(void)
+{
+    pthread_mutex_lock(&sim_peer_random_lock); // Channel workers draw concurrently
+    uint32_t x = sim_peer_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim_peer_random_state = x;
+    pthread_mutex_unlock(&sim_peer_random_lock);
+    return (double)x / 4294967296.0;
+}
+
+static void __sim_peer_sleep_us(uint32_t us)
+{
+    struct timespec ts = { .tv_sec = us / 1000000U, .tv_nsec = (long)(us % 1000000U) * 1000L };
+    while ((nanosleep(&ts, &ts) != 0) && (EINTR == errno))
+        ;
+}
+
+static void __sim_peer_write_raw(const sim_peer_t *peer, const char *data, size_t len)
+{
+    size_t written = 0;
+    while (written < len)
+    {
+        ssize_t ret = write(peer->fd, &data[written], len - written);
+        if ((ret < 0) && (EINTR != errno))
+            return;
+        if (ret > 0)
+            written += (size_t)ret;
+    }
+}
+
+// GSM 07.10 FCS: reflected CRC-8 (x^8 + x^2 + x + 1) over the address, control and length octets (and the
+// information of UI frames), sent inverted
+static uint8_t __sim_peer_fcs(const uint8_t *data, size_t len)
+{
+    uint8_t fcs = 0xFF;
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        fcs ^= data[idx];
+        for (uint8_t bit = 0; bit < 8; bit++)
+            fcs = (fcs & 0x01U) ? (uint8_t)((fcs >> 1) ^ 0xE0U) : (uint8_t)(fcs >> 1);
+    }
+    return fcs;
+}
+
+// One frame from the modem side: its commands clear C/R, its responses set it
+static void __sim_peer_cmux_frame(const sim_peer_t *peer, uint8_t dlci, uint8_t ctrl, bool response, const uint8_t *info, size_t len)
+{
+    uint8_t frame[SIM_PEER_CMUX_N1 + 6];
+    size_t frame_len = 0;
+    frame[frame_len++] = SIM_PEER_CMUX_FLAG;
+    frame[frame_len++] = (uint8_t)((dlci << 2) | (response ? SIM_PEER_CMUX_CR : 0) | SIM_PEER_CMUX_EA);
+    frame[frame_len++] = ctrl;
+    frame[frame_len++] = (uint8_t)((len << 1) | SIM_PEER_CMUX_EA);
+    memcpy(&frame[frame_len], info, len);
+    frame_len += len;
+    uint8_t fcs = __sim_peer_fcs(&frame[1], (SIM_PEER_CMUX_UI == ctrl) ? 3 + len : 3);
+    frame[frame_len++] = (uint8_t)(0xFF - fcs);
+    frame[frame_len++] = SIM_PEER_CMUX_FLAG;
+    pthread_mutex_lock(&sim_peer_tx_lock);
+    __sim_peer_write_raw(peer, (const char *)frame, frame_len);
+    pthread_mutex_unlock(&sim_peer_tx_lock);
+}
+
+// Plain link: as is. Multiplexer channel: UIH frames of up to SIM_PEER_CMUX_N1 bytes, held while the host says so
+static void __sim_peer_write_all(const sim_peer_t *peer, const char *data, size_t len)
+{
+    uint8_t dlci = sim_peer_cur_dlci;
+    if (0 == dlci)
+    {
+        pthread_mutex_lock(&sim_peer_tx_lock);
+        __sim_peer_write_raw(peer, data, len);
+        pthread_mutex_unlock(&sim_peer_tx_lock);
+        return;
+    }
+    for (size_t offset = 0; offset < len; offset += SIM_PEER_CMUX_N1)
+    {
+        pthread_mutex_lock(&sim_peer_cmux_lock);
+        while (sim_peer_cmux && sim_peer_dlci[dlci].host_fc)
+            pthread_cond_wait(&sim_peer_cmux_cond, &sim_peer_cmux_lock);
+        bool open = sim_peer_cmux && sim_peer_dlci[dlci].open;
+        pthread_mutex_unlock(&sim_peer_cmux_lock);
+        if (!open)
+            return; // Channel closed meanwhile, the rest is lost as on a real modem
+        size_t piece = (len - offset < SIM_PEER_CMUX_N1) ? len - offset : SIM_PEER_CMUX_N1;
+        __sim_peer_cmux_frame(peer, dlci, SIM_PEER_CMUX_UIH, false, (const uint8_t *)&data[offset], piece);
+    }
+}
+
+// Reply of len bytes after the scenario latency (+ entry latency, +/- jitter), cut into fragments
+static void __sim_peer_write_len(const sim_peer_t *peer, const char *reply, size_t len, uint32_t latency_us)
+{
+    int64_t delay_us = (int64_t)sim_peer_config.latency_us + latency_us;
+    if (0 != sim_peer_config.jitter_us)
+        delay_us += (int64_t)((__sim_peer_random() * 2.0 - 1.0) * sim_peer_config.jitter_us);
+    if (delay_us > 0)
+        __sim_peer_sleep_us((uint32_t)delay_us);
+
+    size_t fragment = (0 != sim_peer_config.fragment) ? sim_peer_config.fragment : len;
+    for (size_t offset = 0; offset < len; offset += fragment)
+    {
+        if ((0 != offset) && (0 != sim_peer_config.gap_us))
+            __sim_peer_sleep_us(sim_peer_config.gap_us);
+        __sim_peer_write_all(peer, &reply[offset], (len - offset < fragment) ? len - offset : fragment);
+    }
+}
+
+static void __sim_peer_write(const sim_peer_t *peer, const char *reply, uint32_t latency_us)
+{
+    __sim_peer_write_len(peer, reply, strlen(reply), latency_us);
+}
+
+// Echo server behind the SLM socket commands: whatever is sent on a socket can be received back from it
+static void __sim_peer_socket(const sim_peer_t *peer, const char *line, uint32_t latency_us)
+{
+    static char reply[SIM_PEER_SOCKET_BUF_SIZE + 64];
+    sim_peer_socket_t *sock = (sim_peer_socket_selected >= 0) ? &sim_peer_socket[sim_peer_socket_selected] : NULL;
+    int type, handle = -1;
+    size_t len = 0;
+    bool secure = (strncmp(line, "AT#XSSOCKET=1,", 14) == 0);
+    if ((sscanf(line, "AT#XSOCKET=1,%d", &type) == 1) || (secure && (sscanf(line + 14, "%d", &type) == 1)))
+    {
+        for (int idx = 0; (idx < (int)SIM_PEER_SOCKETS) && (handle < 0); idx++)
+            handle = sim_peer_socket[idx].open ? -1 : idx;
+        if (handle >= 0)
+        {
+            sim_peer_socket[handle].open = true;
+            sim_peer_socket[handle].echo_len = 0;
+            sim_peer_socket_selected = handle;
+            len = (size_t)snprintf(reply, sizeof(reply), "\r\n#X%sSOCKET: %d,%d,%d\r\n\r\nOK\r\n", secure ? "S" : "",
+                                   handle, type, (1 == type) ? 6 : 17);
+        }
+    }
+    else if ((strcmp(line, "AT#XSOCKET=0") == 0) && (NULL != sock))
+    {
+        sock->open = false;
+        sim_peer_socket_selected = -1;
+        len = (size_t)snprintf(reply, sizeof(reply), "\r\n#XSOCKET: 0,\"closed\"\r\n\r\nOK\r\n");
+    }
+    else if ((sscanf(line, "AT#XSOCKETSELECT=%d", &handle) == 1) && (handle >= 0) && (handle < (int)SIM_PEER_SOCKETS) &&
+             sim_peer_socket[handle].open)
+    {
+        sim_peer_socket_selected = handle;
+        len = (size_t)snprintf(reply, sizeof(reply), "\r\n#XSOCKETSELECT: %d\r\n\r\nOK\r\n", handle);
+    }
+    else if ((strncmp(line, "AT#XCONNECT=", 12) == 0) && (NULL != sock))
+        len = (size_t)snprintf(reply, sizeof(reply), "\r\n#XCONNECT: 1\r\n\r\nOK\r\n");
+    else if ((strcmp(line, "AT#XSEND") == 0) && (NULL != sock))
+    {
+        sim_peer_socket_data_mode = true;
+        sim_peer_socket_data_dlci = sim_peer_cur_dlci;
+        len = (size_t)snprintf(reply, sizeof(reply), "\r\nOK\r\n");
+    }
+    else if ((strncmp(line, "AT#XRECV=", 9) == 0) && (NULL != sock) && (0 != sock->echo_len))
+    {
+        // Raw payload after the header line, the final OK after the payload
+        len = (size_t)snprintf(reply, sizeof(reply), "\r\n#XRECV: %zu\r\n", sock->echo_len);
+        memcpy(&reply[len], sock->echo, sock->echo_len);
+        len += sock->echo_len;
+        len += (size_t)snprintf(&reply[len], sizeof(reply) - len, "\r\nOK\r\n");
+        sock->echo_len = 0;
+    }
+    else if (strncmp(line, "AT#XAPOLL=", 10) == 0)
+    {
+        sim_peer_socket_poll = ('1' == line[10]);
+        len = (size_t)snprintf(reply, sizeof(reply), "\r\nOK\r\n");
+    }
+    if (0 == len)
+        len = (size_t)snprintf(reply, sizeof(reply), "\r\nERROR\r\n"); // No such socket, or nothing to receive
+    __sim_peer_write_len(peer, reply, len, latency_us);
+}
+
+// GET "/bin/<size>[?cut=<n>]": <size> bytes of every value, NUL, CR, LF and "+++" included, the header ends inside
+// a piece. "Range: bytes=<from>-" gets 206 and the rest from <from>. Without a range, cut=<n> ends the response after
+// <n> body bytes as a dropped connection would
+static void __sim_peer_download(const sim_peer_t *peer, const char *line, uint32_t latency_us)
+{
+    char *end;
+    unsigned long size = strtoul(line + strlen("AT#XHTTPCREQ=\"GET\",\"/bin/"), &end, 10);
+    unsigned long cut = (strncmp(end, "?cut=", 5) == 0) ? strtoul(end + 5, NULL, 10) : size;
+    const char *range = strstr(line, "Range: bytes=");
+    unsigned long from = (NULL != range) ? strtoul(range + strlen("Range: bytes="), NULL, 10) : 0;
+    char header[160];
+    int header_len;
+    if ((NULL != range) && (from < size))
+        header_len = snprintf(header, sizeof(header), "HTTP/1.1 206 Partial Content\r\nContent-Type: application/octet-stream\r\n"
+                                                      "Content-Range: bytes %lu-%lu/%lu\r\nContent-Length: %lu\r\n\r\n",
+                                                      from, size - 1, size, size - from);
+    else if (NULL != range)
+        header_len = snprintf(header, sizeof(header), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n");
+    else
+        header_len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                                                      "Content-Length: %lu\r\n\r\n", size);
+    unsigned long body_len = (from < size) ? size - from : 0;
+    if ((NULL == range) && (cut < body_len))
+        body_len = cut;
+    size_t total = (size_t)header_len + body_len;
+    char *payload = malloc(total);
+    char *reply = malloc(total + (total / SIM_PEER_HTTP_PIECE_SIZE + 4) * 32);
+    if ((NULL == payload) || (NULL == reply))
+    {
+        free(payload);
+        free(reply);
+        __sim_peer_write(peer, "\r\nERROR\r\n", latency_us);
+        return;
+    }
+    memcpy(payload, header, (size_t)header_len);
+    for (unsigned long offset = 0; offset < body_len; offset++)
+        payload[header_len + offset] = (char)sim_peer_download_byte((uint32_t)(from + offset));
+
+    size_t len = (size_t)sprintf(reply, "\r\nOK\r\n\r\n#XHTTPCREQ: 0\r\n");
+    for (size_t offset = 0; offset < total; offset += SIM_PEER_HTTP_PIECE_SIZE)
+    {
+        size_t piece = (total - offset < SIM_PEER_HTTP_PIECE_SIZE) ? total - offset : SIM_PEER_HTTP_PIECE_SIZE;
+        len += (size_t)sprintf(&reply[len], "\r\n#XHTTPCRSP:%zu,0\r\n", piece);
+        memcpy(&reply[len], &payload[offset], piece);
+        len += piece;
+    }
+    len += (size_t)sprintf(&reply[len], "\r\n#XHTTPCRSP:0,1\r\n");
+    __sim_peer_write_len(peer, reply, len, latency_us);
+    free(payload);
+    free(reply);
+}
+
+// End of #XSEND data mode: data (terminator removed) goes to the selected socket's echo buffer
+static void __sim_peer_socket_sent(const sim_peer_t *peer, const char *data, size_t len)
+{
+    char urc[32];
+    sim_peer_socket_t *sock = &sim_peer_socket[sim_peer_socket_selected];
+    bool was_empty = (0 == sock->echo_len);
+    size_t copy_len = (len < sizeof(sock->echo) - sock->echo_len) ? len : sizeof(sock->echo) - sock->echo_len;
+    memcpy(&sock->echo[sock->echo_len], data, copy_len);
+    sock->echo_len += copy_len;
+    __sim_peer_write(peer, "\r\n#XDATAMODE: 0\r\n", 0);
+    if (sim_peer_socket_poll && was_empty && (0 != sock->echo_len))
+    {
+        snprintf(urc, sizeof(urc), "\r\n#XAPOLL: %d,1\r\n", sim_peer_socket_selected);
+        __sim_peer_write(peer, urc, 0);
+    }
+}
+
+// Returns the matching entry, NULL if none (ERROR sent) or a fault was injected
+static const sim_peer_reply_t *__sim_peer_reply(const sim_peer_t *peer, const char *line)
+{
+    double fault = ((0.0 != sim_peer_config.drop_rate) || (0.0 != sim_peer_config.error_rate)) ? __sim_peer_random() : 1.0;
+    for (const sim_peer_reply_t *entry = peer->table; NULL != entry->prefix; entry++)
+    {
+        if (strncmp(line, entry->prefix, strlen(entry->prefix)) != 0)
+            continue;
+        size_t entry_idx = (size_t)(entry - peer->table);
+        if (entry_idx < SIM_PEER_MAX_ENTRIES)
+            __atomic_add_fetch(&sim_peer_hits[entry_idx], 1, __ATOMIC_RELAXED);
+        if (fault < sim_peer_config.drop_rate + sim_peer_config.error_rate)
+        {
+            __atomic_add_fetch(&sim_peer_fault_count, 1, __ATOMIC_RELAXED);
+            if (fault >= sim_peer_config.drop_rate)
+                __sim_peer_write(peer, "\r\nERROR\r\n", entry->latency_us);
+            return NULL;
+        }
+        if ((NULL == entry->reply) && (strncmp(line, "AT#XHTTPCREQ", 12) == 0))
+            __sim_peer_download(peer, line, entry->latency_us);
+        else if ((NULL == entry->reply) && (strncmp(line, "AT+CMUX=", 8) == 0))
+        {
+            // Only from the plain link, frames follow the OK
+            __sim_peer_write(peer, (0 == sim_peer_cur_dlci) ? "\r\nOK\r\n" : "\r\nERROR\r\n", entry->latency_us);
+            sim_peer_cmux |= (0 == sim_peer_cur_dlci);
+        }
+        else if (NULL == entry->reply)
+            __sim_peer_socket(peer, line, entry->latency_us);
+        else
+            __sim_peer_write(peer, entry->reply, entry->latency_us);
+        return entry;
+    }
+    __sim_peer_write(peer, "\r\nERROR\r\n", 0);
+    return NULL;
+}
+
+// Next word or "quoted string" (C escapes \r \n \t \" \\ \xHH, decoded in place), NULL at the end or a '#' comment
+static char *__sim_peer_token(char **cursor)
+{
+    char *src = *cursor;
+    while ((' ' == *src) || ('\t' == *src) || ('\r' == *src) || ('\n' == *src))
+        src++;
+    if (('\0' == *src) || ('#' == *src))
+        return NULL;
+    char *token = src;
+    if ('"' != *src)
+    {
+        while (('\0' != *src) && (' ' != *src) && ('\t' != *src) && ('\r' != *src) && ('\n' != *src))
+            src++;
+        if ('\0' != *src)
+            *src++ = '\0';
+        *cursor = src;
+        return token;
+    }
+    char *dst = ++token;
+    for (src = token; ('\0' != *src) && ('"' != *src); src++)
+    {
+        if (('\\' != *src) || ('\0' == src[1]))
+        {
+            *dst++ = *src;
+            continue;
+        }
+        switch (*++src)
+        {
+            case 'r':   *dst++ = '\r'; break;
+            case 'n':   *dst++ = '\n'; break;
+            case 't':   *dst++ = '\t'; break;
+            case 'x':
+            {
+                char hex[3] = {0};
+                for (int digit = 0; (digit < 2) && isxdigit((unsigned char)src[1]); digit++)
+                    hex[digit] = *++src;
+                *dst++ = (char)strtoul(hex, NULL, 16);
+                break;
+            }
+            default:    *dst++ = *src; break; // \" and \\ and anything else as is
+        }
+    }
+    if ('"' == *src)
+        src++;
+    *dst = '\0';
+    *cursor = src;
+    return token;
+}
+
+/**
+ * Run received bytes through the command line assembly of stream, answering each complete command
+ * Returns the bytes used up, less than len once AT+CMUX=0 turned the plain link into frames
+ */
+static size_t __sim_peer_feed(const sim_peer_t *peer, sim_peer_stream_t *stream, const char *chunk, size_t len)
+{
+    bool plain = !sim_peer_cmux;
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        char c = chunk[idx];
+        if (stream->skip_lf && ('\n' == c))
+        {
+            stream->skip_lf = false;
+            continue;
+        }
+        stream->skip_lf = false;
+        bool data_mode = sim_peer_socket_data_mode && (sim_peer_socket_data_dlci == sim_peer_cur_dlci);
+        if (data_mode)
+        {
+            if (stream->line_len < sizeof(stream->line))
+                stream->line[stream->line_len++] = c;
+            size_t quit_len = strlen(SIM_PEER_QUIT_STR);
+            if ((idx == len - 1) && (stream->line_len >= quit_len) &&
+                (memcmp(&stream->line[stream->line_len - quit_len], SIM_PEER_QUIT_STR, quit_len) == 0))
+            {
+                sim_peer_socket_data_mode = false;
+                __sim_peer_socket_sent(peer, stream->line, stream->line_len - quit_len);
+                stream->line_len = 0;
+            }
+            continue;
+        }
+        if (0 != stream->data_left)
+        {
+            if (0 == --stream->data_left)
+                __sim_peer_write(peer, stream->after_data, 0);
+            continue;
+        }
+        if ('"' == c)
+            stream->in_quotes = !stream->in_quotes;
+        if ((('\r' != c) && ('\n' != c)) || stream->in_quotes)
+        {
+            if (stream->line_len < sizeof(stream->line) - 1)
+                stream->line[stream->line_len++] = c;
+            continue;
+        }
+        if (0 == stream->line_len)
+            continue; // "\n" of "\r\n", or an empty line
+        stream->line[stream->line_len] = '\0';
+        stream->line_len = 0;
+        const sim_peer_reply_t *entry = __sim_peer_reply(peer, stream->line);
+        if ((NULL != entry) && (NULL != entry->after_data))
+        {
+            const char *count = strrchr(stream->line, ',');
+            stream->after_data = entry->after_data;
+            stream->data_left = (NULL != count) ? strtoul(count + 1, NULL, 10) : 0;
+            stream->skip_lf = ('\r' == c);
+            if (0 == stream->data_left)
+                __sim_peer_write(peer, stream->after_data, 0);
+        }
+        else if (sim_peer_socket_data_mode && (sim_peer_socket_data_dlci == sim_peer_cur_dlci))
+            stream->skip_lf = ('\r' == c);
+        __atomic_add_fetch(&sim_peer_cmd_count, 1, __ATOMIC_RELAXED);
+        if (plain && sim_peer_cmux)
+            return idx + 1;
+    }
+    return len;
+}
+
+// Worker of one multiplexer channel: answers what the reader thread queued for it, replies go out on the channel
+static void *__sim_peer_cmux_worker(void *arg)
+{
+    sim_peer_t *peer = &sim_peer;
+    sim_peer_cur_dlci = (uint8_t)(uintptr_t)arg;
+    sim_peer_dlci_t *chan = &sim_peer_dlci[sim_peer_cur_dlci];
+    char *chunk = malloc(SIM_PEER_CMUX_RX_SIZE);
+    while (NULL != chunk)
+    {
+        pthread_mutex_lock(&sim_peer_cmux_lock);
+        while (0 == chan->rx_len)
+            pthread_cond_wait(&sim_peer_cmux_cond, &sim_peer_cmux_lock);
+        size_t len = chan->rx_len;
+        memcpy(chunk, chan->rx, len);
+        chan->rx_len = 0;
+        pthread_mutex_unlock(&sim_peer_cmux_lock);
+        __sim_peer_feed(peer, &chan->stream, chunk, len);
+    }
+    return NULL;
+}
+
+// Control channel message from the host: answered with the same message as a response
+static void __sim_peer_cmux_control(const sim_peer_t *peer, const uint8_t *info, size_t len)
+{
+    if ((len < 2) || !(info[0] & SIM_PEER_CMUX_CR))
+        return; // Responses to nothing this side sent
+    uint8_t type = info[0] & (uint8_t)~(SIM_PEER_CMUX_CR | SIM_PEER_CMUX_EA);
+    size_t value_len = info[1] >> 1;
+    if (value_len > len - 2)
+        return;
+    const uint8_t *value = &info[2];
+    uint8_t msg[2 + SIM_PEER_CMUX_N1];
+    if ((type == SIM_PEER_CMUX_MSG_MSC) && (value_len >= 2) && ((value[0] >> 2) < SIM_PEER_CMUX_DLCIS))
+    {
+        pthread_mutex_lock(&sim_peer_cmux_lock);
+        sim_peer_dlci[value[0] >> 2].host_fc = (value[1] & SIM_PEER_CMUX_V24_FC) != 0;
+        pthread_cond_broadcast(&sim_peer_cmux_cond);
+        pthread_mutex_unlock(&sim_peer_cmux_lock);
+    }
+    else if ((type != SIM_PEER_CMUX_MSG_CLD) && (type != SIM_PEER_CMUX_MSG_TEST))
+    {
+        msg[0] = SIM_PEER_CMUX_MSG_NSC | SIM_PEER_CMUX_EA;
+        msg[1] = (1 << 1) | SIM_PEER_CMUX_EA;
+        msg[2] = info[0];
+        __sim_peer_cmux_frame(peer, 0, SIM_PEER_CMUX_UIH, false, msg, 3);
+        return;
+    }
+    value_len = (value_len < SIM_PEER_CMUX_N1 - 2) ? value_len : SIM_PEER_CMUX_N1 - 2;
+    msg[0] = (uint8_t)(type | SIM_PEER_CMUX_EA);
+    msg[1] = (uint8_t)((value_len << 1) | SIM_PEER_CMUX_EA);
+    memcpy(&msg[2], value, value_len);
+    __sim_peer_cmux_frame(peer, 0, SIM_PEER_CMUX_UIH, false, msg, 2 + value_len);
+    if (type == SIM_PEER_CMUX_MSG_CLD)
+    {
+        // Back to plain AT: whatever the channels were doing is dropped
+        pthread_mutex_lock(&sim_peer_cmux_lock);
+        sim_peer_cmux = false;
+        for (uint8_t dlci = 0; dlci < SIM_PEER_CMUX_DLCIS; dlci++)
+        {
+            sim_peer_dlci[dlci].open = false;
+            sim_peer_dlci[dlci].host_fc = false;
+        }
+        pthread_cond_broadcast(&sim_peer_cmux_cond);
+        pthread_mutex_unlock(&sim_peer_cmux_lock);
+    }
+}
+
+// A frame with a good FCS from the host
+static void __sim_peer_cmux_rx(const sim_peer_t *peer, const uint8_t *frame, size_t len)
+{
+    uint8_t dlci = frame[0] >> 2;
+    uint8_t ctrl = frame[1] & (uint8_t)~SIM_PEER_CMUX_PF;
+    size_t info_len = frame[2] >> 1;
+    const uint8_t *info = &frame[3];
+    if ((dlci >= SIM_PEER_CMUX_DLCIS) || (3 + info_len > len))
+        return;
+    sim_peer_dlci_t *chan = &sim_peer_dlci[dlci];
+    switch (ctrl)
+    {
+        case SIM_PEER_CMUX_SABM:
+        case SIM_PEER_CMUX_DISC:
+        {
+            pthread_t thread;
+            pthread_mutex_lock(&sim_peer_cmux_lock);
+            chan->open = (SIM_PEER_CMUX_SABM == ctrl);
+            chan->host_fc = false;
+            chan->rx_len = 0;
+            memset(&chan->stream, 0, sizeof(chan->stream));
+            if ((0 != dlci) && chan->open && !chan->worker &&
+                (pthread_create(&thread, NULL, __sim_peer_cmux_worker, (void *)(uintptr_t)dlci) == 0))
+            {
+                chan->worker = true;
+                pthread_detach(thread);
+            }
+            pthread_cond_broadcast(&sim_peer_cmux_cond);
+            pthread_mutex_unlock(&sim_peer_cmux_lock);
+            __sim_peer_cmux_frame(peer, dlci, SIM_PEER_CMUX_UA | SIM_PEER_CMUX_PF, true, NULL, 0);
+            break;
+        }
+        case SIM_PEER_CMUX_UIH:
+            if (0 == dlci)
+                __sim_peer_cmux_control(peer, info, info_len);
+            else
+            {
+                pthread_mutex_lock(&sim_peer_cmux_lock);
+                if (chan->open && (chan->rx_len + info_len <= sizeof(chan->rx)))
+                {
+                    memcpy(&chan->rx[chan->rx_len], info, info_len);
+                    chan->rx_len += info_len;
+                    pthread_cond_broadcast(&sim_peer_cmux_cond);
+                }
+                pthread_mutex_unlock(&sim_peer_cmux_lock);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void *__sim_peer_task(void *arg)
+{
+    sim_peer_t *peer = (sim_peer_t *)arg;
+    static sim_peer_stream_t stream;    // The plain link
+    static uint8_t frame[SIM_PEER_CMUX_FRAME_SIZE];
+    size_t frame_len = 0;
+    bool in_frame = false;
+    char chunk[256];
+    while (1)
+    {
+        ssize_t read_len = read(peer->fd, chunk, sizeof(chunk));
+        if ((read_len < 0) && (EINTR == errno))
+            continue;
+        if (read_len <= 0)
+            break;
+        size_t idx = 0;
+        if (!sim_peer_cmux)
+        {
+            idx = __sim_peer_feed(peer, &stream, chunk, (size_t)read_len);
+            if (sim_peer_cmux)
+            {
+                memset(&stream, 0, sizeof(stream));
+                in_frame = false;
+            }
+        }
+        // Flag, address, control, length (one octet from the host), information, FCS, flag. Information is not
+        // escaped, only the length tells where it ends
+        for (; sim_peer_cmux && (idx < (size_t)read_len); idx++)
+        {
+            uint8_t byte = (uint8_t)chunk[idx];
+            if (!in_frame || ((0 == frame_len) && (SIM_PEER_CMUX_FLAG == byte)))
+            {
+                in_frame = (SIM_PEER_CMUX_FLAG == byte);
+                frame_len = 0;
+                continue;
+            }
+            frame[frame_len++] = byte;
+            if ((frame_len < 4) || (frame_len < 3 + (size_t)(frame[2] >> 1) + 2))
+                continue;
+            if ((SIM_PEER_CMUX_FLAG == byte) && ((uint8_t)(__sim_peer_fcs(frame, 3) + frame[frame_len - 2]) == 0xFFU))
+                __sim_peer_cmux_rx(peer, frame, frame_len - 2);
+            in_frame = false; // The next frame opens with its own flag
+        }
+    }
+    return NULL;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+/*
+ * Scenario script, one directive per line, '#' starts a comment:
+ *   seed <n> | latency <us> | jitter <us> | fragment <bytes> | gap <us> | error <rate> | drop <rate>
+ *   reply "<prefix>" "<reply>" ["<after data>"]    matched before the built-in replies, in script order
+ *   delay "<prefix>" <us>                           extra latency for the replies with exactly this prefix
+ */
+int sim_peer_load(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (NULL == file)
+    {
+        perror(path);
+        return -1;
+    }
+    static char text[SIM_PEER_SCRIPT_LINE_SIZE];
+    size_t entry_count = 0;
+    struct { char *prefix; uint32_t latency_us; } delay[SIM_PEER_MAX_ENTRIES];
+    size_t delay_count = 0;
+    unsigned line_no = 0;
+    int ret = 0;
+    while ((0 == ret) && (NULL != fgets(text, sizeof(text), file)))
+    {
+        line_no++;
+        char *cursor = text;
+        char *directive = __sim_peer_token(&cursor);
+        if (NULL == directive)
+            continue;
+        char *arg[3] = { __sim_peer_token(&cursor), NULL, NULL };
+        arg[1] = (NULL != arg[0]) ? __sim_peer_token(&cursor) : NULL;
+        arg[2] = (NULL != arg[1]) ? __sim_peer_token(&cursor) : NULL;
+        if ((strcmp(directive, "reply") == 0) && (NULL != arg[1]) && (entry_count < SIM_PEER_MAX_ENTRIES))
+        {
+            sim_peer_script_table[entry_count++] = (sim_peer_reply_t){ .prefix = strdup(arg[0]), .reply = strdup(arg[1]),
+                                                                       .after_data = (NULL != arg[2]) ? strdup(arg[2]) : NULL };
+        }
+        else if ((strcmp(directive, "delay") == 0) && (NULL != arg[1]) && (delay_count < SIM_PEER_MAX_ENTRIES))
+        {
+            delay[delay_count].prefix = strdup(arg[0]);
+            delay[delay_count++].latency_us = (uint32_t)strtoul(arg[1], NULL, 0);
+        }
+        else if (NULL == arg[0])
+            ret = -1;
+        else if (strcmp(directive, "seed") == 0)
+            sim_peer_config.seed = (uint32_t)strtoul(arg[0], NULL, 0);
+        else if (strcmp(directive, "latency") == 0)
+            sim_peer_config.latency_us = (uint32_t)strtoul(arg[0], NULL, 0);
+        else if (strcmp(directive, "jitter") == 0)
+            sim_peer_config.jitter_us = (uint32_t)strtoul(arg[0], NULL, 0);
+        else if (strcmp(directive, "fragment") == 0)
+            sim_peer_config.fragment = (uint32_t)strtoul(arg[0], NULL, 0);
+        else if (strcmp(directive, "gap") == 0)
+            sim_peer_config.gap_us = (uint32_t)strtoul(arg[0], NULL, 0);
+        else if (strcmp(directive, "error") == 0)
+            sim_peer_config.error_rate = strtod(arg[0], NULL);
+        else if (strcmp(directive, "drop") == 0)
+            sim_peer_config.drop_rate = strtod(arg[0], NULL);
+        else
+            ret = -1;
+    }
+    fclose(file);
+    if (0 != ret)
+    {
+        fprintf(stderr, "%s:%u: invalid directive or too many entries\n", path, line_no);
+        return -1;
+    }
+
+    // The built-in replies follow, so a scenario only lists what it changes
+    for (const sim_peer_reply_t *entry = sim_peer_default_table; (NULL != entry->prefix) && (entry_count < SIM_PEER_MAX_ENTRIES); entry++)
+        sim_peer_script_table[entry_count++] = *entry;
+    sim_peer_script_table[entry_count] = (sim_peer_reply_t){ NULL, NULL, NULL, 0 };
+    for (size_t idx = 0; idx < delay_count; idx++)
+    {
+        for (size_t entry = 0; entry < entry_count; entry++)
+        {
+            if (strcmp(sim_peer_script_table[entry].prefix, delay[idx].prefix) == 0)
+                sim_peer_script_table[entry].latency_us = delay[idx].latency_us;
+        }
+        free(delay[idx].prefix);
+    }
+    sim_peer_script_loaded = true;
+    return 0;
+}
+
+void sim_peer_configure(const sim_peer_config_t *config)
+{
+    sim_peer_config = *config;
+}
+
+int sim_peer_start(int fd, const sim_peer_reply_t *table)
+{
+    pthread_t thread;
+    sim_peer.fd = fd;
+    sim_peer.table = (NULL != table) ? table : (sim_peer_script_loaded ? sim_peer_script_table : sim_peer_default_table);
+    sim_peer_random_state = (0 != sim_peer_config.seed) ? sim_peer_config.seed : 1;
+    if (pthread_create(&thread, NULL, __sim_peer_task, &sim_peer) != 0)
+        return -1;
+    pthread_detach(thread);
+    return 0;
+}
+
+uint32_t sim_peer_commands(void)
+{
+    return __atomic_load_n(&sim_peer_cmd_count, __ATOMIC_RELAXED);
+}
+
+uint32_t sim_peer_matches(const char *prefix)
+{
+    uint32_t hits = 0;
+    if (NULL == sim_peer.table)
+        return 0; // Not started, the far end is an external program
+    for (size_t idx = 0; (idx < SIM_PEER_MAX_ENTRIES) && (NULL != sim_peer.table[idx].prefix); idx++)
+    {
+        if (strcmp(sim_peer.table[idx].prefix, prefix) == 0)
+            hits += __atomic_load_n(&sim_peer_hits[idx], __ATOMIC_RELAXED);
+    }
+    return hits;
+}
+
+uint8_t sim_peer_download_byte(uint32_t offset)
+{
+    return (uint8_t)(offset * 7U + (offset >> 8));
+}
+
+uint32_t sim_peer_faults(void)
+{
+    return __atomic_load_n(&sim_peer_fault_count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,52 @@
+/*******************************************************************************
+* Title                 :   Simulated modem peer
+* Filename              :   sim_peer.h
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Answers AT command lines on the far end of a host
+*                           UART from a reply table, with the timing and
+*                           faults of a scenario script (see host/scenarios).
+*******************************************************************************/
+#ifndef SIM_PEER_H
+#define SIM_PEER_H
+
+#include <stdint.h>
+
+/******************************************************************************
+* Typedefs
+*******************************************************************************/
+typedef struct
+{
+    const char *prefix;         // Matched against the start of the command line
+    const char *reply;          // Written back verbatim, NULL: answered by a model (echo sockets, GET "/bin/<size>")
+    const char *after_data;     // Optional: the command's last argument is a byte count, that many raw bytes are
+                                // swallowed (data mode), then this is written back
+    uint32_t latency_us;        // Added to sim_peer_config_t.latency_us for this reply, e.g. a TLS handshake
+} sim_peer_reply_t;
+
+// Timing and fault model applied to every reply
+typedef struct
+{
+    uint32_t latency_us;        // Before the first byte of a reply
+    uint32_t jitter_us;         // Latency varies uniformly by up to this much either way
+    uint32_t fragment;          // Largest single write, 0 writes each reply at once
+    uint32_t gap_us;            // Between two fragments
+    double error_rate;          // Share of commands answered "ERROR" instead
+    double drop_rate;           // Share of commands not answered at all
+    uint32_t seed;              // Same seed, same delays and faults
+} sim_peer_config_t;
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+int sim_peer_load(const char *path); //Read a scenario script: timing, faults, and replies taking precedence over the built-in table. Before sim_peer_start(). Returns 0 on success, -1 on failure (reason printed).
+void sim_peer_configure(const sim_peer_config_t *config); //Replace the timing and fault model. Before sim_peer_start().
+int sim_peer_start(int fd, const sim_peer_reply_t *table); //Serve fd from a reader thread. table ends with a NULL prefix, NULL selects the loaded scenario on top of the built-in nRF9160 SLM table. Returns 0 on success, -1 on failure.
+uint32_t sim_peer_commands(void); //Number of command lines answered so far.
+uint32_t sim_peer_matches(const char *prefix); //Number of command lines matching the table entries with exactly this prefix.
+uint32_t sim_peer_faults(void); //Number of injected errors and dropped replies so far.
+uint8_t sim_peer_download_byte(uint32_t offset); //Byte at offset of the body of the simulated GET "/bin/<size>" download.
+
+#endif /* SIM_PEER_H */
@@ -0,0 +1,289 @@
+/*******************************************************************************
+* Title                 :   UART RX path benchmark
+* Filename              :   uart_ring_bench.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   GCC / Clang (Linux)
+* Target                :   Host
+* Notes                 :   Pushes recorded modem traffic through the host UART
+*                           shim and reports bytes/s and consumer cycles/byte
+*                           for the RX paths of hal_uart.c, next to the
+*                           read-into-rcv_buf-then-mailbox path they replaced.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "uart_posix.h"
+#include "hal.h"
+#include "at_parser.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define BENCH_INPUT_SIZE                    (16U * 1024U * 1024U)  /* Bytes pushed through each path */
+#define BENCH_WRITE_CHUNK                   (4096U)
+#define BENCH_RING_PORT                     (UART_NUM_2)    /* The port hal_uart.c enables, owns the SPSC ring */
+#define BENCH_LEGACY_PORT                   (UART_NUM_1)    /* Disabled in hal_uart.c, driven through the driver API directly */
+#define BENCH_LEGACY_DRV_RX_SIZE            (1024U)         /* UART2_DRV_RX_SIZE */
+#define BENCH_LEGACY_EVENT_QUEUE            (20)
+#define BENCH_BUFFER_SIZE                   (1024U)         /* AT_BUFFER_SIZE: rcv_buf and mailbox */
+#define BENCH_WAIT_MS                       (10U)
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+typedef enum
+{
+    BENCH_PATH_LEGACY = 0,          // uart_read_bytes() into rcv_buf, copied into the mailbox, scanned there
+    BENCH_PATH_RING_MAILBOX,        // Scanned in the ring, copied into the mailbox (response lines)
+    BENCH_PATH_RING_IN_PLACE,       // Scanned and handed on in the ring (stream payloads)
+} bench_path_t;
+
+typedef struct
+{
+    int fd;                         // Peer end of the port's socketpair
+    const uint8_t *input;
+    size_t size;
+} bench_feed_t;
+
+typedef struct
+{
+    const char *name;
+    const char *copies;             // Copies of each received byte, the driver RX buffer one included
+} bench_path_desc_t;
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static const bench_path_desc_t bench_path_desc[] = {
+    [BENCH_PATH_LEGACY]        = { "read+mailbox", "driver, rcv_buf, mailbox" },
+    [BENCH_PATH_RING_MAILBOX]  = { "ring+mailbox", "driver, ring, mailbox" },
+    [BENCH_PATH_RING_IN_PLACE] = { "ring in place", "driver, ring" },
+};
+
+static char bench_mailbox[BENCH_BUFFER_SIZE + 1];
+static uint16_t bench_mailbox_len = 0;
+static volatile uint32_t bench_sink = 0;        // Keeps the in-place consumer from being optimised out
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static double __bench_clock(clockid_t clock_id)
+{
+    struct timespec now;
+    clock_gettime(clock_id, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static double __bench_now(void)
+{
+    return __bench_clock(CLOCK_MONOTONIC);
+}
+
+// Cycle counter where the host has one, 0 otherwise (cycles/byte is then not printed)
+static inline uint64_t __bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Transcript repeated until BENCH_INPUT_SIZE bytes
+static uint8_t *__bench_load(const char *file, size_t *size)
+{
+    FILE *fp = fopen(file, "rb");
+    if (NULL == fp)
+        return NULL;
+    uint8_t record[64 * 1024];
+    size_t record_len = fread(record, 1, sizeof(record), fp);
+    fclose(fp);
+    if (0 == record_len)
+        return NULL;
+
+    size_t repeat = (BENCH_INPUT_SIZE + record_len - 1) / record_len;
+    uint8_t *input = malloc(repeat * record_len);
+    if (NULL == input)
+        return NULL;
+    for (size_t idx = 0; idx < repeat; idx++)
+        memcpy(&input[idx * record_len], record, record_len);
+    *size = repeat * record_len;
+    return input;
+}
+
+// Stands in for the modem: writes the whole input to the wire
+static void *__bench_feed(void *arg)
+{
+    bench_feed_t *feed = (bench_feed_t *)arg;
+    for (size_t offset = 0; offset < feed->size; )
+    {
+        size_t chunk_len = (feed->size - offset < BENCH_WRITE_CHUNK) ? feed->size - offset : BENCH_WRITE_CHUNK;
+        ssize_t ret = write(feed->fd, &feed->input[offset], chunk_len);
+        if (ret <= 0)
+            break;
+        offset += (size_t)ret;
+    }
+    return NULL;
+}
+
+// Copy into the response mailbox the way mailbox__put_data() does, a full mailbox starts over
+static void __bench_mailbox_put(const uint8_t *data, uint16_t len)
+{
+    while (len > 0)
+    {
+        if (bench_mailbox_len == BENCH_BUFFER_SIZE)
+            bench_mailbox_len = 0;
+        uint16_t put_len = (len < BENCH_BUFFER_SIZE - bench_mailbox_len) ? len : BENCH_BUFFER_SIZE - bench_mailbox_len;
+        memcpy(&bench_mailbox[bench_mailbox_len], data, put_len);
+        bench_mailbox_len += put_len;
+        bench_mailbox[bench_mailbox_len] = '\0';
+        data += put_len;
+        len -= put_len;
+    }
+}
+
+static void __bench_scan(at_parser_t *parser, const uint8_t *data, uint16_t len)
+{
+    for (uint16_t done = 0; done < len; )
+    {
+        at_match_t match;
+        done += at_parser__feed(parser, &data[done], len - done, &match);
+        if (AT_TOKEN_NONE != match.token)
+            bench_sink++;
+    }
+}
+
+// One consumer wake-up on the path, returns the number of bytes taken off the port
+static size_t __bench_consume(bench_path_t path, at_parser_t *parser, QueueHandle_t legacy_queue, uint64_t *cycles)
+{
+    if (BENCH_PATH_LEGACY == path)
+    {
+        uart_event_t event;
+        xQueueReceive(legacy_queue, &event, pdMS_TO_TICKS(BENCH_WAIT_MS));
+        uint64_t start = __bench_cycles();
+        uint8_t rcv_buf[BENCH_BUFFER_SIZE];
+        int read_len = uart_read_bytes(BENCH_LEGACY_PORT, rcv_buf, sizeof(rcv_buf), 0);
+        if (read_len > 0)
+        {
+            // The scan follows the copy, as the strstr on the mailbox did
+            if (bench_mailbox_len + (uint32_t)read_len > BENCH_BUFFER_SIZE)
+                bench_mailbox_len = 0;
+            __bench_mailbox_put(rcv_buf, (uint16_t)read_len);
+            __bench_scan(parser, (const uint8_t *)&bench_mailbox[bench_mailbox_len - read_len], (uint16_t)read_len);
+        }
+        *cycles += __bench_cycles() - start;
+        return (read_len > 0) ? (size_t)read_len : 0;
+    }
+
+    if (hal__UARTWaitRX(BENCH_RING_PORT, BENCH_WAIT_MS) <= 0)
+        return 0;
+    uint64_t start = __bench_cycles();
+    hal_uart_span_t span[2];
+    int count = hal__UARTPeek(BENCH_RING_PORT, &span[0], &span[1]);
+    for (int span_idx = 0; (count > 0) && (span_idx < 2); span_idx++)
+    {
+        if (0 == span[span_idx].len)
+            continue;
+        __bench_scan(parser, span[span_idx].data, span[span_idx].len);
+        if (BENCH_PATH_RING_MAILBOX == path)
+            __bench_mailbox_put(span[span_idx].data, span[span_idx].len);
+    }
+    if (count > 0)
+        hal__UARTConsume(BENCH_RING_PORT, (uint16_t)count);
+    *cycles += __bench_cycles() - start;
+    return (count > 0) ? (size_t)count : 0;
+}
+
+static int __bench_run(bench_path_t path, int peer_fd, QueueHandle_t legacy_queue, const uint8_t *input, size_t size)
+{
+    at_parser_t parser;
+    at_parser__init(&parser);
+    at_parser__expect(&parser, "#XHTTPCRSP:0,1");
+    bench_mailbox_len = 0;
+
+    bench_feed_t feed = { .fd = peer_fd, .input = input, .size = size };
+    pthread_t feeder;
+    double cpu_start = __bench_clock(CLOCK_PROCESS_CPUTIME_ID);
+    double start = __bench_now();
+    if (pthread_create(&feeder, NULL, __bench_feed, &feed) != 0)
+        return -1;
+
+    size_t received = 0;
+    uint64_t cycles = 0;
+    double last_rx = start;
+    while (received < size)
+    {
+        size_t taken = __bench_consume(path, &parser, legacy_queue, &cycles);
+        if (taken > 0)
+            last_rx = __bench_now();
+        else if (__bench_now() - last_rx > 2.0)
+            break; // Wire went quiet, report what arrived
+        received += taken;
+    }
+    double elapsed = __bench_now() - start;
+    pthread_join(feeder, NULL);
+    double cpu_elapsed = __bench_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+
+    printf("  %-14s %8.1f MB/s", bench_path_desc[path].name, (double)received / elapsed / 1e6);
+    if (cycles > 0)
+        printf("  %6.2f cycles/B", (double)cycles / (double)received);
+    printf("  %6.2f CPU ns/B", cpu_elapsed * 1e9 / (double)received);
+    printf("  copies: %s\n", bench_path_desc[path].copies);
+    if (received < size)
+    {
+        fprintf(stderr, "  %s: %zu of %zu B received\n", bench_path_desc[path].name, received, size);
+        return -1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+// Usage: uart_ring_bench [transcript]
+int main(int argc, char **argv)
+{
+    const char *file = (argc > 1) ? argv[1] : BENCH_TRANSCRIPT_DIR "/http_get.log";
+    size_t size = 0;
+    uint8_t *input = __bench_load(file, &size);
+    if (NULL == input)
+    {
+        fprintf(stderr, "Cannot read %s\n", file);
+        return EXIT_FAILURE;
+    }
+
+    int ring_fd = uart_posix_open_socketpair(BENCH_RING_PORT);
+    int legacy_fd = uart_posix_open_socketpair(BENCH_LEGACY_PORT);
+    QueueHandle_t legacy_queue = NULL;
+    if ((ring_fd < 0) || (legacy_fd < 0) || (__InitUART() != SUCCESS) ||
+        (uart_driver_install(BENCH_LEGACY_PORT, BENCH_LEGACY_DRV_RX_SIZE, 0, BENCH_LEGACY_EVENT_QUEUE, &legacy_queue, 0) != ESP_OK))
+    {
+        fprintf(stderr, "Cannot set up the UART ports\n");
+        free(input);
+        return EXIT_FAILURE;
+    }
+
+    // cycles/B: the consumer only, i.e. the parser task. CPU ns/B: all threads, including the HAL RX task that fills
+    // the ring and the shim reader standing in for the ISR, so it also counts the copies made outside the consumer
+    printf("%s (%zu B)\n", file, size);
+    int ret = 0;
+    ret |= __bench_run(BENCH_PATH_LEGACY, legacy_fd, legacy_queue, input, size);
+    ret |= __bench_run(BENCH_PATH_RING_MAILBOX, ring_fd, NULL, input, size);
+    ret |= __bench_run(BENCH_PATH_RING_IN_PLACE, ring_fd, NULL, input, size);
+    free(input);
+    return (0 == ret) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,225 @@
+/*******************************************************************************
+* Title                 :   Streaming AT response tokenizer
+* Filename              :   at_parser.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   ESP-IDF v5.x
+* Target                :   ESP32
+* Notes                 :   Aho-Corasick automaton over all patterns, flattened
+*                           into a DFA on byte classes. Each received byte costs
+*                           one table lookup and is looked at once, however the
+*                           response is chunked. Line-start patterns are entered
+*                           as "^pattern" where '^' is the CR/LF byte class, so
+*                           they cannot match inside payload text and the scan
+*                           loop needs no line tracking.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <string.h>
+#include "hal.h"
+#include "at_parser.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define AT_PARSER_CLASS_OTHER           (0U)    /* Bytes no pattern uses */
+#define AT_PARSER_CLASS_EOL             (1U)    /* '\r' and '\n' */
+#define AT_PARSER_NO_EXPECTED           (0xFFU)
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+// Compile the patterns into class_of[], delta[][] and out[]. Restarts matching at the root
+static int __at_parser_build(at_parser_t *parser)
+{
+    uint8_t fail[AT_PARSER_MAX_NODES];
+    uint8_t queue[AT_PARSER_MAX_NODES];
+    // After any CR/LF the automaton sits in the single "^" node (the root before the first build)
+    bool at_line_start = (parser->state == parser->delta[0][AT_PARSER_CLASS_EOL]);
+
+    memset(parser->class_of, AT_PARSER_CLASS_OTHER, sizeof(parser->class_of));
+    parser->class_of['\r'] = AT_PARSER_CLASS_EOL;
+    parser->class_of['\n'] = AT_PARSER_CLASS_EOL;
+    parser->class_count = 2;
+    parser->node_count = 1;
+    memset(parser->delta[0], 0, sizeof(parser->delta[0]));
+    parser->out[0] = 0;
+
+    // Trie of all patterns, delta[][] == 0 means no child (the root is never a child)
+    for (uint8_t id = 0; id < parser->pattern_count; id++)
+    {
+        const at_parser_pattern_t *pattern = &parser->pattern[id];
+        uint8_t node = 0;
+        bool line_start = (pattern->flags & AT_PARSER_LINE_START);
+        for (int16_t idx = line_start ? -1 : 0; idx < pattern->len; idx++)
+        {
+            uint8_t cls = AT_PARSER_CLASS_EOL;
+            if (idx >= 0)
+            {
+                uint8_t byte = (uint8_t)pattern->str[idx];
+                if (AT_PARSER_CLASS_OTHER == parser->class_of[byte])
+                {
+                    if (parser->class_count >= AT_PARSER_MAX_CLASSES)
+                        return FAILURE;
+                    parser->class_of[byte] = parser->class_count++;
+                }
+                cls = parser->class_of[byte];
+            }
+            if (0 == parser->delta[node][cls])
+            {
+                if (parser->node_count >= AT_PARSER_MAX_NODES)
+                    return FAILURE;
+                memset(parser->delta[parser->node_count], 0, sizeof(parser->delta[0]));
+                parser->out[parser->node_count] = 0;
+                parser->delta[node][cls] = parser->node_count++;
+            }
+            node = parser->delta[node][cls];
+        }
+        parser->out[node] |= (uint16_t)(1U << id);
+    }
+
+    // Breadth first: fail links, inherited outputs, and the missing transitions taken from the fail node
+    uint8_t head = 0, tail = 0;
+    for (uint8_t cls = 0; cls < parser->class_count; cls++)
+    {
+        uint8_t child = parser->delta[0][cls];
+        if (0 != child)
+        {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail)
+    {
+        uint8_t node = queue[head++];
+        parser->out[node] |= parser->out[fail[node]];
+        for (uint8_t cls = 0; cls < parser->class_count; cls++)
+        {
+            uint8_t child = parser->delta[node][cls];
+            uint8_t fallback = parser->delta[fail[node]][cls];
+            if (0 != child)
+            {
+                fail[child] = fallback;
+                queue[tail++] = child;
+            }
+            else
+                parser->delta[node][cls] = fallback;
+        }
+    }
+
+    parser->dirty = false;
+    parser->pending = 0;
+    // Partial matches are lost, the next line end resynchronizes
+    parser->state = at_line_start ? parser->delta[0][AT_PARSER_CLASS_EOL] : 0;
+    return SUCCESS;
+}
+
+// Report the lowest pattern id in parser->pending and remove it
+static void __at_parser_pop_match(at_parser_t *parser, at_match_t *match)
+{
+    uint8_t id = (uint8_t)__builtin_ctz(parser->pending);
+    parser->pending &= (uint16_t)(parser->pending - 1);
+    match->id = id;
+    match->token = (id == parser->expected_id) ? AT_TOKEN_EXPECTED : (at_token_t)parser->pattern[id].token;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+int at_parser__init(at_parser_t *parser)
+{
+    param_check(parser != NULL);
+    memset(parser, 0, sizeof(*parser));
+    parser->expected_id = AT_PARSER_NO_EXPECTED;
+    parser->dirty = true;
+    if ( (at_parser__add(parser, "OK", AT_TOKEN_OK, AT_PARSER_LINE_START) < 0) ||
+         (at_parser__add(parser, "ERROR", AT_TOKEN_ERROR, AT_PARSER_LINE_START) < 0) ||
+         (at_parser__add(parser, "+CME ERROR:", AT_TOKEN_CME_ERROR, AT_PARSER_LINE_START) < 0) ||
+         (at_parser__add(parser, "+CMS ERROR:", AT_TOKEN_CMS_ERROR, AT_PARSER_LINE_START) < 0) )
+        return FAILURE;
+    return SUCCESS;
+}
+
+int at_parser__add(at_parser_t *parser, const char *pattern, at_token_t token, uint8_t flags)
+{
+    param_check( (parser != NULL) && (pattern != NULL) );
+    param_check( parser->pattern_count == parser->fixed_count ); // Expected slot must stay last
+    param_check( parser->pattern_count < AT_PARSER_MAX_PATTERNS - 1 ); // Keep room for the expected slot
+    size_t len = strlen(pattern);
+    param_check( (len > 0) && (len <= UINT8_MAX) && (strpbrk(pattern, "\r\n") == NULL) );
+
+    uint8_t id = parser->pattern_count++;
+    parser->pattern[id] = (at_parser_pattern_t){ .str = pattern, .len = (uint8_t)len, .token = (uint8_t)token, .flags = flags };
+    parser->fixed_count = parser->pattern_count;
+    parser->dirty = true;
+    return id;
+}
+
+int at_parser__expect(at_parser_t *parser, const char *expected)
+{
+    param_check( (parser != NULL) && (expected != NULL) );
+    size_t len = strlen(expected);
+    param_check( (len > 0) && (len <= AT_PARSER_MAX_EXPECTED_LEN) && (strpbrk(expected, "\r\n") == NULL) );
+
+    // A registered pattern with the same text ("OK") keeps its line-start rule
+    for (uint8_t id = 0; id < parser->fixed_count; id++)
+    {
+        if ((parser->pattern[id].len == len) && (memcmp(parser->pattern[id].str, expected, len) == 0))
+        {
+            parser->expected_id = id;
+            return parser->dirty ? __at_parser_build(parser) : SUCCESS;
+        }
+    }
+    parser->expected_id = parser->fixed_count;
+    if ((parser->pattern_count > parser->fixed_count) && (strcmp(parser->expected_buf, expected) == 0))
+        return parser->dirty ? __at_parser_build(parser) : SUCCESS;
+
+    memcpy(parser->expected_buf, expected, len + 1);
+    parser->pattern[parser->fixed_count] = (at_parser_pattern_t){ .str = parser->expected_buf, .len = (uint8_t)len, .token = AT_TOKEN_EXPECTED };
+    parser->pattern_count = parser->fixed_count + 1;
+    if (__at_parser_build(parser) != SUCCESS)
+    {
+        // Too many distinct bytes or nodes: fall back to the fixed patterns only
+        parser->pattern_count = parser->fixed_count;
+        parser->expected_id = AT_PARSER_NO_EXPECTED;
+        __at_parser_build(parser);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+void at_parser__reset(at_parser_t *parser)
+{
+    if (parser == NULL)
+        return;
+    parser->state = parser->delta[0][AT_PARSER_CLASS_EOL]; // As if a line end was just received
+    parser->pending = 0;
+}
+
+uint16_t at_parser__feed(at_parser_t *parser, const uint8_t *data, uint16_t len, at_match_t *match)
+{
+    match->token = AT_TOKEN_NONE;
+    if (parser->dirty && (__at_parser_build(parser) != SUCCESS))
+        return len;
+    if (0 != parser->pending)
+    {
+        __at_parser_pop_match(parser, match);
+        return 0;
+    }
+
+    uint8_t state = parser->state;
+    for (uint16_t idx = 0; idx < len; idx++)
+    {
+        state = parser->delta[state][parser->class_of[data[idx]]];
+        if (0 == parser->out[state])
+            continue;
+        parser->state = state;
+        parser->pending = parser->out[state];
+        __at_parser_pop_match(parser, match);
+        return idx + 1;
+    }
+    parser->state = state;
+    return len;
+}
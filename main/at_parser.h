@@ -0,0 +1,84 @@
+#ifndef AT_PARSER_H
+#define AT_PARSER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*------------------------------------------------------------------------------*/
+/*							 Includes and dependencies						    */
+/*------------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+/*------------------------------------------------------------------------------*/
+/*					  		   Preprocessor Constants						    */
+/*------------------------------------------------------------------------------*/
+#define AT_PARSER_MAX_PATTERNS      (16U)   // Final results + URC prefixes + the expected response
+#define AT_PARSER_MAX_NODES         (128U)  // Sum of all pattern lengths (+1 per line-start pattern) + 1
+#define AT_PARSER_MAX_CLASSES       (48U)   // Distinct bytes used by the patterns + 2
+#define AT_PARSER_MAX_EXPECTED_LEN  (48U)
+
+#define AT_PARSER_LINE_START        (1U << 0)   // Pattern only matches at the start of a line
+
+/*------------------------------------------------------------------------------*/
+/*							 	    Typedefs								    */
+/*------------------------------------------------------------------------------*/
+typedef enum
+{
+    AT_TOKEN_NONE = 0,
+    AT_TOKEN_OK,
+    AT_TOKEN_ERROR,
+    AT_TOKEN_CME_ERROR,
+    AT_TOKEN_CMS_ERROR,
+    AT_TOKEN_URC,
+    AT_TOKEN_EXPECTED,              // Pattern set by at_parser__expect()
+} at_token_t;
+
+typedef struct
+{
+    at_token_t token;
+    uint8_t id;                     // Pattern id returned by at_parser__add()
+} at_match_t;
+
+typedef struct
+{
+    const char *str;
+    uint8_t len;
+    uint8_t token;
+    uint8_t flags;
+} at_parser_pattern_t;
+
+// Resumable matcher: a DFA over byte classes built from all patterns, one table lookup per byte
+typedef struct
+{
+    at_parser_pattern_t pattern[AT_PARSER_MAX_PATTERNS];
+    uint8_t pattern_count;
+    uint8_t fixed_count;            // Patterns before the expected slot
+    uint8_t expected_id;            // Pattern reported as AT_TOKEN_EXPECTED, 0xFF if none
+    char expected_buf[AT_PARSER_MAX_EXPECTED_LEN + 1];
+    bool dirty;                     // Patterns changed, rebuild before the next byte
+
+    uint8_t class_of[256];
+    uint8_t class_count;
+    uint8_t node_count;
+    uint8_t delta[AT_PARSER_MAX_NODES][AT_PARSER_MAX_CLASSES];
+    uint16_t out[AT_PARSER_MAX_NODES];  // Patterns ending at each node, including through fail links
+
+    uint8_t state;
+    uint16_t pending;               // Further matches ending on the last consumed byte
+} at_parser_t;
+
+/*-----------------------------------------------------------------------------*/
+/*							    Function prototypes					     	   */
+/*-----------------------------------------------------------------------------*/
+int at_parser__init(at_parser_t *parser); //Clear the parser and register OK, ERROR, +CME ERROR: and +CMS ERROR: as line-start final results. Returns 0 on success, -1 on failure.
+int at_parser__add(at_parser_t *parser, const char *pattern, at_token_t token, uint8_t flags); //Register a pattern (no CR/LF, must stay valid). Only before the first at_parser__expect(). Returns the pattern id on success, -1 on failure.
+int at_parser__expect(at_parser_t *parser, const char *expected); //Report expected (matched anywhere in a line) as AT_TOKEN_EXPECTED, or a registered pattern with the same text. Rebuilds only when the text changes. Returns 0 on success, -1 on failure.
+void at_parser__reset(at_parser_t *parser); //Forget partial matches, the next byte starts a line.
+uint16_t at_parser__feed(at_parser_t *parser, const uint8_t *data, uint16_t len, at_match_t *match); //Scan data up to the end of the next match. Returns the number of bytes consumed, match->token is AT_TOKEN_NONE if all of data was consumed without a match.
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AT_PARSER_H */
@@ -0,0 +1,769 @@
+/*******************************************************************************
+* Title                 :   GSM 07.10 multiplexer
+* Filename              :   cmux.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   ESP-IDF v5.x
+* Target                :   ESP32
+* Notes                 :   Basic option framing (3GPP 27.010) over one HAL UART.
+*                           A demultiplexer task is the only reader of the UART:
+*                           UIH information goes straight into the ring of its
+*                           channel and only becomes visible once the frame check
+*                           passed. Each channel has its own reader, and asks the
+*                           modem to hold off (MSC FC) before its ring fills, so a
+*                           slow data channel does not hold up the control one.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "hal.h"
+#include "cmux.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define CMUX_FLAG                       (0xF9U)
+#define CMUX_EA                         (0x01U)     /* Address, length and control message octets: last octet */
+#define CMUX_CR                         (0x02U)     /* Command from the initiator, this side */
+#define CMUX_PF                         (0x10U)     /* Poll/final bit of the control field */
+
+#define CMUX_SABM                       (0x2FU)
+#define CMUX_UA                         (0x63U)
+#define CMUX_DM                         (0x0FU)
+#define CMUX_DISC                       (0x43U)
+#define CMUX_UIH                        (0xEFU)
+#define CMUX_UI                         (0x03U)
+
+// Control channel message types, EA and C/R bits cleared
+#define CMUX_MSG_NSC                    (0x10U)
+#define CMUX_MSG_TEST                   (0x20U)
+#define CMUX_MSG_FCOFF                  (0x60U)
+#define CMUX_MSG_FCON                   (0xA0U)
+#define CMUX_MSG_CLD                    (0xC0U)
+#define CMUX_MSG_MSC                    (0xE0U)
+
+// MSC V.24 signal octet
+#define CMUX_V24_FC                     (0x02U)     /* Flow control: sender must stop */
+#define CMUX_V24_READY                  (0x04U | 0x08U | 0x80U)    /* RTC, RTR, DV */
+
+#define CMUX_FCS_GOOD                   (0xCFU)     /* FCS register after the received FCS octet */
+#define CMUX_CTRL_INFO_SIZE             (32U)       /* Control channel message kept for parsing, longer ones are dropped */
+#define CMUX_T1_MS                      (300U)      /* Wait for UA/DM or a control message response */
+#define CMUX_N2                         (3U)        /* Retransmissions of SABM and CLD */
+#define CMUX_FLOW_WAIT_MS               (10000U)    /* Modem holds a channel off this long: the write fails */
+#define CMUX_FLOW_OFF_LEVEL             (CMUX_RX_RING_SIZE / 2)    /* Ring fill that asks the modem to stop sending */
+#define CMUX_FLOW_ON_LEVEL              (CMUX_RX_RING_SIZE / 4)    /* Ring fill that lets it go on */
+#define CMUX_IDLE_MS                    (100U)      /* Demultiplexer wake-up period, cmux__stop() waits about this long */
+#define CMUX_TASK_STACK_SIZE            (3072U)
+#define CMUX_TASK_PRIORITY              (9U)        /* Below the UART RX task, above the AT reader tasks */
+
+/******************************************************************************
+* Module Preprocessor Macros
+*******************************************************************************/
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+typedef enum
+{
+    CMUX_RX_FLAG = 0,                   // Hunting for an opening flag
+    CMUX_RX_ADDR,
+    CMUX_RX_CTRL,
+    CMUX_RX_LEN,
+    CMUX_RX_LEN2,
+    CMUX_RX_INFO,
+    CMUX_RX_FCS,
+    CMUX_RX_END,                        // Closing flag, which may open the next frame
+} cmux_rx_state_t;
+
+typedef struct
+{
+    volatile bool open;
+    volatile bool peer_fc;              // Modem asked this side to stop sending on the channel
+    bool fc_sent;                       // This side asked the modem to stop (guarded by tx_lock)
+    uint8_t ring[CMUX_RX_RING_SIZE];
+    volatile uint32_t head;             // Demultiplexer task, moved past a frame once its FCS checked out
+    volatile uint32_t tail;             // Channel reader
+    uint32_t line_scan;                 // Channel reader: bytes before this hold no line end
+    SemaphoreHandle_t rx_sem;           // Given after every frame put into the ring
+    SemaphoreHandle_t tx_sem;           // Given when the modem lets the channel send again or it closed, its writer waits on it
+    cmux_stats_t stats;
+} cmux_chan_t;
+
+// Frame being received, demultiplexer task only
+typedef struct
+{
+    cmux_rx_state_t state;
+    uint8_t addr;
+    uint8_t ctrl;
+    uint8_t fcs;
+    uint16_t len;                       // Information field length
+    uint16_t got;                       // Information bytes taken so far
+    cmux_chan_t *chan;                  // Information goes into its ring, NULL: into ctrl_info or dropped
+    uint8_t ctrl_info[CMUX_CTRL_INFO_SIZE];
+} cmux_rx_t;
+
+typedef struct
+{
+    uint8_t uart_num;
+    volatile bool running;
+    volatile bool peer_fc_all;          // FCoff: the modem holds every channel off
+    cmux_chan_t chan[CMUX_MAX_DLCI];    // DLCI n in chan[n - 1], DLCI 0 carries no data
+    cmux_rx_t rx;
+    SemaphoreHandle_t tx_lock;          // One frame at a time on the UART, and fc_sent
+    uint8_t tx_buf[CMUX_FRAME_SIZE];    // Information of a frame gathered from several segments (guarded by tx_lock)
+    SemaphoreHandle_t space_sem;        // Given by a reader that freed ring space, the stalled demultiplexer waits on it
+    SemaphoreHandle_t resp_sem;         // Given when the awaited UA, DM or control response arrived
+    SemaphoreHandle_t stopped;          // Given by the demultiplexer task on its way out
+    volatile int16_t await_dlci;        // UA/DM for this DLCI answers the pending SABM, -1 if none
+    volatile uint8_t await_msg;         // Control message response awaited, 0 if none
+    volatile bool await_ok;             // UA (or the response) rather than DM
+    uint32_t fcs_errors;
+} cmux_t;
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static cmux_t cmux;                     // In .bss, cmux__start() sets await_dlci
+static uint8_t cmux_crc_table[256];     // Reflected CRC-8, polynomial x^8 + x^2 + x + 1
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+static void __cmux_crc_init(void)
+{
+    for (uint16_t idx = 0; idx < 256; idx++)
+    {
+        uint8_t crc = (uint8_t)idx;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x01U) ? (uint8_t)((crc >> 1) ^ 0xE0U) : (uint8_t)(crc >> 1);
+        cmux_crc_table[idx] = crc;
+    }
+}
+
+static inline uint8_t __cmux_fcs_step(uint8_t fcs, uint8_t byte)
+{
+    return cmux_crc_table[fcs ^ byte];
+}
+
+static cmux_chan_t *__cmux_chan(uint8_t dlci)
+{
+    if ((dlci == 0) || (dlci > CMUX_MAX_DLCI))
+        return NULL;
+    return &cmux.chan[dlci - 1];
+}
+
+// One frame out. Caller holds tx_lock
+static int __cmux_send_frame(uint8_t dlci, uint8_t ctrl, bool command, const uint8_t *info, uint16_t len)
+{
+    uint8_t head[5];
+    uint8_t tail[2];
+    uint8_t head_len = 0;
+    head[head_len++] = CMUX_FLAG;
+    head[head_len++] = (uint8_t)((dlci << 2) | (command ? CMUX_CR : 0) | CMUX_EA);
+    head[head_len++] = ctrl;
+    if (len < 128)
+        head[head_len++] = (uint8_t)((len << 1) | CMUX_EA);
+    else
+    {
+        head[head_len++] = (uint8_t)(len << 1);
+        head[head_len++] = (uint8_t)(len >> 7);
+    }
+    uint8_t fcs = 0xFF;
+    for (uint8_t idx = 1; idx < head_len; idx++)
+        fcs = __cmux_fcs_step(fcs, head[idx]);
+    tail[0] = (uint8_t)(0xFF - fcs);
+    tail[1] = CMUX_FLAG;
+    struct iovec iov[] = { { .iov_base = head, .iov_len = head_len }, { .iov_base = (void *)info, .iov_len = len },
+                           { .iov_base = tail, .iov_len = sizeof(tail) } };
+    if (hal__UARTWritev(cmux.uart_num, iov, 3) < 0)
+        return FAILURE;
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    if (chan != NULL)
+    {
+        chan->stats.tx_frames++;
+        chan->stats.tx_bytes += len;
+    }
+    return SUCCESS;
+}
+
+// Control channel message: type octet, one length octet, value. Caller holds tx_lock
+static int __cmux_send_msg(uint8_t type, bool command, const uint8_t *value, uint8_t len)
+{
+    uint8_t msg[2 + CMUX_CTRL_INFO_SIZE];
+    len = MIN(len, CMUX_CTRL_INFO_SIZE);
+    msg[0] = (uint8_t)(type | (command ? CMUX_CR : 0) | CMUX_EA);
+    msg[1] = (uint8_t)((len << 1) | CMUX_EA);
+    memcpy(&msg[2], value, len);
+    return __cmux_send_frame(0, CMUX_UIH, true, msg, (uint16_t)(2 + len));
+}
+
+// Ask the modem to stop or resume sending on chan, once per change whoever notices it
+static void __cmux_update_flow(uint8_t dlci)
+{
+    cmux_chan_t *chan = &cmux.chan[dlci - 1];
+    xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+    uint32_t fill = chan->head - chan->tail;
+    bool off = chan->fc_sent ? (fill > CMUX_FLOW_ON_LEVEL) : (fill >= CMUX_FLOW_OFF_LEVEL);
+    if (chan->open && (off != chan->fc_sent))
+    {
+        uint8_t value[2] = { (uint8_t)((dlci << 2) | CMUX_CR | CMUX_EA), (uint8_t)(CMUX_V24_READY | (off ? CMUX_V24_FC : 0) | CMUX_EA) };
+        if (__cmux_send_msg(CMUX_MSG_MSC, true, value, sizeof(value)) == SUCCESS)
+        {
+            chan->fc_sent = off;
+            chan->stats.flow_off += off;
+        }
+    }
+    xSemaphoreGive(cmux.tx_lock);
+}
+
+// Demultiplexer task: control message from the modem on DLCI 0
+static void __cmux_control(const uint8_t *info, uint16_t len)
+{
+    if ((len < 2) || !(info[1] & CMUX_EA))
+        return; // Multi-octet lengths only come with messages longer than ctrl_info
+    uint8_t type = info[0] & (uint8_t)~(CMUX_CR | CMUX_EA);
+    bool command = (info[0] & CMUX_CR) != 0;
+    uint8_t value_len = MIN(info[1] >> 1, len - 2);
+    const uint8_t *value = &info[2];
+    if (!command)
+    {
+        if (type == cmux.await_msg)
+        {
+            cmux.await_msg = 0;
+            cmux.await_ok = true;
+            xSemaphoreGive(cmux.resp_sem);
+        }
+        return; // Answers to this side's MSC need nothing
+    }
+
+    switch (type)
+    {
+    case CMUX_MSG_MSC:
+        if (value_len >= 2)
+        {
+            cmux_chan_t *chan = __cmux_chan(value[0] >> 2);
+            if (chan != NULL)
+            {
+                chan->peer_fc = (value[1] & CMUX_V24_FC) != 0;
+                if (!chan->peer_fc)
+                    xSemaphoreGive(chan->tx_sem);
+            }
+        }
+        break;
+    case CMUX_MSG_FCOFF:
+    case CMUX_MSG_FCON:
+        cmux.peer_fc_all = (type == CMUX_MSG_FCOFF);
+        for (uint8_t dlci = 1; (dlci <= CMUX_MAX_DLCI) && !cmux.peer_fc_all; dlci++)
+            xSemaphoreGive(cmux.chan[dlci - 1].tx_sem);
+        break;
+    case CMUX_MSG_CLD:
+        for (uint8_t dlci = 1; dlci <= CMUX_MAX_DLCI; dlci++)
+            cmux.chan[dlci - 1].open = false;
+        break;
+    case CMUX_MSG_TEST:
+        break;
+    default:
+        // Not supported: answered with NSC carrying the type
+        xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+        __cmux_send_msg(CMUX_MSG_NSC, false, &info[0], 1);
+        xSemaphoreGive(cmux.tx_lock);
+        return;
+    }
+    xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+    __cmux_send_msg(type, false, value, value_len); // Response echoes the command
+    xSemaphoreGive(cmux.tx_lock);
+    if (type == CMUX_MSG_CLD)
+    {
+        for (uint8_t dlci = 1; dlci <= CMUX_MAX_DLCI; dlci++)
+        {
+            xSemaphoreGive(cmux.chan[dlci - 1].rx_sem);
+            xSemaphoreGive(cmux.chan[dlci - 1].tx_sem);
+        }
+    }
+}
+
+// Demultiplexer task: a frame passed its FCS check
+static void __cmux_frame(cmux_rx_t *rx)
+{
+    uint8_t dlci = rx->addr >> 2;
+    uint8_t ctrl = rx->ctrl & (uint8_t)~CMUX_PF;
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    switch (ctrl)
+    {
+    case CMUX_UA:
+    case CMUX_DM:
+        if (dlci == cmux.await_dlci)
+        {
+            cmux.await_dlci = -1;
+            cmux.await_ok = (ctrl == CMUX_UA);
+            xSemaphoreGive(cmux.resp_sem);
+        }
+        if ((ctrl == CMUX_DM) && (chan != NULL))
+        {
+            chan->open = false;
+            xSemaphoreGive(chan->rx_sem);
+            xSemaphoreGive(chan->tx_sem);
+        }
+        break;
+    case CMUX_SABM:
+    case CMUX_DISC:
+        // The modem opens nothing on its own, it may close a channel
+        xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+        __cmux_send_frame(dlci, (ctrl == CMUX_DISC) ? (CMUX_UA | CMUX_PF) : (CMUX_DM | CMUX_PF), false, NULL, 0);
+        xSemaphoreGive(cmux.tx_lock);
+        if ((ctrl == CMUX_DISC) && (chan != NULL))
+        {
+            chan->open = false;
+            xSemaphoreGive(chan->rx_sem);
+            xSemaphoreGive(chan->tx_sem);
+        }
+        break;
+    case CMUX_UIH:
+    case CMUX_UI:
+        if (dlci == 0)
+            __cmux_control(rx->ctrl_info, MIN(rx->len, CMUX_CTRL_INFO_SIZE));
+        else if ((rx->chan != NULL) && (rx->len != 0))
+        {
+            uint32_t head = rx->chan->head + rx->len;
+            __atomic_store_n(&rx->chan->head, head, __ATOMIC_RELEASE);
+            rx->chan->stats.rx_frames++;
+            rx->chan->stats.rx_bytes += rx->len;
+            uint32_t fill = head - rx->chan->tail;
+            if (fill > rx->chan->stats.rx_ring_max)
+                rx->chan->stats.rx_ring_max = fill;
+            xSemaphoreGive(rx->chan->rx_sem);
+            if (fill >= CMUX_FLOW_OFF_LEVEL)
+                __cmux_update_flow(dlci);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Information field starts: pick where it goes
+static void __cmux_info_begin(cmux_rx_t *rx)
+{
+    uint8_t ctrl = rx->ctrl & (uint8_t)~CMUX_PF;
+    cmux_chan_t *chan = __cmux_chan(rx->addr >> 2);
+    rx->got = 0;
+    rx->chan = ( (chan != NULL) && chan->open && ((ctrl == CMUX_UIH) || (ctrl == CMUX_UI)) ) ? chan : NULL;
+    rx->state = (rx->len != 0) ? CMUX_RX_INFO : CMUX_RX_FCS;
+}
+
+/**
+ * @brief Demultiplexer task: run received bytes through the frame decoder
+ *
+ * @return uint16_t Bytes used up, less than len if a channel ring is full
+ */
+static uint16_t __cmux_decode(cmux_rx_t *rx, const uint8_t *data, uint16_t len)
+{
+    uint16_t idx = 0;
+    while (idx < len)
+    {
+        uint8_t byte = data[idx];
+        switch (rx->state)
+        {
+        case CMUX_RX_FLAG:
+            if (byte == CMUX_FLAG)
+                rx->state = CMUX_RX_ADDR;
+            idx++;
+            break;
+        case CMUX_RX_ADDR:
+            idx++;
+            if (byte == CMUX_FLAG)
+                break; // Back to back flags
+            rx->addr = byte;
+            rx->fcs = __cmux_fcs_step(0xFF, byte);
+            rx->state = (byte & CMUX_EA) ? CMUX_RX_CTRL : CMUX_RX_FLAG;
+            break;
+        case CMUX_RX_CTRL:
+            idx++;
+            rx->ctrl = byte;
+            rx->fcs = __cmux_fcs_step(rx->fcs, byte);
+            rx->state = CMUX_RX_LEN;
+            break;
+        case CMUX_RX_LEN:
+            idx++;
+            rx->len = byte >> 1;
+            rx->fcs = __cmux_fcs_step(rx->fcs, byte);
+            if (byte & CMUX_EA)
+                __cmux_info_begin(rx);
+            else
+                rx->state = CMUX_RX_LEN2;
+            break;
+        case CMUX_RX_LEN2:
+            idx++;
+            rx->len |= (uint16_t)byte << 7;
+            rx->fcs = __cmux_fcs_step(rx->fcs, byte);
+            __cmux_info_begin(rx);
+            break;
+        case CMUX_RX_INFO:
+        {
+            uint16_t take = MIN(len - idx, rx->len - rx->got);
+            if (rx->chan != NULL)
+            {
+                // Behind head until the FCS checked out, the reader cannot see it yet
+                uint32_t pos = rx->chan->head + rx->got;
+                uint32_t space = CMUX_RX_RING_SIZE - (pos - __atomic_load_n(&rx->chan->tail, __ATOMIC_ACQUIRE));
+                take = MIN(take, space);
+                if (take == 0)
+                {
+                    rx->chan->stats.stalls++;
+                    return idx;
+                }
+                uint16_t first = MIN(take, CMUX_RX_RING_SIZE - (pos & (CMUX_RX_RING_SIZE - 1)));
+                memcpy(&rx->chan->ring[pos & (CMUX_RX_RING_SIZE - 1)], &data[idx], first);
+                memcpy(rx->chan->ring, &data[idx + first], take - first);
+            }
+            else if ((rx->addr >> 2) == 0)
+            {
+                if (rx->got < CMUX_CTRL_INFO_SIZE)
+                    memcpy(&rx->ctrl_info[rx->got], &data[idx], MIN(take, CMUX_CTRL_INFO_SIZE - rx->got));
+            }
+            // The FCS of a UI frame covers its information too, that of a UIH frame only the header
+            if ((rx->ctrl & (uint8_t)~CMUX_PF) == CMUX_UI)
+            {
+                for (uint16_t fcs_idx = 0; fcs_idx < take; fcs_idx++)
+                    rx->fcs = __cmux_fcs_step(rx->fcs, data[idx + fcs_idx]);
+            }
+            rx->got += take;
+            idx += take;
+            if (rx->got == rx->len)
+                rx->state = CMUX_RX_FCS;
+            break;
+        }
+        case CMUX_RX_FCS:
+            idx++;
+            rx->fcs = __cmux_fcs_step(rx->fcs, byte);
+            rx->state = CMUX_RX_END;
+            break;
+        case CMUX_RX_END:
+            idx++;
+            if ((byte == CMUX_FLAG) && (rx->fcs == CMUX_FCS_GOOD))
+                __cmux_frame(rx);
+            else
+                cmux.fcs_errors++; // Frame dropped, its bytes never reached head
+            rx->state = (byte == CMUX_FLAG) ? CMUX_RX_ADDR : CMUX_RX_FLAG;
+            break;
+        }
+    }
+    return idx;
+}
+
+// Demultiplexer task: the only reader of the UART while the multiplexer runs
+static void __cmux_task(void *pvParameters)
+{
+    (void)pvParameters;
+    hal_uart_span_t rx_span[2];
+    while (cmux.running)
+    {
+        if (hal__UARTWaitRX(cmux.uart_num, CMUX_IDLE_MS) <= 0)
+            continue;
+        if (hal__UARTPeek(cmux.uart_num, &rx_span[0], &rx_span[1]) <= 0)
+            continue;
+        uint16_t used = 0;
+        bool stalled = false;
+        for (uint8_t span_idx = 0; (span_idx < 2) && !stalled; span_idx++)
+        {
+            if (rx_span[span_idx].len == 0)
+                continue;
+            uint16_t span_used = __cmux_decode(&cmux.rx, rx_span[span_idx].data, rx_span[span_idx].len);
+            used += span_used;
+            stalled = (span_used < rx_span[span_idx].len);
+        }
+        if (used != 0)
+            hal__UARTConsume(cmux.uart_num, used);
+        // A full ring holds up every channel: the UART ring fills and RTS stops the modem
+        if (stalled)
+            xSemaphoreTake(cmux.space_sem, pdMS_TO_TICKS(CMUX_IDLE_MS));
+    }
+    xSemaphoreGive(cmux.stopped);
+    vTaskDelete(NULL);
+}
+
+// SABM on dlci until the modem answers, up to CMUX_N2 retransmissions
+static int __cmux_establish(uint8_t dlci)
+{
+    for (uint8_t attempt = 0; attempt <= CMUX_N2; attempt++)
+    {
+        xSemaphoreTake(cmux.resp_sem, 0);
+        cmux.await_ok = false;
+        cmux.await_dlci = dlci;
+        xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+        int ret_val = __cmux_send_frame(dlci, CMUX_SABM | CMUX_PF, true, NULL, 0);
+        xSemaphoreGive(cmux.tx_lock);
+        if (ret_val != SUCCESS)
+            break;
+        if (xSemaphoreTake(cmux.resp_sem, pdMS_TO_TICKS(CMUX_T1_MS)) == pdTRUE)
+            return cmux.await_ok ? SUCCESS : FAILURE; // DM: refused, retrying will not help
+    }
+    cmux.await_dlci = -1;
+    return FAILURE;
+}
+
+// Wait for bytes on chan until timeout_ms, line: until a line end
+static int __cmux_wait(uint8_t dlci, uint32_t timeout_ms, bool line)
+{
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    param_check(chan != NULL);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t wait = pdMS_TO_TICKS(timeout_ms);
+    while (1)
+    {
+        if (!cmux.running || !chan->open)
+            return FAILURE;
+        hal_uart_span_t span1, span2;
+        int avail = line ? cmux__peek_line(dlci, &span1, &span2) : (int)(__atomic_load_n(&chan->head, __ATOMIC_ACQUIRE) - chan->tail);
+        if (avail != 0)
+            return avail;
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if ((elapsed >= wait) || (xSemaphoreTake(chan->rx_sem, wait - elapsed) != pdTRUE))
+            return 0;
+    }
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+int cmux__start(uint8_t uart_num)
+{
+    param_check(!cmux.running);
+    if (cmux.tx_lock == NULL)
+    {
+        __cmux_crc_init();
+        cmux.tx_lock = xSemaphoreCreateMutex();
+        cmux.space_sem = xSemaphoreCreateBinary();
+        cmux.resp_sem = xSemaphoreCreateBinary();
+        cmux.stopped = xSemaphoreCreateBinary();
+        for (uint8_t dlci = 1; dlci <= CMUX_MAX_DLCI; dlci++)
+        {
+            cmux.chan[dlci - 1].rx_sem = xSemaphoreCreateBinary();
+            cmux.chan[dlci - 1].tx_sem = xSemaphoreCreateBinary();
+        }
+    }
+    if ((cmux.tx_lock == NULL) || (cmux.space_sem == NULL) || (cmux.resp_sem == NULL) || (cmux.stopped == NULL))
+        return FAILURE;
+    for (uint8_t dlci = 1; dlci <= CMUX_MAX_DLCI; dlci++)
+    {
+        cmux_chan_t *chan = &cmux.chan[dlci - 1];
+        if ((chan->rx_sem == NULL) || (chan->tx_sem == NULL))
+            return FAILURE;
+        chan->open = false;
+        chan->peer_fc = false;
+        chan->fc_sent = false;
+        chan->head = chan->tail = chan->line_scan = 0;
+        memset(&chan->stats, 0, sizeof(chan->stats));
+    }
+    memset(&cmux.rx, 0, sizeof(cmux.rx));
+    cmux.uart_num = uart_num;
+    cmux.peer_fc_all = false;
+    cmux.await_dlci = -1;
+    cmux.await_msg = 0;
+    cmux.fcs_errors = 0;
+    // Frames are not lines, and nothing else may read the UART from here on
+    if ((hal__UARTLineMode(uart_num, false) != SUCCESS) || (hal__UARTFlushRX(uart_num) != SUCCESS))
+        return FAILURE;
+    cmux.running = true;
+    if (xTaskCreate(__cmux_task, "cmux", CMUX_TASK_STACK_SIZE, NULL, CMUX_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        cmux.running = false;
+        return FAILURE;
+    }
+    if (__cmux_establish(0) != SUCCESS)
+    {
+        cmux.running = false;
+        xSemaphoreTake(cmux.stopped, portMAX_DELAY);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+int cmux__open(uint8_t dlci)
+{
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    param_check((chan != NULL) && cmux.running);
+    if (chan->open)
+        return SUCCESS;
+    chan->head = chan->tail = chan->line_scan = 0;
+    chan->peer_fc = false;
+    chan->fc_sent = false;
+    xSemaphoreTake(chan->tx_sem, 0); // Left over from the last time the channel was open
+    if (__cmux_establish(dlci) != SUCCESS)
+        return FAILURE;
+    chan->open = true;
+    // Ready to receive; the modem's answer needs nothing
+    uint8_t value[2] = { (uint8_t)((dlci << 2) | CMUX_CR | CMUX_EA), (uint8_t)(CMUX_V24_READY | CMUX_EA) };
+    xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+    int ret_val = __cmux_send_msg(CMUX_MSG_MSC, true, value, sizeof(value));
+    xSemaphoreGive(cmux.tx_lock);
+    return ret_val;
+}
+
+int cmux__stop(void)
+{
+    if (!cmux.running)
+        return SUCCESS;
+    int ret_val = FAILURE;
+    for (uint8_t attempt = 0; (attempt <= CMUX_N2) && (ret_val != SUCCESS); attempt++)
+    {
+        xSemaphoreTake(cmux.resp_sem, 0);
+        cmux.await_ok = false;
+        cmux.await_msg = CMUX_MSG_CLD;
+        xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+        int sent = __cmux_send_msg(CMUX_MSG_CLD, true, NULL, 0);
+        xSemaphoreGive(cmux.tx_lock);
+        if (sent != SUCCESS)
+            break;
+        if ((xSemaphoreTake(cmux.resp_sem, pdMS_TO_TICKS(CMUX_T1_MS)) == pdTRUE) && cmux.await_ok)
+            ret_val = SUCCESS;
+    }
+    cmux.await_msg = 0;
+    cmux.running = false;
+    xSemaphoreGive(cmux.space_sem);
+    xSemaphoreTake(cmux.stopped, portMAX_DELAY);
+    for (uint8_t dlci = 1; dlci <= CMUX_MAX_DLCI; dlci++)
+    {
+        cmux.chan[dlci - 1].open = false;
+        xSemaphoreGive(cmux.chan[dlci - 1].rx_sem);
+        xSemaphoreGive(cmux.chan[dlci - 1].tx_sem);
+    }
+    return ret_val;
+}
+
+bool cmux__running(void)
+{
+    return cmux.running;
+}
+
+int cmux__writev(uint8_t dlci, const struct iovec *iov, uint8_t iovcnt)
+{
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    param_check((chan != NULL) && (iov != NULL));
+    uint8_t seg = 0;
+    size_t seg_off = 0;
+    int written = 0;
+    while (1)
+    {
+        while ((seg < iovcnt) && (seg_off == iov[seg].iov_len))
+        {
+            seg++;
+            seg_off = 0;
+        }
+        if (seg == iovcnt)
+            return written;
+        // Held off by the modem: sleep until __cmux_control() lets the channel go on
+        TickType_t start = xTaskGetTickCount();
+        TickType_t wait = pdMS_TO_TICKS(CMUX_FLOW_WAIT_MS);
+        while ((chan->peer_fc || cmux.peer_fc_all) && chan->open)
+        {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if ((elapsed >= wait) || (xSemaphoreTake(chan->tx_sem, wait - elapsed) != pdTRUE))
+                return FAILURE;
+        }
+        if (!cmux.running || !chan->open)
+            return FAILURE;
+
+        xSemaphoreTake(cmux.tx_lock, portMAX_DELAY);
+        uint16_t len = 0;
+        while ((len < CMUX_FRAME_SIZE) && (seg < iovcnt))
+        {
+            size_t part = MIN(iov[seg].iov_len - seg_off, (size_t)(CMUX_FRAME_SIZE - len));
+            memcpy(&cmux.tx_buf[len], (const uint8_t *)iov[seg].iov_base + seg_off, part);
+            len += (uint16_t)part;
+            seg_off += part;
+            if (seg_off == iov[seg].iov_len)
+            {
+                seg++;
+                seg_off = 0;
+            }
+        }
+        int ret_val = __cmux_send_frame(dlci, CMUX_UIH, true, cmux.tx_buf, len);
+        xSemaphoreGive(cmux.tx_lock);
+        if (ret_val != SUCCESS)
+            return FAILURE;
+        written += len;
+    }
+}
+
+int cmux__wait_rx(uint8_t dlci, uint32_t timeout_ms)
+{
+    return __cmux_wait(dlci, timeout_ms, false);
+}
+
+int cmux__peek(uint8_t dlci, hal_uart_span_t *span1, hal_uart_span_t *span2)
+{
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    param_check((chan != NULL) && (span1 != NULL) && (span2 != NULL));
+    uint32_t tail = chan->tail;
+    uint32_t avail = __atomic_load_n(&chan->head, __ATOMIC_ACQUIRE) - tail;
+    uint32_t offset = tail & (CMUX_RX_RING_SIZE - 1);
+    span1->data = &chan->ring[offset];
+    span1->len = (uint16_t)MIN(avail, CMUX_RX_RING_SIZE - offset);
+    span2->data = chan->ring;
+    span2->len = (uint16_t)(avail - span1->len);
+    return (int)avail;
+}
+
+int cmux__wait_line(uint8_t dlci, uint32_t timeout_ms)
+{
+    return __cmux_wait(dlci, timeout_ms, true);
+}
+
+int cmux__peek_line(uint8_t dlci, hal_uart_span_t *span1, hal_uart_span_t *span2)
+{
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    param_check((chan != NULL) && (span1 != NULL) && (span2 != NULL));
+    uint32_t tail = chan->tail;
+    uint32_t head = __atomic_load_n(&chan->head, __ATOMIC_ACQUIRE);
+    if ((int32_t)(chan->line_scan - tail) < 0)
+        chan->line_scan = tail; // Consumed past it through cmux__peek()
+    // Only the bytes not looked at yet, up to the ring wrap and then from its start
+    while (chan->line_scan != head)
+    {
+        uint32_t offset = chan->line_scan & (CMUX_RX_RING_SIZE - 1);
+        uint32_t len = MIN(head - chan->line_scan, CMUX_RX_RING_SIZE - offset);
+        const uint8_t *eol = memchr(&chan->ring[offset], '\n', len);
+        if (eol != NULL)
+        {
+            uint32_t line_len = chan->line_scan + (uint32_t)(eol - &chan->ring[offset]) + 1 - tail;
+            cmux__peek(dlci, span1, span2);
+            span1->len = (uint16_t)MIN(span1->len, line_len);
+            span2->len = (uint16_t)(line_len - span1->len);
+            return (int)line_len;
+        }
+        chan->line_scan += len;
+    }
+    if (head - tail == CMUX_RX_RING_SIZE)
+        return cmux__peek(dlci, span1, span2); // No line end in a full ring: hand it over as one line
+    span1->len = 0;
+    span2->len = 0;
+    return 0;
+}
+
+int cmux__consume(uint8_t dlci, uint16_t len)
+{
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    param_check(chan != NULL);
+    param_check(len <= __atomic_load_n(&chan->head, __ATOMIC_ACQUIRE) - chan->tail);
+    __atomic_store_n(&chan->tail, chan->tail + len, __ATOMIC_RELEASE);
+    xSemaphoreGive(cmux.space_sem);
+    if (chan->fc_sent && (chan->head - chan->tail <= CMUX_FLOW_ON_LEVEL))
+        __cmux_update_flow(dlci);
+    return SUCCESS;
+}
+
+int cmux__get_stats(uint8_t dlci, cmux_stats_t *stats)
+{
+    cmux_chan_t *chan = __cmux_chan(dlci);
+    param_check((chan != NULL) && (stats != NULL));
+    *stats = chan->stats;
+    return SUCCESS;
+}
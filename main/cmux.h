@@ -0,0 +1,57 @@
+#ifndef CMUX_H
+#define CMUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//GSM 07.10 / 3GPP 27.010 basic option multiplexer: several virtual channels (DLCIs) over one HAL UART
+/*------------------------------------------------------------------------------*/
+/*							 Includes and dependencies						    */
+/*------------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "hal.h"
+/*------------------------------------------------------------------------------*/
+/*					  		   Preprocessor Constants						    */
+/*------------------------------------------------------------------------------*/
+#define CMUX_MAX_DLCI               (2U)    // Channels 1..CMUX_MAX_DLCI, DLCI 0 is the multiplexer control channel
+#define CMUX_FRAME_SIZE             (31U)   // N1: longest information field sent, the 27.010 default "AT+CMUX=0" keeps
+#define CMUX_RX_RING_SIZE           (4096U) // Per channel, power of two
+
+/*------------------------------------------------------------------------------*/
+/*							 	    Typedefs								    */
+/*------------------------------------------------------------------------------*/
+// Per-channel counters, see cmux__get_stats()
+typedef struct
+{
+    uint32_t rx_bytes;              // Information bytes received on the channel
+    uint32_t tx_bytes;
+    uint32_t rx_frames;
+    uint32_t tx_frames;
+    uint32_t flow_off;              // Times the channel asked the modem to stop sending (MSC FC)
+    uint32_t stalls;                // Times the ring filled up anyway and held up the UART for every channel
+    uint32_t rx_ring_max;           // Most bytes waiting for the reader
+} cmux_stats_t;
+
+/*-----------------------------------------------------------------------------*/
+/*							    Function prototypes					     	   */
+/*-----------------------------------------------------------------------------*/
+int cmux__start(uint8_t uart_num); //Take over uart_num (line mode off) once the modem accepted AT+CMUX, start the demultiplexer task and open DLCI 0. Returns 0 on success, -1 on failure (nothing left running).
+int cmux__open(uint8_t dlci); //Open channel dlci (SABM/UA) and signal it ready (MSC). Returns 0 on success, -1 on failure.
+int cmux__stop(void); //Close the multiplexer (CLD), the modem goes back to plain AT commands on the UART. Waiters on every channel return. Returns 0 on success, -1 on failure (stopped anyway).
+bool cmux__running(void); //True between cmux__start() and cmux__stop().
+int cmux__writev(uint8_t dlci, const struct iovec *iov, uint8_t iovcnt); //Send iovcnt segments on dlci in frames of up to CMUX_FRAME_SIZE, interleaved with other channels only at frame boundaries. Waits while the modem holds the channel off. Returns the number of bytes written, -1 on failure.
+int cmux__wait_rx(uint8_t dlci, uint32_t timeout_ms); //Block until data is buffered on dlci. Returns number of bytes available, 0 on timeout, -1 on failure (channel closed).
+int cmux__peek(uint8_t dlci, hal_uart_span_t *span1, hal_uart_span_t *span2); //Zero-copy view of the dlci ring as up to two spans. Returns total number of bytes available, -1 on failure.
+int cmux__wait_line(uint8_t dlci, uint32_t timeout_ms); //Block until a complete line ('\n' terminated) is buffered on dlci. Returns its length, 0 on timeout, -1 on failure.
+int cmux__peek_line(uint8_t dlci, hal_uart_span_t *span1, hal_uart_span_t *span2); //Zero-copy view of the next complete line on dlci, terminator included. Returns line length, 0 if no complete line, -1 on failure.
+int cmux__consume(uint8_t dlci, uint16_t len); //Release len bytes seen through cmux__peek*(), lets the modem send again once the ring drained. Returns 0 on success, -1 on failure.
+int cmux__get_stats(uint8_t dlci, cmux_stats_t *stats); //Copy the dlci counters into stats. Returns 0 on success, -1 on failure.
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CMUX_H */
@@ -17,9 +17,42 @@ extern "C" {
 #define SUCCESS                 0
 #define FAILURE                 -1
 
+#define HAL_UART_FLOW_NONE      0
+#define HAL_UART_FLOW_RTS_CTS   1
+
 #define param_check(param)	    if ( !(param) ) return FAILURE
 #define error_check(con, error) if ( con ) return error
 
+/*------------------------------------------------------------------------------*/
+/*							 	    Typedefs								    */
+/*------------------------------------------------------------------------------*/
+// Contiguous view into a HAL-owned buffer, valid until the matching consume call
+typedef struct
+{
+    const uint8_t *data;
+    uint16_t len;
+} hal_uart_span_t;
+
+// Per-port UART counters, see hal__UARTGetStats()
+typedef struct
+{
+    uint32_t rx_bytes;              // Bytes moved into the RX ring
+    uint32_t tx_bytes;              // Bytes handed to the driver
+    uint32_t fifo_overruns;         // Hardware RX FIFO overflows (data lost)
+    uint32_t buffer_full;           // Driver RX buffer full events
+    uint32_t rx_ring_full;          // RX ring full, data held back in the driver
+    uint32_t frame_errors;
+    uint32_t parity_errors;
+    uint32_t break_events;
+    uint32_t line_queue_drops;      // Line ends not recorded because the line queue was full
+    uint32_t rx_ring_max;           // Highest RX ring occupancy in bytes
+    uint32_t rx_latency_max_us;     // Longest time from bytes landing in the RX ring to the consumer taking them
+} hal_uart_stats_t;
+
+struct iovec; // <sys/uio.h>
+
+// Completion callback of hal__UARTWriteAsync(), status is the number of bytes written or -1 on failure
+typedef void (*hal_uart_tx_cb_t)(uint8_t uartNum, int status, void *ctx);
 
 /*-----------------------------------------------------------------------------*/
 /*							    Function prototypes					     	   */
@@ -56,10 +89,23 @@ int hal__UARTAvailable(uint8_t uartNum); //Returns number of bytes available to
 
 int hal__UARTWrite_uint8(uint8_t uartNum, uint8_t data); //Write data to UART. Returns 0 on success, -1 on failure.
 int hal__UARTWrite(uint8_t uartNum, uint8_t *data, uint16_t len); //Write data to UART. Returns number of bytes written on success, -1 on failure.
+int hal__UARTWritev(uint8_t uartNum, const struct iovec *iov, uint8_t iovcnt); //Write iovcnt segments back to back with no intermediate buffer, not interleaved with other writers. Returns total number of bytes written on success, -1 on failure.
+int hal__UARTWriteAsync(uint8_t uartNum, const uint8_t *data, uint16_t len, hal_uart_tx_cb_t cb, void *ctx); //Queue a write and return immediately. data must stay valid until cb(uartNum, bytes written or -1, ctx) runs from the TX task. Returns 0 on success, -1 on failure (queue full).
 
 int hal__UARTRead_uint8(uint8_t uartNum, uint8_t *data); //Read data from UART. Returns 0 on success, -1 on failure.
 int hal__UARTRead(uint8_t uartNum, uint8_t *data, uint16_t len); //Read data from UART. Returns number of bytes read on success, -1 on failure.
 int hal__UARTFlushRX(uint8_t uartNum); //Flush RX buffer. Returns 0 on success, -1 on failure.
+int hal__UARTPeek(uint8_t uartNum, hal_uart_span_t *span1, hal_uart_span_t *span2); //Zero-copy view of the RX ring as up to two spans (span2 is the wrapped part). Returns total number of bytes available, -1 on failure.
+int hal__UARTConsume(uint8_t uartNum, uint16_t len); //Release len bytes previously seen through hal__UARTPeek. Returns 0 on success, -1 on failure.
+int hal__UARTLineMode(uint8_t uartNum, bool enable); //Enable line mode: the RX interrupt pattern-detects '\n' and queues line ends. Returns 0 on success, -1 on failure.
+int hal__UARTPeekLine(uint8_t uartNum, hal_uart_span_t *span1, hal_uart_span_t *span2); //Line mode: zero-copy view of the next complete line, terminator included. Consume it with hal__UARTConsume. Returns line length, 0 if no complete line, -1 on failure.
+int hal__UARTWaitLine(uint8_t uartNum, uint32_t timeout_ms); //Line mode: block until a complete line is queued. Returns length of the next line, 0 on timeout, -1 on failure (also once line mode is switched off).
+int hal__UARTReadLine(uint8_t uartNum, uint8_t *data, uint16_t len); //Line mode: read the next complete line (terminator included, NUL-terminated) in O(1). Returns number of bytes read, 0 if no complete line, -1 on failure.
+int hal__UARTGetStats(uint8_t uartNum, hal_uart_stats_t *stats); //Copy the port counters into stats. Returns 0 on success, -1 on failure.
+int hal__UARTResetStats(uint8_t uartNum); //Clear the port counters. Returns 0 on success, -1 on failure.
+int hal__UARTConfigure(uint8_t uartNum, uint32_t baud, uint8_t flow); //Change baud rate and flow control (HAL_UART_FLOW_NONE / HAL_UART_FLOW_RTS_CTS) at runtime. Returns 0 on success, -1 on failure.
+int hal__UARTWaitRX(uint8_t uartNum, uint32_t timeout_ms); //Block until RX data is buffered (woken by the driver RX-timeout/FIFO-full event). Returns number of bytes available, 0 on timeout, -1 on failure.
+int hal__UARTWaitFor(uint8_t uartNum, uint8_t *data, uint16_t len, const char *pattern, uint32_t timeout_ms); //Read data from UART into a NUL-terminated buffer until pattern is received. Returns number of bytes read on success, -1 on timeout/failure.
 /* I2C_HELPER_FUNCTIONS */
 bool hal__I2CEXISTS(uint8_t i2c_num, uint8_t ADDR); //Returns true if I2C device exists at ADDR, false if not.
 
@@ -11,174 +11,527 @@
 /******************************************************************************
 * Includes
 *******************************************************************************/
+#include <string.h>
+#include <sys/uio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "hal.h"
 /******************************************************************************
 * Module Preprocessor Constants
 *******************************************************************************/
 #define MODULE_NAME                         "HAL_UART"
-#define UART_BUFFER_SIZE					(512U)
+#define UART_TX_QUEUE_SIZE					(8U)	/* Pending hal__UARTWriteAsync() requests per port */
+#define UART_RX_TASK_STACK_SIZE				(2048U)
+#define UART_RX_TASK_PRIORITY				(10U)
+#define UART_TX_TASK_STACK_SIZE				(2048U)
+#define UART_TX_TASK_PRIORITY				(9U)
+#define UART_LINE_QUEUE_SIZE				(32U)	/* Pending line ends per port in line mode, power of two */
+#define UART_LINE_END_CHAR					('\n')
 
-#define UART_TX1_PIN						(GPIO_NUM_1)
-#define UART_RX1_PIN						(GPIO_NUM_3)
-#define UART_TX2_PIN						(GPIO_NUM_17)
-#define UART_RX2_PIN						(GPIO_NUM_16)
+/*
+ * Per-port configuration, see uart_port_desc[]. Buffers and tasks only exist for enabled ports.
+ * DRV_RX_SIZE: driver RX buffer, must be larger than the 128 B hardware FIFO
+ * TX_SIZE:     driver TX ring, 0 makes every write block until it is in the FIFO
+ * RX_RING:     HAL RX ring, power of two, sized for the burst the consumer can fall behind by
+ * CORE:        core of the driver ISR and RX task (0, 1 or tskNO_AFFINITY)
+ */
+#define UART0_ENABLE						(0)		/* Console, owned by the IDF logger by default */
+#define UART0_TX_PIN						(GPIO_NUM_1)
+#define UART0_RX_PIN						(GPIO_NUM_3)
+#define UART0_RTS_PIN						(UART_PIN_NO_CHANGE)
+#define UART0_CTS_PIN						(UART_PIN_NO_CHANGE)
+#define UART0_BAUDRATE						(115200U)
+#define UART0_DRV_RX_SIZE					(256U)
+#define UART0_TX_SIZE						(0U)
+#define UART0_RX_RING						(256U)
+#define UART0_EVENT_QUEUE					(8U)
+#define UART0_CORE							(0)
+
+#define UART1_ENABLE						(0)		/* Debug port */
+#define UART1_TX_PIN						(GPIO_NUM_1)
+#define UART1_RX_PIN						(GPIO_NUM_3)
+#define UART1_RTS_PIN						(UART_PIN_NO_CHANGE)
+#define UART1_CTS_PIN						(UART_PIN_NO_CHANGE)
+#define UART1_BAUDRATE						(115200U)
+#define UART1_DRV_RX_SIZE					(256U)
+#define UART1_TX_SIZE						(0U)
+#define UART1_RX_RING						(256U)
+#define UART1_EVENT_QUEUE					(8U)
+#define UART1_CORE							(tskNO_AFFINITY)
+
+#define UART2_ENABLE						(1)		/* LTE modem, bursts of several KB at high baud */
+#define UART2_TX_PIN						(GPIO_NUM_17)
+#define UART2_RX_PIN						(GPIO_NUM_16)
+#define UART2_RTS_PIN						(GPIO_NUM_18)
+#define UART2_CTS_PIN						(GPIO_NUM_19)
+#define UART2_BAUDRATE						(115200U)
+#define UART2_DRV_RX_SIZE					(1024U)
+#define UART2_TX_SIZE						(1024U)
+#define UART2_RX_RING						(4096U)
+#define UART2_EVENT_QUEUE					(32U)
+#define UART2_CORE							(1)
+
+#define UART_RTS_THRESHOLD					(100U)	/* RX FIFO level (of 128) at which RTS is de-asserted */
+#define UART_BAUD_SWITCH_TX_TIMEOUT_MS		(100U)
 
 /******************************************************************************
 * Module Preprocessor Macros
 *******************************************************************************/
+// Round up so a short remaining timeout never becomes a zero-tick busy loop
+#define UART_MS_TO_TICKS(MS)				(((MS) + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS)
+
+// Port number is valid and the port was initialized from uart_port_desc[]
+#define uart_port_check(port)				param_check( ((port) < UART_NUM_MAX) && uart_port_ctx[(port)].ready )
 
 /******************************************************************************
 * Module Typedefs
 *******************************************************************************/
+// Single-producer/single-consumer byte ring. Only the port RX task writes head
+// and only the application (consumer) writes tail, so no lock is required.
+typedef struct
+{
+	uint8_t *buf;
+	uint32_t size;						// Power of two
+	uint32_t head;						// Free-running write index (producer)
+	uint32_t tail;						// Free-running read index (consumer)
+} uart_ring_t;
+
+typedef struct
+{
+	const uint8_t *data;
+	uint16_t len;
+	hal_uart_tx_cb_t cb;
+	void *ctx;
+} uart_tx_req_t;
+
+typedef struct
+{
+	bool enable;
+	int tx_pin;
+	int rx_pin;
+	int rts_pin;
+	int cts_pin;
+	uint32_t baud_rate;
+	uint16_t drv_rx_size;
+	uint16_t tx_size;
+	uint16_t event_queue_size;
+	uint32_t rx_ring_size;
+	uint8_t *rx_ring_buf;
+	BaseType_t core;
+} uart_port_desc_t;
+
+typedef struct
+{
+	bool ready;							// Driver installed and tasks running
+	esp_err_t install_err;				// Result of uart_driver_install() run by the RX task
+	QueueHandle_t event_queue;			// Driver event queue, drained by the RX task
+	SemaphoreHandle_t rx_sem;			// Given by the RX task whenever bytes land in rx_ring
+	uart_ring_t rx_ring;
+	bool rx_stalled;					// RX task left data in the driver because rx_ring was full
+	bool line_mode;						// Pattern detection on UART_LINE_END_CHAR enabled
+	uint32_t line_end[UART_LINE_QUEUE_SIZE];	// rx_ring index of each detected line end
+	uint32_t line_head;					// Written by the RX task
+	uint32_t line_tail;					// Written by the consumer
+	uint32_t rx_stamp_us;				// When the oldest unread byte landed in rx_ring, low 32 bits so loads and stores are atomic
+	hal_uart_stats_t stats;				// Each counter has a single writer (RX task, consumer or TX path)
+	QueueHandle_t tx_queue;				// uart_tx_req_t, served in order by the TX task
+	SemaphoreHandle_t tx_mutex;			// Keeps each write (and every segment of a writev) contiguous on the wire
+} uart_port_ctx_t;
 
 /******************************************************************************
 * Module Variable Definitions
 *******************************************************************************/
+#if (UART0_ENABLE != 0)
+static uint8_t uart0_rx_ring_buf[UART0_RX_RING];
+#define UART0_RX_RING_BUF					(uart0_rx_ring_buf)
+#else
+#define UART0_RX_RING_BUF					(NULL)
+#endif /* End of (UART0_ENABLE != 0) */
+#if (UART1_ENABLE != 0)
+static uint8_t uart1_rx_ring_buf[UART1_RX_RING];
+#define UART1_RX_RING_BUF					(uart1_rx_ring_buf)
+#else
+#define UART1_RX_RING_BUF					(NULL)
+#endif /* End of (UART1_ENABLE != 0) */
+#if (UART2_ENABLE != 0)
+static uint8_t uart2_rx_ring_buf[UART2_RX_RING];
+#define UART2_RX_RING_BUF					(uart2_rx_ring_buf)
+#else
+#define UART2_RX_RING_BUF					(NULL)
+#endif /* End of (UART2_ENABLE != 0) */
+
+#define UART_PORT_DESC(n)	{ 													\
+	.enable = UART##n##_ENABLE, .tx_pin = UART##n##_TX_PIN, .rx_pin = UART##n##_RX_PIN,	\
+	.rts_pin = UART##n##_RTS_PIN, .cts_pin = UART##n##_CTS_PIN, .baud_rate = UART##n##_BAUDRATE,	\
+	.drv_rx_size = UART##n##_DRV_RX_SIZE, .tx_size = UART##n##_TX_SIZE,				\
+	.event_queue_size = UART##n##_EVENT_QUEUE, .rx_ring_size = UART##n##_RX_RING,		\
+	.rx_ring_buf = UART##n##_RX_RING_BUF, .core = UART##n##_CORE }
+
+static const uart_port_desc_t uart_port_desc[UART_NUM_MAX] = {
+	[UART_NUM_0] = UART_PORT_DESC(0),
+	[UART_NUM_1] = UART_PORT_DESC(1),
+	[UART_NUM_2] = UART_PORT_DESC(2),
+};
+
+static uart_port_ctx_t uart_port_ctx[UART_NUM_MAX] = {0};
 
 /******************************************************************************
 * Function Prototypes
 *******************************************************************************/
+static int __uart_start_rx(uart_port_t port);
+static int __uart_start_tx(uart_port_t port);
 
 /******************************************************************************
-* Function Definitions
+* Internal Function Definitions
 *******************************************************************************/
-int __initUART1()
+// Consumer side: number of bytes readable
+static inline uint32_t __uart_ring_count(uart_ring_t *ring)
 {
-    int ret = SUCCESS;
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
 
-    /* Configure parameters of an UART driver */
-    uart_config_t uart_config = {
-        .baud_rate = 115200,
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_DEFAULT,
-    };
+// Consumer side: release len bytes back to the producer
+static void __uart_ring_consume(uart_port_t port, uint32_t len)
+{
+	uart_port_ctx_t *ctx = &uart_port_ctx[port];
+	if (0 == len)
+		return;
+	uint32_t now_us = (uint32_t)esp_timer_get_time();
+	uint32_t latency_us = now_us - __atomic_load_n(&ctx->rx_stamp_us, __ATOMIC_RELAXED);
+	if (latency_us > ctx->stats.rx_latency_max_us)
+		ctx->stats.rx_latency_max_us = latency_us;
+	__atomic_store_n(&ctx->rx_ring.tail, ctx->rx_ring.tail + len, __ATOMIC_SEQ_CST);
+	// Bytes left behind were already waiting, restart from now rather than keep the stamp of the bytes just taken
+	if (__uart_ring_count(&ctx->rx_ring) > 0)
+		__atomic_store_n(&ctx->rx_stamp_us, now_us, __ATOMIC_RELAXED);
+	// Wake the RX task if it parked data in the driver waiting for space
+	if (__atomic_exchange_n(&ctx->rx_stalled, false, __ATOMIC_SEQ_CST))
+	{
+		uart_event_t retry_event = { .type = UART_DATA };
+		xQueueSend(ctx->event_queue, &retry_event, 0);
+	}
+}
 
-    /* Set the UART parameters */
-    esp_err_t err = uart_param_config(UART_NUM_1, &uart_config);
-    if (err != ESP_OK) {
-        ESP_LOGE(MODULE_NAME, "Failed to initialize UART1 parameters");
-        return FAILURE;
-    }
+// Producer side: move everything buffered by the driver into rx_ring, straight into its free spans
+// The IDF ISR has already copied the bytes into the driver buffer, so this is their second copy. Stream payloads are
+// then parsed in place, response lines take a third copy into the AT mailbox (uart_ring_bench measures both).
+static void __uart_rx_drain(uart_port_t port)
+{
+	uart_port_ctx_t *ctx = &uart_port_ctx[port];
+	uart_ring_t *ring = &ctx->rx_ring;
+	size_t buffered_size = 0;
 
-    /* Setup UART IO */
-    err = uart_set_pin(UART_NUM_1, UART_TX1_PIN, UART_RX1_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    if (err != ESP_OK) {
-        ESP_LOGE(MODULE_NAME, "Failed to set pins for UART1");
-        return FAILURE;
-    }
+	// Pattern positions are relative to the driver read pointer, which always matches ring->head,
+	// and the driver drops them once read past, so collect them before moving any data
+	if (ctx->line_mode)
+	{
+		int pattern_pos;
+		while ((pattern_pos = uart_pattern_pop_pos(port)) >= 0)
+		{
+			uint32_t line_head = ctx->line_head;
+			if ((line_head - __atomic_load_n(&ctx->line_tail, __ATOMIC_ACQUIRE)) >= UART_LINE_QUEUE_SIZE)
+			{
+				ctx->stats.line_queue_drops++; // Queue full, the line merges with the next one
+				continue;
+			}
+			ctx->line_end[line_head & (UART_LINE_QUEUE_SIZE - 1)] = ring->head + pattern_pos;
+			__atomic_store_n(&ctx->line_head, line_head + 1, __ATOMIC_RELEASE);
+		}
+	}
 
-	/* Setup UART buffered */
-    err = uart_driver_install(UART_NUM_1, UART_BUFFER_SIZE, 0, 0, NULL, 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(MODULE_NAME, "Failed to install UART1 driver");
-        return FAILURE;
-    }
+	if (uart_get_buffered_data_len(port, &buffered_size) != ESP_OK)
+		return;
+	while (buffered_size > 0)
+	{
+		uint32_t head = ring->head;
+		uint32_t free_len = ring->size - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+		if (free_len == 0)
+		{
+			__atomic_store_n(&ctx->rx_stalled, true, __ATOMIC_SEQ_CST);
+			// Re-check so a consume racing with the flag store is never missed
+			if (ring->size == (head - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST)))
+			{
+				ctx->stats.rx_ring_full++;
+				return;
+			}
+			__atomic_store_n(&ctx->rx_stalled, false, __ATOMIC_SEQ_CST);
+			continue;
+		}
+		uint32_t idx = head & (ring->size - 1);
+		uint32_t span_len = ring->size - idx;
+		if (span_len > free_len)
+			span_len = free_len;
+		if (span_len > buffered_size)
+			span_len = buffered_size;
+		int read_len = uart_read_bytes(port, &ring->buf[idx], span_len, 0);
+		if (read_len <= 0)
+			return;
+		if (free_len == ring->size)
+			__atomic_store_n(&ctx->rx_stamp_us, (uint32_t)esp_timer_get_time(), __ATOMIC_RELAXED);
+		__atomic_store_n(&ring->head, head + read_len, __ATOMIC_RELEASE);
+		buffered_size -= read_len;
+		ctx->stats.rx_bytes += read_len;
+		if (ring->size - free_len + read_len > ctx->stats.rx_ring_max)
+			ctx->stats.rx_ring_max = ring->size - free_len + read_len;
+		xSemaphoreGive(ctx->rx_sem);
+	}
+}
 
-    return ret;
+static void __uart_rx_task(void *pvParameters)
+{
+	uart_port_t port = (uart_port_t)(intptr_t)pvParameters;
+	uart_port_ctx_t *ctx = &uart_port_ctx[port];
+	const uart_port_desc_t *desc = &uart_port_desc[port];
+	hal_uart_stats_t *stats = &ctx->stats;
+	uart_event_t event;
+
+	// The driver ISR is allocated on the core that installs it, i.e. the core this task is pinned to
+	ctx->install_err = uart_driver_install(port, desc->drv_rx_size, desc->tx_size, desc->event_queue_size, &ctx->event_queue, 0);
+	xSemaphoreGive(ctx->rx_sem);
+	if (ctx->install_err != ESP_OK)
+	{
+		vTaskDelete(NULL);
+		return;
+	}
+
+	while (1)
+	{
+		if (xQueueReceive(uart_port_ctx[port].event_queue, &event, portMAX_DELAY) != pdTRUE)
+			continue;
+		// Counted rather than logged, hal__UARTGetStats() reports them
+		switch (event.type)
+		{
+			case UART_PATTERN_DET:
+				// Positions are picked up by __uart_rx_drain()
+				break;
+			case UART_FIFO_OVF:
+				stats->fifo_overruns++;
+				break;
+			case UART_BUFFER_FULL:
+				stats->buffer_full++;
+				break;
+			case UART_FRAME_ERR:
+				stats->frame_errors++;
+				break;
+			case UART_PARITY_ERR:
+				stats->parity_errors++;
+				break;
+			case UART_BREAK:
+				stats->break_events++;
+				break;
+			default:
+				break;
+		}
+		__uart_rx_drain(port);
+	}
 }
 
-int __initUART2()
+static int __uart_start_rx(uart_port_t port)
 {
-    int ret = SUCCESS;
+	uart_port_ctx_t *ctx = &uart_port_ctx[port];
+	ctx->rx_sem = xSemaphoreCreateBinary();
+	if (NULL == ctx->rx_sem)
+		return FAILURE;
+	if (xTaskCreatePinnedToCore(__uart_rx_task, "uart_rx", UART_RX_TASK_STACK_SIZE, (void *)(intptr_t)port,
+								UART_RX_TASK_PRIORITY, NULL, uart_port_desc[port].core) != pdPASS)
+		return FAILURE;
+	// Wait for the task to install the driver
+	xSemaphoreTake(ctx->rx_sem, portMAX_DELAY);
+	return (ctx->install_err == ESP_OK) ? SUCCESS : FAILURE;
+}
+
+static void __uart_tx_task(void *pvParameters)
+{
+	uart_port_t port = (uart_port_t)(intptr_t)pvParameters;
+	uart_tx_req_t req;
+	while (1)
+	{
+		if (xQueueReceive(uart_port_ctx[port].tx_queue, &req, portMAX_DELAY) != pdTRUE)
+			continue;
+		xSemaphoreTake(uart_port_ctx[port].tx_mutex, portMAX_DELAY);
+		int status = uart_write_bytes(port, (const void *)req.data, req.len);
+		if (status > 0)
+			uart_port_ctx[port].stats.tx_bytes += status;
+		xSemaphoreGive(uart_port_ctx[port].tx_mutex);
+		// Completion means the bytes have left the wire, the caller may then reuse its buffer
+		if ((status >= 0) && (uart_wait_tx_done(port, portMAX_DELAY) != ESP_OK))
+			status = FAILURE;
+		if (NULL != req.cb)
+			req.cb(port, (status < 0) ? FAILURE : status, req.ctx);
+	}
+}
+
+static int __uart_start_tx(uart_port_t port)
+{
+	uart_port_ctx_t *ctx = &uart_port_ctx[port];
+	ctx->tx_mutex = xSemaphoreCreateMutex();
+	if (NULL == ctx->tx_mutex)
+		return FAILURE;
+	ctx->tx_queue = xQueueCreate(UART_TX_QUEUE_SIZE, sizeof(uart_tx_req_t));
+	if (NULL == ctx->tx_queue)
+		return FAILURE;
+	if (xTaskCreate(__uart_tx_task, "uart_tx", UART_TX_TASK_STACK_SIZE, (void *)(intptr_t)port, UART_TX_TASK_PRIORITY, NULL) != pdPASS)
+		return FAILURE;
+	return SUCCESS;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+//Initialize one UART from its uart_port_desc[] entry. Returns 0 on success, -1 on failure.
+int __initUARTPort(uart_port_t port)
+{
+    const uart_port_desc_t *desc = &uart_port_desc[port];
+    uart_port_ctx_t *ctx = &uart_port_ctx[port];
 
     /* Configure parameters of an UART driver */
     uart_config_t uart_config = {
-        .baud_rate = 115200,
+        .baud_rate = desc->baud_rate,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
         .source_clk = UART_SCLK_DEFAULT,
-
     };
 
     /* Set the UART parameters */
-    esp_err_t err = uart_param_config(UART_NUM_2, &uart_config);
+    esp_err_t err = uart_param_config(port, &uart_config);
     if (err != ESP_OK) {
-        ESP_LOGE(MODULE_NAME, "Failed to initialize UART2 parameters");
+        ESP_LOGE(MODULE_NAME, "Failed to initialize UART%d parameters", port);
         return FAILURE;
     }
 
-    /* Setup UART IO */
-    err = uart_set_pin(UART_NUM_2, UART_TX2_PIN, UART_RX2_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    /* Setup UART IO, RTS/CTS are only routed once flow control is enabled */
+    err = uart_set_pin(port, desc->tx_pin, desc->rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
     if (err != ESP_OK) {
-        ESP_LOGE(MODULE_NAME, "Failed to set pins for UART2");
+        ESP_LOGE(MODULE_NAME, "Failed to set pins for UART%d", port);
         return FAILURE;
     }
 
-    /* Setup UART buffered */
-    err = uart_driver_install(UART_NUM_2, UART_BUFFER_SIZE, 0, 0, NULL, 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(MODULE_NAME, "Failed to install UART2 driver");
+    /* Setup the RX ring, then let the RX task install the driver on its core */
+    ctx->rx_ring.buf = desc->rx_ring_buf;
+    ctx->rx_ring.size = desc->rx_ring_size;
+    if (__uart_start_rx(port) != SUCCESS) {
+        ESP_LOGE(MODULE_NAME, "Failed to install UART%d driver", port);
         return FAILURE;
     }
 
-    return ret;
+    /* Start the TX task serving hal__UARTWriteAsync() */
+    if (__uart_start_tx(port) != SUCCESS) {
+        ESP_LOGE(MODULE_NAME, "Failed to start UART%d TX task", port);
+        return FAILURE;
+    }
+
+    ctx->ready = true;
+    return SUCCESS;
 }
 
 int __InitUART()
 {
     int ret = SUCCESS;
 
-	/*
-    if(SUCCESS != __initUART1())
-	{
-		ESP_LOGE(MODULE_NAME, "Failed to init UART1");
-		return FAILURE;
-	}
-    */
-
-	if(SUCCESS != __initUART2())
-	{
-		ESP_LOGE(MODULE_NAME, "Failed to init UART2");
-		return FAILURE;
-	}
+    for (uart_port_t port = 0; port < UART_NUM_MAX; port++)
+    {
+        if (!uart_port_desc[port].enable)
+            continue;
+        if (SUCCESS != __initUARTPort(port))
+        {
+            ESP_LOGE(MODULE_NAME, "Failed to init UART%d", port);
+            ret = FAILURE;
+        }
+    }
     return ret;
 }
 
 int hal__UARTAvailable(uint8_t uartNum)
 {
-	param_check( (1 <= uartNum) && (uartNum <= 2) );
-	int buffered_size = 0;
-	uart_get_buffered_data_len(uartNum, (size_t *)&buffered_size);
-	return buffered_size;
+	uart_port_check(uartNum);
+	return __uart_ring_count(&uart_port_ctx[uartNum].rx_ring);
 }
 
 //Write data to UART. Returns 0 on success, -1 on failure.
 int hal__UARTWrite_uint8(uint8_t uartNum, uint8_t data)
 {
-	param_check( (1 <= uartNum) && (uartNum <= 2) );
-	if (uart_write_bytes(uartNum, (const void *)&data, 1) < 0)
+	uart_port_check(uartNum);
+	if (hal__UARTWrite(uartNum, &data, 1) < 0)
 		return FAILURE;
 	else
 		return SUCCESS;
 }
 
-//Write data to UART. Returns number of bytes written on success, -1 on failure.
+//Queue data into the driver TX ring, only blocks while the ring is full. Returns number of bytes written on success, -1 on failure.
 int hal__UARTWrite(uint8_t uartNum, uint8_t *data, uint16_t len)
 {
-	param_check( (1 <= uartNum) && (uartNum <= 2) );
+	uart_port_check(uartNum);
 	param_check( NULL != data );
 	param_check( 0 < len );
-	if (uart_write_bytes(uartNum, (const void *)data, len) < 0)
+	struct iovec iov = {
+		.iov_base = data,
+		.iov_len = len,
+	};
+	if (hal__UARTWritev(uartNum, &iov, 1) < 0)
 		return FAILURE;
 	else
 		return SUCCESS;
 }
 
+//Write several buffers back to back without staging them. Returns total number of bytes written on success, -1 on failure.
+int hal__UARTWritev(uint8_t uartNum, const struct iovec *iov, uint8_t iovcnt)
+{
+	uart_port_check(uartNum);
+	param_check( NULL != iov );
+	param_check( 0 < iovcnt );
+	param_check( NULL != uart_port_ctx[uartNum].tx_mutex );
+	int total_len = 0;
+	xSemaphoreTake(uart_port_ctx[uartNum].tx_mutex, portMAX_DELAY);
+	for (uint8_t idx = 0; idx < iovcnt; idx++)
+	{
+		if (0 == iov[idx].iov_len)
+			continue;
+		if ((NULL == iov[idx].iov_base) || (uart_write_bytes(uartNum, (const void *)iov[idx].iov_base, iov[idx].iov_len) < 0))
+		{
+			total_len = FAILURE;
+			break;
+		}
+		total_len += iov[idx].iov_len;
+	}
+	if (total_len > 0)
+		uart_port_ctx[uartNum].stats.tx_bytes += total_len;
+	xSemaphoreGive(uart_port_ctx[uartNum].tx_mutex);
+	return total_len;
+}
+
+//Queue an asynchronous write, cb runs from the TX task once data has been transmitted. Returns 0 on success, -1 on failure.
+int hal__UARTWriteAsync(uint8_t uartNum, const uint8_t *data, uint16_t len, hal_uart_tx_cb_t cb, void *ctx)
+{
+	uart_port_check(uartNum);
+	param_check( NULL != data );
+	param_check( 0 < len );
+	param_check( NULL != uart_port_ctx[uartNum].tx_queue );
+	uart_tx_req_t req = {
+		.data = data,
+		.len = len,
+		.cb = cb,
+		.ctx = ctx,
+	};
+	if (xQueueSend(uart_port_ctx[uartNum].tx_queue, &req, 0) != pdTRUE)
+		return FAILURE;
+	return SUCCESS;
+}
+
 //Read data from UART. Returns 0 on success, -1 on failure.
 int hal__UARTRead_uint8(uint8_t uartNum, uint8_t *data)
 {
-	param_check( (1 <= uartNum) && (uartNum <= 2) );
+	uart_port_check(uartNum);
 	param_check( NULL != data );
-	if (uart_read_bytes(uartNum, data, 1, 0) < 0)
+	if (hal__UARTRead(uartNum, data, 1) != 1)
 		return FAILURE;
 	else
 		return SUCCESS;
@@ -187,22 +540,284 @@ int hal__UARTRead_uint8(uint8_t uartNum, uint8_t *data)
 //Read data from UART. Returns number of bytes read on success, -1 on failure.
 int hal__UARTRead(uint8_t uartNum, uint8_t *data, uint16_t len)
 {
-	param_check( (1 <= uartNum) && (uartNum <= 2) );
+	uart_port_check(uartNum);
 	param_check( NULL != data );
 	param_check( 0 < len );
-	int read_len = 0;
-	read_len = uart_read_bytes(uartNum, data, len, 0);
-	if (read_len < 0)
-		return FAILURE;
-	else
-		return read_len;
+	hal_uart_span_t span[2];
+	int read_len = hal__UARTPeek(uartNum, &span[0], &span[1]);
+	if (read_len > len)
+		read_len = len;
+	uint16_t first_len = (span[0].len < read_len) ? span[0].len : read_len;
+	memcpy(data, span[0].data, first_len);
+	memcpy(&data[first_len], span[1].data, read_len - first_len);
+	__uart_ring_consume(uartNum, read_len);
+	return read_len;
 }
+
+//Get the readable RX data in place as up to two contiguous spans. Returns total number of bytes available, -1 on failure.
+int hal__UARTPeek(uint8_t uartNum, hal_uart_span_t *span1, hal_uart_span_t *span2)
+{
+	uart_port_check(uartNum);
+	param_check( (NULL != span1) && (NULL != span2) );
+	uart_ring_t *ring = &uart_port_ctx[uartNum].rx_ring;
+	uint32_t count = __uart_ring_count(ring);
+	if (count > UINT16_MAX)
+		count = UINT16_MAX;
+	uint32_t idx = ring->tail & (ring->size - 1);
+	uint32_t first_len = ring->size - idx;
+	if (first_len > count)
+		first_len = count;
+	span1->data = &ring->buf[idx];
+	span1->len = first_len;
+	span2->data = ring->buf;
+	span2->len = count - first_len;
+	return count;
+}
+
+//Release len bytes previously returned by hal__UARTPeek. Returns 0 on success, -1 on failure.
+int hal__UARTConsume(uint8_t uartNum, uint16_t len)
+{
+	uart_port_check(uartNum);
+	param_check( len <= __uart_ring_count(&uart_port_ctx[uartNum].rx_ring) );
+	if (len > 0)
+		__uart_ring_consume(uartNum, len);
+	return SUCCESS;
+}
+
 //Flush RX buffer. Returns 0 on success, -1 on failure.
 int hal__UARTFlushRX(uint8_t uartNum)
 {
-    param_check( (1 <= uartNum) && (uartNum <= 2) );
+    uart_port_check(uartNum);
     if (uart_flush_input(uartNum) != ESP_OK)
         return FAILURE;
-    else
-        return SUCCESS;
+    uint32_t count = __uart_ring_count(&uart_port_ctx[uartNum].rx_ring);
+    if (count > 0)
+        __uart_ring_consume(uartNum, count);
+    if (uart_port_ctx[uartNum].line_mode)
+        uart_pattern_queue_reset(uartNum, UART_LINE_QUEUE_SIZE);
+    return SUCCESS;
+}
+
+//Block until RX data is buffered or timeout. Returns number of bytes available, 0 on timeout, -1 on failure.
+int hal__UARTWaitRX(uint8_t uartNum, uint32_t timeout_ms)
+{
+	uart_port_check(uartNum);
+	param_check( NULL != uart_port_ctx[uartNum].rx_sem );
+	TickType_t start_tick = xTaskGetTickCount();
+	TickType_t wait_ticks = UART_MS_TO_TICKS(timeout_ms);
+	while (1)
+	{
+		uint32_t count = __uart_ring_count(&uart_port_ctx[uartNum].rx_ring);
+		if (count > 0)
+			return count;
+
+		TickType_t elapsed = xTaskGetTickCount() - start_tick;
+		if (elapsed >= wait_ticks)
+			return 0;
+
+		// The RX task gives rx_sem after each UART_DATA event (RX timeout / FIFO full)
+		xSemaphoreTake(uart_port_ctx[uartNum].rx_sem, wait_ticks - elapsed);
+	}
+}
+
+//Read data from UART until pattern is received or timeout. Returns number of bytes read on success, -1 on failure.
+int hal__UARTWaitFor(uint8_t uartNum, uint8_t *data, uint16_t len, const char *pattern, uint32_t timeout_ms)
+{
+	uart_port_check(uartNum);
+	param_check( NULL != data );
+	param_check( NULL != pattern );
+	param_check( 1 < len );
+	uint16_t recv_idx = 0;
+	uint16_t pattern_len = strlen(pattern);
+	TickType_t start_tick = xTaskGetTickCount();
+	TickType_t wait_ticks = UART_MS_TO_TICKS(timeout_ms);
+	data[0] = '\0';
+	while (recv_idx < len - 1)
+	{
+		TickType_t elapsed = xTaskGetTickCount() - start_tick;
+		if (elapsed >= wait_ticks)
+			break;
+		int avail = hal__UARTWaitRX(uartNum, (wait_ticks - elapsed) * portTICK_PERIOD_MS);
+		if (avail < 0)
+			return FAILURE;
+		if (avail == 0)
+			break;
+		if (avail > len - 1 - recv_idx)
+			avail = len - 1 - recv_idx;
+		int read_len = hal__UARTRead(uartNum, &data[recv_idx], avail);
+		if (read_len < 0)
+			return FAILURE;
+		// Only rescan the tail that could contain a new occurrence of pattern
+		uint16_t scan_idx = (recv_idx > pattern_len) ? (recv_idx - pattern_len + 1) : 0;
+		recv_idx += read_len;
+		data[recv_idx] = '\0';
+		if (strstr((char *)&data[scan_idx], pattern) != NULL)
+			return recv_idx;
+	}
+	return FAILURE;
+}
+
+//Change baud rate and flow control at runtime. Returns 0 on success, -1 on failure.
+int hal__UARTConfigure(uint8_t uartNum, uint32_t baud, uint8_t flow)
+{
+	uart_port_check(uartNum);
+	param_check( 0 < baud );
+	param_check( (HAL_UART_FLOW_NONE == flow) || (HAL_UART_FLOW_RTS_CTS == flow) );
+
+	// Let bytes already queued go out at the old rate
+	uart_wait_tx_done(uartNum, UART_MS_TO_TICKS(UART_BAUD_SWITCH_TX_TIMEOUT_MS));
+
+	if (uart_set_baudrate(uartNum, baud) != ESP_OK)
+	{
+		ESP_LOGE(MODULE_NAME, "Failed to set UART%d baud rate %lu", uartNum, (unsigned long)baud);
+		return FAILURE;
+	}
+
+	if (HAL_UART_FLOW_RTS_CTS == flow)
+	{
+		const uart_port_desc_t *desc = &uart_port_desc[uartNum];
+		if (uart_set_pin(uartNum, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, desc->rts_pin, desc->cts_pin) != ESP_OK)
+		{
+			ESP_LOGE(MODULE_NAME, "Failed to set flow control pins for UART%d", uartNum);
+			return FAILURE;
+		}
+		if (uart_set_hw_flow_ctrl(uartNum, UART_HW_FLOWCTRL_CTS_RTS, UART_RTS_THRESHOLD) != ESP_OK)
+			return FAILURE;
+	}
+	else
+	{
+		if (uart_set_hw_flow_ctrl(uartNum, UART_HW_FLOWCTRL_DISABLE, 0) != ESP_OK)
+			return FAILURE;
+	}
+	ESP_LOGI(MODULE_NAME, "UART%d configured: %lu baud, flow control %s", uartNum, (unsigned long)baud,
+				(HAL_UART_FLOW_RTS_CTS == flow) ? "RTS/CTS" : "off");
+	return SUCCESS;
+}
+
+//Enable or disable line mode (hardware pattern detection of line ends). Returns 0 on success, -1 on failure.
+int hal__UARTLineMode(uint8_t uartNum, bool enable)
+{
+	uart_port_check(uartNum);
+	uart_port_ctx_t *ctx = &uart_port_ctx[uartNum];
+	if (enable == ctx->line_mode)
+		return SUCCESS;
+	if (enable)
+	{
+		if (uart_pattern_queue_reset(uartNum, UART_LINE_QUEUE_SIZE) != ESP_OK)
+			return FAILURE;
+		// Single '\n' with no idle-time constraints, chr_tout as in the IDF pattern example
+		if (uart_enable_pattern_det_baud_intr(uartNum, UART_LINE_END_CHAR, 1, 9, 0, 0) != ESP_OK)
+			return FAILURE;
+		ctx->line_tail = __atomic_load_n(&ctx->line_head, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&ctx->line_mode, true, __ATOMIC_RELEASE);
+	}
+	else
+	{
+		__atomic_store_n(&ctx->line_mode, false, __ATOMIC_RELEASE);
+		if (uart_disable_pattern_det_intr(uartNum) != ESP_OK)
+			return FAILURE;
+		// A task blocked in hal__UARTWaitLine() returns rather than take the wake-ups meant for byte readers
+		if (NULL != ctx->rx_sem)
+			xSemaphoreGive(ctx->rx_sem);
+	}
+	return SUCCESS;
+}
+
+//Get the next complete line (terminator included) in place as up to two spans. Returns line length, 0 if no complete line, -1 on failure.
+int hal__UARTPeekLine(uint8_t uartNum, hal_uart_span_t *span1, hal_uart_span_t *span2)
+{
+	uart_port_check(uartNum);
+	param_check( (NULL != span1) && (NULL != span2) );
+	uart_port_ctx_t *ctx = &uart_port_ctx[uartNum];
+	uart_ring_t *ring = &ctx->rx_ring;
+	span1->len = 0;
+	span2->len = 0;
+	uint32_t line_head = __atomic_load_n(&ctx->line_head, __ATOMIC_ACQUIRE);
+	while (ctx->line_tail != line_head)
+	{
+		uint32_t line_end = ctx->line_end[ctx->line_tail & (UART_LINE_QUEUE_SIZE - 1)];
+		// Skip line ends already consumed through the byte API
+		if ((int32_t)(line_end - ring->tail) < 0)
+		{
+			__atomic_store_n(&ctx->line_tail, ctx->line_tail + 1, __ATOMIC_RELEASE);
+			continue;
+		}
+		uint32_t line_len = line_end - ring->tail + 1;
+		int count = hal__UARTPeek(uartNum, span1, span2);
+		if ((count < 0) || ((uint32_t)count < line_len))
+			return 0; // Line end seen before its data reached the ring
+		if (span1->len >= line_len)
+		{
+			span1->len = line_len;
+			span2->len = 0;
+		}
+		else
+		{
+			span2->len = line_len - span1->len;
+		}
+		return line_len;
+	}
+	return 0;
+}
+
+//Line mode: block until a complete line is queued or timeout. Returns length of the next line, 0 on timeout, -1 on failure.
+int hal__UARTWaitLine(uint8_t uartNum, uint32_t timeout_ms)
+{
+	uart_port_check(uartNum);
+	param_check( uart_port_ctx[uartNum].line_mode );
+	hal_uart_span_t span[2];
+	TickType_t start_tick = xTaskGetTickCount();
+	TickType_t wait_ticks = UART_MS_TO_TICKS(timeout_ms);
+	while (1)
+	{
+		if (!__atomic_load_n(&uart_port_ctx[uartNum].line_mode, __ATOMIC_ACQUIRE))
+			return FAILURE; // Switched off meanwhile
+		int line_len = hal__UARTPeekLine(uartNum, &span[0], &span[1]);
+		if (line_len != 0)
+			return line_len;
+
+		TickType_t elapsed = xTaskGetTickCount() - start_tick;
+		if (elapsed >= wait_ticks)
+			return 0;
+
+		// Given after every drain, including the one triggered by UART_PATTERN_DET
+		xSemaphoreTake(uart_port_ctx[uartNum].rx_sem, wait_ticks - elapsed);
+	}
+}
+
+//Read the next complete line (terminator included) into a NUL-terminated buffer. Returns number of bytes read, 0 if no complete line, -1 on failure.
+int hal__UARTReadLine(uint8_t uartNum, uint8_t *data, uint16_t len)
+{
+	uart_port_check(uartNum);
+	param_check( NULL != data );
+	param_check( 1 < len );
+	hal_uart_span_t span[2];
+	int line_len = hal__UARTPeekLine(uartNum, &span[0], &span[1]);
+	if (line_len <= 0)
+		return line_len;
+	// A line longer than the buffer is returned in pieces, the rest stays queued
+	uint16_t read_len = (line_len < len) ? line_len : (len - 1);
+	uint16_t first_len = (span[0].len < read_len) ? span[0].len : read_len;
+	memcpy(data, span[0].data, first_len);
+	memcpy(&data[first_len], span[1].data, read_len - first_len);
+	data[read_len] = '\0';
+	hal__UARTConsume(uartNum, read_len);
+	return read_len;
+}
+
+//Get a snapshot of the port counters. Returns 0 on success, -1 on failure.
+int hal__UARTGetStats(uint8_t uartNum, hal_uart_stats_t *stats)
+{
+	uart_port_check(uartNum);
+	param_check( NULL != stats );
+	*stats = uart_port_ctx[uartNum].stats;
+	return SUCCESS;
+}
+
+//Clear the port counters. Returns 0 on success, -1 on failure.
+int hal__UARTResetStats(uint8_t uartNum)
+{
+	uart_port_check(uartNum);
+	memset(&uart_port_ctx[uartNum].stats, 0, sizeof(hal_uart_stats_t));
+	return SUCCESS;
 }
@@ -0,0 +1,270 @@
+/*******************************************************************************
+* Title                 :   Firmware update over the LTE modem
+* Filename              :   lte_ota.c
+* Origin Date           :   2026/10/17
+* Version               :   0.0.0
+* Compiler              :   ESP-IDF v5.x
+* Target                :   ESP32
+* Notes                 :   The body of an HTTPS GET is cut into LTE_OTA_CHUNK_SIZE
+*                           chunks on the modem reader task while the calling task
+*                           hashes and writes the previous chunk to flash. The two
+*                           chunk buffers are all the image ever occupies in RAM.
+*                           When the transfer drops, the download restarts with an
+*                           HTTP Range from the last byte handed to the writer, so
+*                           nothing is written twice and the hash runs straight on.
+*******************************************************************************/
+
+/******************************************************************************
+* Includes
+*******************************************************************************/
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "hal.h"
+#include "sim7600.h"
+#include "lte_ota.h"
+
+/******************************************************************************
+* Module Preprocessor Constants
+*******************************************************************************/
+#define MODULE_NAME                     "LTE_OTA"
+#define LTE_OTA_CHUNK_SIZE              (4096U)     /* One flash sector per esp_ota_write() */
+#define LTE_OTA_CHUNK_COUNT             (2U)        /* One fills from the modem while the other is written */
+#define LTE_OTA_WRITE_WAIT_MS           (10000U)    /* Reader task wait for a written chunk, below AT_HTTP_RESPONSE_TIMEOUT_MS */
+#define LTE_OTA_MAX_RETRIES             (5U)        /* Downloads in a row that add nothing before giving up */
+#define LTE_OTA_RETRY_DELAY_MS          (1000U)
+#define LTE_OTA_TASK_STACK_SIZE         (2048U)     /* Download task, only waits on the modem engine */
+#define LTE_OTA_TASK_PRIORITY           (5U)
+
+#define PORT_DELAY_MS(MS)               (vTaskDelay(MS / portTICK_PERIOD_MS))
+#define PORT_GET_SYSTIME_MS()           (xTaskGetTickCount() * portTICK_PERIOD_MS)
+
+/******************************************************************************
+* Module Preprocessor Macros
+*******************************************************************************/
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+/******************************************************************************
+* Module Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint8_t* data;                  // NULL ends one download attempt
+    uint16_t len;
+} lte_ota_chunk_t;
+
+// State shared by the writer (calling task), the download task and the modem reader task
+typedef struct
+{
+    char* url;
+    uint32_t offset;                // Body bytes handed to the writer, the next download starts here
+    QueueHandle_t free_queue;       // Empty chunk buffers
+    QueueHandle_t full_queue;       // Chunks to write, in body order
+    lte_ota_chunk_t fill;           // Reader task only: chunk being filled, data NULL if none
+    volatile bool write_failed;     // Writer gave up, drop the rest of the download
+    int download_status;            // sim7600__httpsGET_range() result of the last attempt
+    int http_status;
+} lte_ota_t;
+
+/******************************************************************************
+* Module Variable Definitions
+*******************************************************************************/
+static uint8_t lte_ota_buf[LTE_OTA_CHUNK_COUNT][LTE_OTA_CHUNK_SIZE];
+static lte_ota_t lte_ota = {0};     // One update at a time
+
+/******************************************************************************
+* Internal Function Definitions
+*******************************************************************************/
+// Pass the chunk being filled to the writer, or give it back if nothing went into it
+static void __lte_ota_flush(lte_ota_t* ota)
+{
+    if(ota->fill.data == NULL)
+        return;
+    if(ota->fill.len != 0)
+        xQueueSend(ota->full_queue, &ota->fill, portMAX_DELAY);
+    else
+        xQueueSend(ota->free_queue, &ota->fill.data, portMAX_DELAY);
+    ota->fill.data = NULL;
+}
+
+// Body callback, runs on the modem reader task. Waiting for a free chunk here is what paces the modem to the flash
+static int __lte_ota_on_body(const uint8_t* data, uint16_t len, void* ctx)
+{
+    lte_ota_t* ota = ctx;
+    while(len > 0)
+    {
+        if(ota->write_failed)
+            return FAILURE;
+        if(ota->fill.data == NULL)
+        {
+            if(xQueueReceive(ota->free_queue, &ota->fill.data, pdMS_TO_TICKS(LTE_OTA_WRITE_WAIT_MS)) != pdTRUE)
+            {
+                ESP_LOGE(MODULE_NAME, "Flash writes stalled");
+                ota->fill.data = NULL;
+                return FAILURE;
+            }
+            ota->fill.len = 0;
+        }
+        uint16_t copy_len = MIN(len, LTE_OTA_CHUNK_SIZE - ota->fill.len);
+        memcpy(&ota->fill.data[ota->fill.len], data, copy_len);
+        ota->fill.len += copy_len;
+        ota->offset += copy_len;
+        data += copy_len;
+        len -= copy_len;
+        if(ota->fill.len == LTE_OTA_CHUNK_SIZE)
+            __lte_ota_flush(ota);
+    }
+    return SUCCESS;
+}
+
+// One download attempt from ota->offset on. Whatever arrived before a drop is written, then the end marker is queued
+static void __lte_ota_download_task(void *pvParameters)
+{
+    lte_ota_t* ota = pvParameters;
+    ota->download_status = sim7600__httpsGET_range(ota->url, ota->offset, __lte_ota_on_body, ota, &ota->http_status);
+    __lte_ota_flush(ota);
+    lte_ota_chunk_t end = { .data = NULL, .len = 0 };
+    xQueueSend(ota->full_queue, &end, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+// Queues on first use, then both chunks back in the free queue
+static int __lte_ota_reset(lte_ota_t* ota, char* url)
+{
+    if(ota->free_queue == NULL)
+        ota->free_queue = xQueueCreate(LTE_OTA_CHUNK_COUNT, sizeof(uint8_t*));
+    if(ota->full_queue == NULL)
+        ota->full_queue = xQueueCreate(LTE_OTA_CHUNK_COUNT + 1, sizeof(lte_ota_chunk_t)); // + the end marker
+    if( (ota->free_queue == NULL) || (ota->full_queue == NULL) )
+        return FAILURE;
+    xQueueReset(ota->free_queue);
+    xQueueReset(ota->full_queue);
+    for(uint8_t idx = 0; idx < LTE_OTA_CHUNK_COUNT; idx++)
+    {
+        uint8_t* buf = lte_ota_buf[idx];
+        xQueueSend(ota->free_queue, &buf, 0);
+    }
+    ota->url = url;
+    ota->offset = 0;
+    ota->fill.data = NULL;
+    ota->fill.len = 0;
+    ota->write_failed = false;
+    return SUCCESS;
+}
+
+/******************************************************************************
+* Function Definitions
+*******************************************************************************/
+/*
+ * Downloads url into the next OTA partition in sequential esp_ota_write() calls of LTE_OTA_CHUNK_SIZE, hashing
+ * each chunk as it is written. A dropped transfer resumes from the bytes already written, up to LTE_OTA_MAX_RETRIES
+ * attempts in a row without progress. The partition becomes the boot partition only if the image SHA-256 matches
+ * sha256; the new firmware runs after the next restart, left to the caller.
+ * Returns SUCCESS if ok. Returns FAILURE if error, the partition is abandoned and the boot partition unchanged.
+ */
+int lte_ota__update(char* url, const uint8_t sha256[LTE_OTA_SHA256_LEN], lte_ota_stats_t* stats)
+{
+    param_check(url != NULL);
+    param_check(sha256 != NULL);
+    lte_ota_stats_t local_stats;
+    if(stats == NULL)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+    uint32_t start_ms = PORT_GET_SYSTIME_MS();
+
+    const esp_partition_t* partition = esp_ota_get_next_update_partition(NULL);
+    if(partition == NULL)
+    {
+        ESP_LOGE(MODULE_NAME, "No OTA partition to update");
+        return FAILURE;
+    }
+    lte_ota_t* ota = &lte_ota;
+    if(__lte_ota_reset(ota, url) != SUCCESS)
+        return FAILURE;
+    esp_ota_handle_t handle;
+    if(esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &handle) != ESP_OK)
+    {
+        ESP_LOGE(MODULE_NAME, "esp_ota_begin() failed on %s", partition->label);
+        return FAILURE;
+    }
+    mbedtls_sha256_context sha_ctx;
+    mbedtls_sha256_init(&sha_ctx);
+    mbedtls_sha256_starts(&sha_ctx, 0);
+
+    int ret_val = FAILURE;
+    uint8_t retries = 0;
+    while(1)
+    {
+        uint32_t attempt_from = ota->offset;
+        if(xTaskCreate(__lte_ota_download_task, "lte_ota_dl", LTE_OTA_TASK_STACK_SIZE, ota, LTE_OTA_TASK_PRIORITY, NULL) != pdPASS)
+            break;
+        lte_ota_chunk_t chunk;
+        while( (xQueueReceive(ota->full_queue, &chunk, portMAX_DELAY) == pdTRUE) && (chunk.data != NULL) )
+        {
+            if(!ota->write_failed)
+            {
+                uint32_t write_start_ms = PORT_GET_SYSTIME_MS();
+                mbedtls_sha256_update(&sha_ctx, chunk.data, chunk.len);
+                if(esp_ota_write(handle, chunk.data, chunk.len) != ESP_OK)
+                {
+                    ESP_LOGE(MODULE_NAME, "esp_ota_write() failed at %lu", (unsigned long)stats->image_len);
+                    ota->write_failed = true;
+                }
+                else
+                {
+                    stats->image_len += chunk.len;
+                    stats->writes++;
+                }
+                stats->write_ms += PORT_GET_SYSTIME_MS() - write_start_ms;
+            }
+            xQueueSend(ota->free_queue, &chunk.data, portMAX_DELAY);
+        }
+        if(ota->write_failed)
+            break;
+        if(ota->download_status >= 0)
+        {
+            ret_val = SUCCESS;
+            break;
+        }
+        if( (ota->http_status != 0) && ((ota->http_status < 200) || (ota->http_status > 299)) )
+        {
+            ESP_LOGE(MODULE_NAME, "HTTP status %d", ota->http_status);
+            break; // The server refused, retrying will not help
+        }
+        retries = (ota->offset != attempt_from) ? 0 : retries + 1;
+        if(retries >= LTE_OTA_MAX_RETRIES)
+        {
+            ESP_LOGE(MODULE_NAME, "Download stuck at %lu", (unsigned long)ota->offset);
+            break;
+        }
+        ESP_LOGW(MODULE_NAME, "Download dropped at %lu, resuming", (unsigned long)ota->offset);
+        stats->resumes++;
+        PORT_DELAY_MS(LTE_OTA_RETRY_DELAY_MS);
+    }
+
+    uint8_t digest[LTE_OTA_SHA256_LEN];
+    mbedtls_sha256_finish(&sha_ctx, digest);
+    mbedtls_sha256_free(&sha_ctx);
+    if( (ret_val == SUCCESS) && (memcmp(digest, sha256, LTE_OTA_SHA256_LEN) != 0) )
+    {
+        ESP_LOGE(MODULE_NAME, "SHA-256 mismatch over %lu bytes", (unsigned long)stats->image_len);
+        ret_val = FAILURE;
+    }
+    if(ret_val != SUCCESS)
+        esp_ota_abort(handle);
+    else if( (esp_ota_end(handle) != ESP_OK) || (esp_ota_set_boot_partition(partition) != ESP_OK) )
+    {
+        ESP_LOGE(MODULE_NAME, "Image rejected by the bootloader checks");
+        ret_val = FAILURE;
+    }
+    stats->total_ms = PORT_GET_SYSTIME_MS() - start_ms;
+    if(ret_val == SUCCESS)
+        ESP_LOGI(MODULE_NAME, "%lu bytes written to %s in %lu ms, %lu resumes", (unsigned long)stats->image_len,
+                 partition->label, (unsigned long)stats->total_ms, (unsigned long)stats->resumes);
+    return ret_val;
+}
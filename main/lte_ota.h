@@ -0,0 +1,39 @@
+#ifndef LTE_OTA_H
+#define LTE_OTA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Firmware update over the LTE modem: the image is streamed by sim7600__httpsGET_range() straight into the next OTA partition
+/*------------------------------------------------------------------------------*/
+/*							 Includes and dependencies						    */
+/*------------------------------------------------------------------------------*/
+#include <stdint.h>
+/*------------------------------------------------------------------------------*/
+/*					  		   Preprocessor Constants						    */
+/*------------------------------------------------------------------------------*/
+#define LTE_OTA_SHA256_LEN          (32U)
+
+/*------------------------------------------------------------------------------*/
+/*							 	    Typedefs								    */
+/*------------------------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t image_len;             // Bytes written to the partition
+    uint32_t resumes;               // Downloads restarted from the written offset after a dropped transfer
+    uint32_t writes;                // esp_ota_write() calls
+    uint32_t write_ms;              // Time spent hashing and writing flash, overlapped with the download
+    uint32_t total_ms;
+} lte_ota_stats_t;
+
+/*-----------------------------------------------------------------------------*/
+/*							    Function prototypes					     	   */
+/*-----------------------------------------------------------------------------*/
+int lte_ota__update(char* url, const uint8_t sha256[LTE_OTA_SHA256_LEN], lte_ota_stats_t* stats); //Download the image at url ("host/path") into the next OTA partition and make it the boot partition if its SHA-256 matches. Dropped transfers resume where they stopped. stats is optional. Returns 0 if ok. Returns -1 if error, the boot partition is left as it was.
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LTE_OTA_H */
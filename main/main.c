@@ -63,7 +63,7 @@ void app_main(void)
 #endif /* End of (TEST_PWM_API == 1) */
 
 #if (TEST_LTE_MODEM_API == 1)
-    xTaskCreate(&lte_modem_custom_task, "lte_modem_custom_task", 10*1024, NULL, 5, NULL);
+    xTaskCreate(&lte_modem_custom_task, "lte_modem_custom_task", 4096, NULL, 5, NULL);
 #endif /* End of (TEST_LTE_MODEM_API == 1) */
 
     while(1)
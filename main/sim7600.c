@@ -3,13 +3,21 @@
 *******************************************************************************/
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <sys/uio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "hal.h"
+#include "at_parser.h"
+#include "cmux.h"
+#include "sim7600.h"
 
 /******************************************************************************
 * Module Preprocessor Constants
@@ -17,28 +25,88 @@
 #define AT_DEFAULT_UART_PORT            (2)
 #define AT_DEFAULT_TIMEOUT_MS           (10000UL)
 #define AT_BUFFER_SIZE                  (1024UL)
-#define AT_FLUSH_RX_BEFORE_WRITE        (1) /* If set to 1, clear data in RX buffer before send AT cmd*/
+#define AT_MAILBOX_GROW_BLOCKS          (4U)        /* Adjacent pool blocks the full mailbox moves into until drained, 0 to disable */
+#define AT_MAILBOX_GROW_SIZE            (AT_MAILBOX_GROW_BLOCKS * AT_POOL_BLOCK_SIZE)
+#define AT_FLUSH_RX_BEFORE_WRITE        (1) /* If set to 1, drop what is left of the previous response before send AT cmd*/
+#define AT_DEFAULT_BAUDRATE             (115200UL)  /* Modem power-on rate */
+#define AT_MAX_BAUDRATE                 (921600UL)
+#define AT_BAUD_PROBE_TIMEOUT_MS        (300U)
+#define AT_BAUD_PROBE_RETRY             (3U)
+#define AT_HTTP_CONNECT_TIMEOUT_MS      (30000U)    /* #XHTTPCCON: DNS, TCP and TLS handshake */
+#define AT_HTTP_REQUEST_TIMEOUT_MS      (10000U)    /* #XHTTPCREQ after the request (or its payload) is sent */
+#define AT_HTTP_RESPONSE_TIMEOUT_MS     (30000U)    /* Between two pieces of the response, a download may take longer as long as data flows */
+#define AT_HTTP_IDLE_TIMEOUT_MS         (30000U)    /* Unused session older than this is reconnected, servers drop idle keep-alive connections */
+#define AT_HTTP_HOST_MAX_LEN            (64U)       /* Longer host names still work, the session is just not reused */
+#define AT_HTTP_BODY_BLOCK_SIZE         (512U)      /* Request body pulled from sim7600_http_body_t.read per UART write */
+#define AT_HTTP_HEADER_LINE_SIZE        (64U)       /* Response header line kept for parsing, longer ones are cut (only their start matters) */
+#define AT_LINK_LOST_THRESHOLD          (3U)        /* Consecutive silent timeouts before falling back to AT_DEFAULT_BAUDRATE */
+#define AT_READER_TASK_STACK_SIZE       (3072U)
+#define AT_READER_TASK_PRIORITY         (8U)        /* Below the UART RX/TX tasks, above the application */
+#define AT_READER_IDLE_MS               (1000U)     /* Reader wake-up period while the modem is quiet */
+#define AT_URC_MAX_HANDLERS             (8U)
+#define AT_URC_LINE_SIZE                (256U)      /* Longer URC lines are truncated before reaching the handler */
+#define AT_ENGINE_TASK_STACK_SIZE       (4096U)     /* Runs the HTTPS exchanges, see sim7600__dump_stack_usage() */
+#define AT_ENGINE_TASK_PRIORITY         (7U)        /* Below the reader task */
+#define AT_CTRL_TASK_STACK_SIZE         (3072U)     /* Control engine, single commands only */
+#define AT_CTRL_TASK_PRIORITY           (AT_ENGINE_TASK_PRIORITY)
+#define AT_CMD_POOL_SIZE                (8U)        /* Commands queued or running at once, all priorities together */
+#define AT_STATE_TTL_CFUN_MS            (60000U)    /* Default freshness of the cached modem state, see sim7600__set_state_ttl() */
+#define AT_STATE_TTL_REG_MS             (5000U)     /* +CEREG notifications drop it early */
+#define AT_STATE_TTL_RSSI_MS            (2000U)     /* %CESQ notifications refresh it */
+#define AT_STATE_TTL_SIM_MS             (30000U)
+#define AT_POOL_BLOCK_SIZE              (AT_BUFFER_SIZE)    /* Response and request body buffers lent by __sim7600__pool_get() */
+#define AT_POOL_BLOCKS                  (8U)        /* Engine job (response + body block), two tasks in a status query and a grown mailbox */
+#define AT_POOL_WAIT_MS                 (AT_DEFAULT_TIMEOUT_MS) /* Pool empty this long: the function fails */
+#define AT_STACK_MAX_APIS               (16U)
+#define AT_STACK_FILL_BYTE              (0xA5U)     /* FreeRTOS stack fill byte: repainting resets uxTaskGetStackHighWaterMark() every command */
+#define AT_STACK_PAINT_MARGIN           (256U)      /* Left unpainted below the engine loop frame, the smallest use reported */
+#define AT_TRACE_MAX_VERBS              (24U)       /* Command verbs with their own counters, any further verb is counted in the last one */
+#define AT_SOCK_CONNECT_TIMEOUT_MS      (30000U)    /* #XCONNECT: DNS, TCP and TLS/DTLS handshake */
+#define AT_SOCK_SEND_TIMEOUT_MS         (10000U)    /* #XDATAMODE after the payload is written */
+#define AT_SOCK_RECV_MAX_S              (50U)       /* Longest sim7600__sock_recv() wait, the response wait is 16-bit ms */
+#define AT_SOCK_QUIT_STR                "+++"       /* SLM data mode terminator, must end a UART chunk on its own */
+#define AT_SOCK_MSG_DONTWAIT            (64U)       /* #XRECV flag: return what is buffered, ERROR if nothing */
+#define AT_SOCK_POLLIN                  (0x01)      /* #XAPOLL revents */
+#define AT_SOCK_POLLHUP_ERR             (0x08 | 0x10 | 0x20)    /* POLLERR, POLLHUP, POLLNVAL */
+#define AT_CMUX_CMD                     "AT+CMUX=0\r\n"   /* Basic option, UIH frames, N1 left at CMUX_FRAME_SIZE */
+#define AT_CMUX_DLCI_DATA               (1U)        /* Everything but the status queries: transfers, sockets, URCs */
+#define AT_CMUX_DLCI_CONTROL            (2U)        /* SIM7600_PRIO_HIGH commands */
+
+#define AT_LINK_DOWN                    (0U)
+#define AT_LINK_STARTING                (1U)
+#define AT_LINK_READY                   (2U)
+
+#define AT_CHAN_DATA                    (0U)        /* The UART itself, or AT_CMUX_DLCI_DATA */
+#define AT_CHAN_CONTROL                 (1U)        /* AT_CMUX_DLCI_CONTROL, only while the multiplexer runs */
+#define AT_CHAN_COUNT                   (2U)
 /******************************************************************************
 * Module configurations
 *******************************************************************************/
-#define TEST_USED_SAMPLE_HTTP_RESP      (0) /* Set to 1 overwrite response data with HTTP_RESP_EXAMPLE[] */
 #define TEST_AT_DEBUG_PRINTF            (1) /* Set to 1 to print log msg using printf()*/     
 #define TEST_DUMP_DATA_RECV             (1) /* Set to 1 to print data received in mailbox */
+#define AT_USE_HW_FLOWCTRL              (1) /* Set to 1 to enable RTS/CTS on both sides when negotiating the baud rate */
+#ifndef AT_STACK_PROFILE
+#define AT_STACK_PROFILE                (0) /* Set to 1 for the per-function engine stack report of sim7600__dump_stack_usage(), costs a stack paint and scan per command */
+#endif /* End of AT_STACK_PROFILE */
 
 
 #define PORT_DELAY_MS(MS)               (vTaskDelay(MS / portTICK_PERIOD_MS))
 #define PORT_GET_SYSTIME_MS()           (xTaskGetTickCount() * portTICK_PERIOD_MS)
+#define PORT_GET_TIME_US()              (esp_timer_get_time())
 
 /******************************************************************************
 * Module Preprocessor Macros
 *******************************************************************************/
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define IOV_STR(str)                    { .iov_base = (void*)(str), .iov_len = strlen(str) }
+#define IOV_COUNT(iov)                  (sizeof(iov) / sizeof((iov)[0]))
 
 
 #if (TEST_AT_DEBUG_PRINTF == 1)
 #define SIM7600_PRINTF(args...)                 printf(args)
 #else  /* !(TEST_AT_DEBUG_PRINTF == 1) */
-#define SIM7600_PRINTF(args...)                 (void)
+#define SIM7600_PRINTF(args...)                 ((void)0)
 #endif /* End of (TEST_AT_DEBUG_PRINTF == 1) */
 
 // Specifically for ESP_IDF
@@ -50,45 +118,351 @@
 #define SIM7600_INFO_PRINT_HEX(data, len) ESP_LOG_BUFFER_HEXDUMP(TAG, data, len, ESP_LOG_INFO)
 #else /* !(CONFIG_IDF_TARGET_ESP32) */
 
-#define SIM7600_INFO_PRINTF(args...)    (void)
-#define SIM7600_INFO_PRINT_HEX(data, len) (void)
+#define SIM7600_INFO_PRINTF(args...)    ((void)0)
+#define SIM7600_INFO_PRINT_HEX(data, len) ((void)0)
 #endif /* End of (CONFIG_IDF_TARGET_ESP32) */
 
 
-#if (TEST_USED_SAMPLE_HTTP_RESP == 1)
-const char HTTP_RESP_EXAMPLE[] =  
-									"#XHTTPCRSP:341,0\r\n"
-									// header
-									"HTTP/1.1 200 OK\r\n"
-									"Date: Thu, 11 Mar 2021 04:36:19 GMT\r\n"
-									"Content-Type: application/json; charset=utf-8\r\n"
-									"Content-Length: 244\r\n"
-									"Connection: keep-alive\r\n"
-									"ETag: W/\"f4-ZKlqfH53aEj3f4zb0kDtYvHD+XU\"\r\n"
-									"Vary: Accept-Encoding\r\n"
-									"set-cookie: sails.sid=s%3AHGcBwpqlDDUZhU16VzuQkfTMhWhA4W1T.%2Bgm1%2BezKGo2JnWxaB5yYDo%2FNh0NbnJzJjEnkMcrfdEI; Path=/; HttpOnly\r\n"
-									// body
-									"#XHTTPCRSP:243,0\r\n"
-									"{\"args\":{\"foo1\":\"bar1\",\"foo2\":\"bar2\"},\"headers\":{\"x-forwarded-proto\":\"http\",\"x-forwarded-port\":\"80\",\"host\":\"postman-echo.com\",\"x-amzn-trace-id\":\"Root=1-60499e43-67a96f1e18fec45b1db78c25\"},\"url\":\"http://postman-echo.com/get?foo1=bar1&foo2=bar2\"}\r\n"
-									"#XHTTPCRSP:1,0\r\n"
-									"}\r\n"
-									"#XHTTPCRSP:0,1\r\n";
-#endif /* End of (TEST_USED_SAMPLE_HTTP_RESP == 1) */
 
 
 /******************************************************************************
 * Module Typedefs
 *******************************************************************************/
+// Byte ring: put, get and drop cost the bytes moved, never the bytes left behind
 typedef struct 
 {
-    char rx_data[AT_BUFFER_SIZE];
+    char base[AT_BUFFER_SIZE];
+    char* rx_data;                      // base, or AT_MAILBOX_GROW_BLOCKS pool blocks while a long response is pending
+    uint16_t size;
+    uint16_t head;                      // Offset of the oldest byte in rx_data
     uint16_t rx_len;
+    uint32_t overflow;                  // Bytes discarded because the mailbox was full
 } at_resp_data_mailbox_t;
 
+typedef struct
+{
+    const char* prefix;                 // Must stay valid, not copied
+    uint16_t len;
+    sim7600_urc_cb_t cb;
+    void* ctx;
+} at_urc_handler_t;
+
+typedef int (*at_job_fn_t)(void* arg);
+
+struct sim7600_cmd
+{
+    char command[SIM7600_CMD_MAX_LEN + 1];
+    char expected[AT_PARSER_MAX_EXPECTED_LEN + 1];
+    uint16_t timeout_ms;
+    char* resp;
+    uint16_t resp_size;
+    sim7600_cmd_cb_t cb;
+    void* ctx;
+    at_job_fn_t job;                    // Set: run job(job_arg) instead of command, for exchanges of several commands
+    void* job_arg;
+    const char* api;                    // Public function that queued the job, for the stack profile
+    SemaphoreHandle_t done;             // Given on completion when there is no callback
+    int status;
+    int resp_len;
+    bool detached;                      // Posted, nobody waits for it: the engine frees it on completion
+    bool in_use;
+};
+
+typedef struct
+{
+    char* url;
+    char* JSONdata;
+    char* agent;
+    char* http_response;
+    uint16_t maxlength;
+} at_https_args_t;
+
+typedef struct
+{
+    uint32_t max_baudrate;
+    bool hw_flowctrl;
+} at_baudrate_args_t;
+
+typedef struct
+{
+    char* url;
+    char* agent;                        // POST only
+    const sim7600_http_body_t* body;    // POST only
+    uint32_t range_from;                // GET only: body offset to start from, 0 for the whole body
+    sim7600_http_chunk_cb_t on_chunk;
+    void* ctx;
+} at_stream_args_t;
+
+typedef struct
+{
+    long value;
+    uint32_t stamp_ms;
+    bool valid;
+} at_state_entry_t;
+
+// The SLM keeps one HTTPS connection open between requests, engine task only
+typedef struct
+{
+    char host[AT_HTTP_HOST_MAX_LEN + 1];
+    volatile bool connected;            // Cleared by sim7600__power_off() from any task
+    bool reused;                        // Last __sim7600__https_connect() skipped the handshake
+    uint32_t last_use_ms;
+} at_https_session_t;
+
+// Command being traced, from __sim7600__trace_begin() to __sim7600__trace_end()
+typedef struct
+{
+    char verb[SIM7600_TRACE_VERB_LEN + 1];
+    bool active;
+    uint8_t outcome;                    // sim7600_trace_outcome_t of the last response wait
+    int64_t start_us;
+    int64_t first_us;                   // Reader task, 0 until the first response byte
+    int64_t final_us;                   // 0 until a response wait ended
+    uint32_t bytes_out;
+    uint32_t bytes_in;                  // Reader task
+} at_trace_txn_t;
+
+// Command channel to the modem: the UART itself, or one DLCI while the multiplexer runs. Each has its own reader
+// task and engine, its fields are guarded by at_rx_lock unless noted
+typedef struct
+{
+    uint8_t dlci;                       // Multiplexer channel, used while at_cmux_active
+    at_resp_data_mailbox_t rx_data;     // Lines that are not URCs, until the engine takes the response
+    at_parser_t parser;                 // Response tokenizer, every received byte is scanned once
+    uint16_t scan_idx;                  // Mailbox bytes already fed to parser
+    bool waiting;                       // The engine is blocked on resp_queue
+    QueueHandle_t resp_queue;           // Final result token of the pending wait, posted by the reader
+    SemaphoreHandle_t link_sem;         // Wakes the reader idling without a link once the multiplexer opened or closed
+    uint32_t stream_remaining;          // Reader task only: payload bytes still due for the current #XHTTPCRSP or #XRECV
+    at_trace_txn_t trace_txn;           // Command being traced, owned by the engine, reader-side fields under at_rx_lock
+    char urc_line[AT_URC_LINE_SIZE];    // Reader task only
+} at_chan_t;
+
+// sim7600__httpsGET()/POST() on top of the stream: payload into a fixed buffer
+typedef struct
+{
+    char* buf;
+    uint16_t size;
+    uint16_t len;
+    uint32_t dropped;
+} at_http_collect_t;
+
+// sim7600__httpsGET_body()/GET_range() on top of the stream: header lines parsed as they pass, body bytes passed on as they are
+typedef struct
+{
+    uint8_t* buf;                       // Body stored here, or handed to on_body
+    uint32_t size;
+    sim7600_http_chunk_cb_t on_body;
+    void* ctx;
+    uint32_t range_from;                // Requested body offset
+    uint32_t skip;                      // Body bytes still to drop: a 200 answer to a range request starts at 0
+    uint32_t received;                  // Body bytes after the header, skipped ones included
+    uint32_t len;                       // Body bytes stored or delivered
+    uint32_t dropped;                   // Body bytes beyond size
+    long content_len;                   // -1 without a Content-Length header
+    int status;                         // From the status line, 0 until parsed
+    bool in_body;                       // Empty line seen
+    uint16_t lines;
+    uint16_t line_len;
+    char line[AT_HTTP_HEADER_LINE_SIZE];
+} at_http_body_collect_t;
+
+// Socket opened by sim7600__sock_open(). Written by the engine task under at_rx_lock, read by the reader task
+typedef struct
+{
+    bool in_use;
+    int handle;                         // Modem socket handle, also the handle given to the application
+    sim7600_sock_rx_cb_t on_rx;         // NULL: data waits in the modem for sim7600__sock_recv()
+    void* ctx;
+    volatile bool rx_queued;            // A receive job is queued, further #XAPOLL reports are absorbed by it
+    volatile bool hangup;               // Peer closed or socket failed, on_rx is told once the data is drained
+} at_sock_t;
+
+typedef struct
+{
+    sim7600_sock_type_t type;
+    bool secure;
+    const char* host;
+    uint16_t port;
+    sim7600_sock_rx_cb_t on_rx;
+    void* ctx;
+} at_sock_open_args_t;
+
+typedef struct
+{
+    int sock;
+    const void* data;                   // Send
+    uint8_t* buf;                       // Receive
+    uint16_t len;                       // Bytes to send, or size of buf
+    uint32_t timeout_ms;
+    uint16_t received;
+    uint32_t dropped;                   // Received beyond len
+} at_sock_io_args_t;
+
 /******************************************************************************
 * Module Variable Definitions
 *******************************************************************************/
-at_resp_data_mailbox_t at_rx_data = {0};
+// The data channel is the only one until sim7600__cmux_start()
+static at_chan_t at_chan[AT_CHAN_COUNT] = {
+    { .dlci = AT_CMUX_DLCI_DATA, .rx_data = { .rx_data = at_chan[AT_CHAN_DATA].rx_data.base, .size = AT_BUFFER_SIZE } },
+    { .dlci = AT_CMUX_DLCI_CONTROL, .rx_data = { .rx_data = at_chan[AT_CHAN_CONTROL].rx_data.base, .size = AT_BUFFER_SIZE } },
+};
+
+// Supported modem rates, ascending. The first entry must be AT_DEFAULT_BAUDRATE
+static const uint32_t at_baudrate_list[] = {115200UL, 230400UL, 460800UL, 921600UL};
+static uint32_t at_cur_baudrate = AT_DEFAULT_BAUDRATE;
+static uint8_t at_cur_flow = HAL_UART_FLOW_NONE;
+static uint8_t at_silent_timeouts = 0;
+static bool at_baud_switching = false;  // Suppress link-loss fallback while probing rates
+static bool at_line_mode = false;       // Modem UART delivers complete lines (hal__UARTLineMode)
+
+// Prefixes the response tokenizers of all channels skip as URCs
+static const char* const at_urc_prefix[] = {"#XHTTPCRSP:", "+CEREG:", "+CSCON:", "%CESQ:", "#XAPOLL:"};
+
+// Reader tasks: the only consumers of the modem link, one per channel. URC lines go to their handler, everything
+// else to the mailbox of the channel
+static volatile uint8_t at_link_state = AT_LINK_DOWN;
+static SemaphoreHandle_t at_rx_lock = NULL;     // Guards at_chan[] and at_urc_handler[]
+static volatile uint32_t at_rx_lines = 0;       // Lines (or chunks without line mode) received, to tell a silent link apart
+static at_urc_handler_t at_urc_handler[AT_URC_MAX_HANDLERS];
+static uint8_t at_urc_handler_count = 0;
+static volatile bool at_cmux_active = false;    // The channels run over cmux.c instead of the bare UART
+
+// HTTP response stream: #XHTTPCRSP payload goes to at_stream_cb instead of the mailbox (guarded by at_rx_lock)
+static sim7600_http_chunk_cb_t at_stream_cb = NULL;
+static void* at_stream_ctx = NULL;
+static bool at_stream_abort = false;            // at_stream_cb refused a chunk, the rest is discarded
+static volatile uint32_t at_stream_bytes = 0;   // Payload bytes received since __sim7600__stream_begin()
+
+// Command engine: a single task runs queued commands back to back, highest priority first
+static sim7600_cmd_t at_cmd_pool[AT_CMD_POOL_SIZE];
+static SemaphoreHandle_t at_cmd_pool_lock = NULL;
+static QueueHandle_t at_cmd_queue[SIM7600_PRIO_COUNT];
+static SemaphoreHandle_t at_cmd_pending = NULL;     // Counts queued commands over all priorities
+static TaskHandle_t at_engine_task = NULL;
+static TaskHandle_t at_reader_task = NULL;
+
+// Control engine: runs SIM7600_PRIO_HIGH commands on their own channel while the multiplexer runs
+static QueueHandle_t at_ctrl_queue = NULL;
+static SemaphoreHandle_t at_ctrl_busy = NULL;   // Held while the control engine runs a command
+static volatile bool at_ctrl_active = false;    // SIM7600_PRIO_HIGH commands are queued for the control engine
+static TaskHandle_t at_ctrl_task = NULL;
+static TaskHandle_t at_ctrl_reader_task = NULL;
+
+static at_https_session_t at_https_session = {0};
+
+static at_sock_t at_sock[SIM7600_SOCK_MAX];
+static int at_sock_selected = -1;               // Engine task only: socket the SLM commands act on, -1 if unknown
+
+// Last known modem state, filled from command results and notifications (guarded by at_state_lock)
+static SemaphoreHandle_t at_state_lock = NULL;
+static at_state_entry_t at_state[SIM7600_STATE_COUNT];
+static uint32_t at_state_ttl_ms[SIM7600_STATE_COUNT] = { AT_STATE_TTL_CFUN_MS, AT_STATE_TTL_REG_MS, AT_STATE_TTL_RSSI_MS, AT_STATE_TTL_SIM_MS };
+
+// Per-verb latency histograms (guarded by at_trace_lock). The open transaction of each engine is in its channel
+static SemaphoreHandle_t at_trace_lock = NULL;
+static sim7600_trace_t at_trace[AT_TRACE_MAX_VERBS];
+static uint8_t at_trace_count = 0;
+
+// Fixed blocks the driver functions borrow instead of keeping AT_BUFFER_SIZE arrays on the caller's stack
+static char at_pool[AT_POOL_BLOCKS][AT_POOL_BLOCK_SIZE];
+static uint32_t at_pool_used = 0;               // Bit n set: at_pool[n] is lent out. Atomic, no lock
+static uint32_t at_pool_peak = 0;               // Most blocks lent out at once
+static SemaphoreHandle_t at_pool_sem = NULL;    // Counting, given for every block given back. Wakes __sim7600__pool_get()
+
+#if (AT_STACK_PROFILE == 1)
+// Engine task stack use per public function (guarded by at_trace_lock)
+static sim7600_stack_usage_t at_stack_usage[AT_STACK_MAX_APIS];
+static uint8_t at_stack_usage_count = 0;
+#endif /* End of (AT_STACK_PROFILE == 1) */
+
+_Static_assert(AT_POOL_BLOCKS <= 32, "at_pool_used is a 32 bit map");
+_Static_assert(AT_HTTP_BODY_BLOCK_SIZE <= AT_POOL_BLOCK_SIZE, "The request body is sent from a pool block");
+_Static_assert(AT_MAILBOX_GROW_BLOCKS <= AT_POOL_BLOCKS, "The grown mailbox is a run of pool blocks");
+_Static_assert(AT_MAILBOX_GROW_SIZE <= UINT16_MAX, "Mailbox offsets are 16 bit");
+
+/******************************************************************************
+* Buffer pool
+*******************************************************************************/
+// Bit map of count blocks from block idx
+static inline uint32_t __sim7600__pool_mask(uint32_t idx, uint8_t count)
+{
+    return ((count == 32) ? UINT32_MAX : ((1UL << count) - 1)) << idx;
+}
+
+/**
+ * @brief Borrow count adjacent blocks as one buffer of count * AT_POOL_BLOCK_SIZE bytes. Lock-free, never blocks.
+ *        Single blocks come from the bottom of the pool and runs from the top, so short loans do not split the runs
+ *
+ * @return char* The first block, NULL if no free run of count blocks
+ */
+static char* __sim7600__pool_take(uint8_t count)
+{
+    uint32_t used = __atomic_load_n(&at_pool_used, __ATOMIC_RELAXED);
+    while(1)
+    {
+        int idx = -1;
+        if(count == 1)
+            idx = (~used & __sim7600__pool_mask(0, AT_POOL_BLOCKS)) ? __builtin_ctz(~used) : -1;
+        for(int pos = AT_POOL_BLOCKS - count; (count > 1) && (idx < 0) && (pos >= 0); pos--)
+        {
+            if( (used & __sim7600__pool_mask(pos, count)) == 0 )
+                idx = pos;
+        }
+        if(idx < 0)
+            return NULL;
+        uint32_t taken = used | __sim7600__pool_mask(idx, count);
+        if(__atomic_compare_exchange_n(&at_pool_used, &used, taken, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            uint32_t in_use = __builtin_popcount(taken);
+            uint32_t peak = __atomic_load_n(&at_pool_peak, __ATOMIC_RELAXED);
+            while( (in_use > peak) && !__atomic_compare_exchange_n(&at_pool_peak, &peak, in_use, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+                ;
+            return at_pool[idx];
+        }
+    }
+}
+
+// Give back count blocks from __sim7600__pool_take(), NULL is ignored
+static void __sim7600__pool_give(char* block, uint8_t count)
+{
+    if(block == NULL)
+        return;
+    uint32_t idx = (uint32_t)(block - at_pool[0]) / AT_POOL_BLOCK_SIZE;
+    __atomic_fetch_and(&at_pool_used, ~__sim7600__pool_mask(idx, count), __ATOMIC_RELEASE);
+    for(uint8_t given = 0; (given < count) && (at_pool_sem != NULL); given++)
+        xSemaphoreGive(at_pool_sem); // Full when nobody waits: the blocks are free anyway
+}
+
+/**
+ * @brief Borrow an AT_POOL_BLOCK_SIZE block. Lock-free, from any task. While all blocks are lent out it sleeps on
+ *        at_pool_sem until one is given back, a block is only held for one command exchange
+ *
+ * @return char* The block, NULL if none came free within AT_POOL_WAIT_MS (at once before the link is set up)
+ */
+char* __sim7600__pool_get(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t wait = pdMS_TO_TICKS(AT_POOL_WAIT_MS);
+    char* block;
+    while( (block = __sim7600__pool_take(1)) == NULL )
+    {
+        // A give can be left from a block taken back meanwhile, then the next take just fails again
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if( (at_pool_sem == NULL) || (elapsed >= wait) || (xSemaphoreTake(at_pool_sem, wait - elapsed) != pdTRUE) )
+        {
+            SIM7600_PRINTF("__sim7600__pool_get(), all %u blocks in use for %lums\n", AT_POOL_BLOCKS, (unsigned long)AT_POOL_WAIT_MS);
+            return NULL;
+        }
+    }
+    return block;
+}
+
+// Give back a block from __sim7600__pool_get(), NULL is ignored
+void __sim7600__pool_put(char* block)
+{
+    __sim7600__pool_give(block, 1);
+}
 
 /******************************************************************************
 * Mailbox functions for AT response data
@@ -99,57 +473,128 @@ int mailbox__get_len(at_resp_data_mailbox_t* mailbox)
     return mailbox->rx_len;
 }
 
-int mailbox__put_data(at_resp_data_mailbox_t* mailbox, char* data, uint16_t len)
+bool mailbox__is_full(at_resp_data_mailbox_t* mailbox)
 {
-    uint16_t actual_len;
-    param_check(mailbox != NULL);
-    param_check(data != NULL);
-    if(mailbox->rx_len + len > sizeof(mailbox->rx_data))
-    {
-        // Re-calulate the length to put into mailbox, discard the new data
-        actual_len = sizeof(mailbox->rx_data) - mailbox->rx_len;
-        SIM7600_PRINTF("mailbox__put_data(), Mailbox overflow, discarded %dB\n", len - actual_len);
-        // Print the discarded data
-        SIM7600_PRINTF("Discarded data:");
-        for(int i = actual_len; i < len; i++)
-        {
-            SIM7600_PRINTF("%c", data[i]);
-        }
-        SIM7600_PRINTF("\r\n");
+    return (mailbox->rx_len == mailbox->size) && ( (AT_MAILBOX_GROW_SIZE <= AT_BUFFER_SIZE) || (mailbox->rx_data != mailbox->base) );
+}
+
+// Contiguous bytes from offset (relative to the oldest byte) to the end of the content or of the storage
+uint16_t mailbox__peek(at_resp_data_mailbox_t* mailbox, uint16_t offset, const char** data)
+{
+    if(offset >= mailbox->rx_len)
+        return 0;
+    uint32_t pos = mailbox->head + offset;
+    if(pos >= mailbox->size)
+        pos -= mailbox->size;
+    *data = &mailbox->rx_data[pos];
+    return MIN((uint32_t)(mailbox->rx_len - offset), (uint32_t)(mailbox->size - pos));
+}
+
+// Offset of the first chr at or after offset, FAILURE if none
+int mailbox__find(at_resp_data_mailbox_t* mailbox, uint16_t offset, char chr)
+{
+    const char* data;
+    uint16_t span_len;
+    while( (span_len = mailbox__peek(mailbox, offset, &data)) != 0 )
+    {
+        const char* found = memchr(data, chr, span_len);
+        if(found != NULL)
+            return offset + (found - data);
+        offset += span_len;
     }
-    else
+    return FAILURE;
+}
+
+// Drained: give back the grown blocks. Caller holds the only reference to the content
+static void __mailbox__shrink(at_resp_data_mailbox_t* mailbox)
+{
+    if( (mailbox->rx_len == 0) && (mailbox->rx_data != mailbox->base) )
     {
-        actual_len = len;
+        __sim7600__pool_give(mailbox->rx_data, AT_MAILBOX_GROW_BLOCKS);
+        mailbox->rx_data = mailbox->base;
+        mailbox->size = AT_BUFFER_SIZE;
     }
-    memcpy(&mailbox->rx_data[mailbox->rx_len], data, actual_len);
-    mailbox->rx_len += len;
-    return SUCCESS;
+    if(mailbox->rx_len == 0)
+        mailbox->head = 0;
 }
 
-int mailbox__get_data(at_resp_data_mailbox_t* mailbox, char* data, uint16_t len)
+// Discard the first len bytes, keep the rest
+int mailbox__drop(at_resp_data_mailbox_t* mailbox, uint16_t len)
 {
     param_check(mailbox != NULL);
-    param_check(data != NULL);
     if(mailbox->rx_len < len)
         return FAILURE;
-    memcpy(data, mailbox->rx_data, len);
+    uint32_t head = mailbox->head + len;
+    mailbox->head = (head >= mailbox->size) ? head - mailbox->size : head;
     mailbox->rx_len -= len;
-    memmove(mailbox->rx_data, &mailbox->rx_data[len], mailbox->rx_len);
+    __mailbox__shrink(mailbox);
     return mailbox->rx_len;
 }
 
+int mailbox__get_data(at_resp_data_mailbox_t* mailbox, char* data, uint16_t len)
+{
+    param_check(mailbox != NULL);
+    param_check(data != NULL);
+    if(mailbox->rx_len < len)
+        return FAILURE;
+    const char* span = mailbox->rx_data; // Left as is by mailbox__peek() when the mailbox is empty
+    uint16_t first_len = MIN(len, mailbox__peek(mailbox, 0, &span));
+    memcpy(data, span, first_len);
+    memcpy(&data[first_len], mailbox->rx_data, len - first_len);
+    return mailbox__drop(mailbox, len);
+}
+
+// Full base ring: move the content, oldest byte first, into a run of pool blocks. Only once per drain, never waits
+static void __mailbox__grow(at_resp_data_mailbox_t* mailbox)
+{
+    if( (AT_MAILBOX_GROW_SIZE <= AT_BUFFER_SIZE) || (mailbox->rx_data != mailbox->base) )
+        return;
+    char* block = __sim7600__pool_take(AT_MAILBOX_GROW_BLOCKS);
+    if(block == NULL)
+        return;
+    uint16_t len = mailbox->rx_len;
+    mailbox__get_data(mailbox, block, len);
+    mailbox->rx_data = block;
+    mailbox->size = AT_MAILBOX_GROW_SIZE;
+    mailbox->head = 0;
+    mailbox->rx_len = len;
+}
+
+// Stores what fits. Returns FAILURE if bytes were discarded, counted in mailbox->overflow
+int mailbox__put_data(at_resp_data_mailbox_t* mailbox, const char* data, uint16_t len)
+{
+    param_check(mailbox != NULL);
+    param_check(data != NULL);
+    if(mailbox->rx_len + len > mailbox->size)
+        __mailbox__grow(mailbox);
+    uint16_t actual_len = MIN(len, mailbox->size - mailbox->rx_len);
+    uint32_t tail = mailbox->head + mailbox->rx_len;
+    if(tail >= mailbox->size)
+        tail -= mailbox->size;
+    uint16_t first_len = MIN(actual_len, mailbox->size - tail);
+    memcpy(&mailbox->rx_data[tail], data, first_len);
+    memcpy(mailbox->rx_data, &data[first_len], actual_len - first_len);
+    mailbox->rx_len += actual_len;
+    if(actual_len == len)
+        return SUCCESS;
+    mailbox->overflow += len - actual_len;
+    return FAILURE;
+}
+
 int mailbox__flush(at_resp_data_mailbox_t* mailbox)
 {
     param_check(mailbox != NULL);
     mailbox->rx_len = 0;
-    memset(mailbox->rx_data, 0, sizeof(mailbox->rx_data));
+    __mailbox__shrink(mailbox);
     return SUCCESS;
 }
 
 int mailbox_logdata(at_resp_data_mailbox_t* mailbox)
 {
     param_check(mailbox != NULL);
-    SIM7600_INFO_PRINTF("%s", mailbox->rx_data);
+    const char* data;
+    for(uint16_t offset = 0, span_len; (span_len = mailbox__peek(mailbox, offset, &data)) != 0; offset += span_len)
+        SIM7600_INFO_PRINTF("%.*s", (int)span_len, data);
     return SUCCESS;
 }
 
@@ -163,19 +608,235 @@ int hal__getStackSize(void)
 /******************************************************************************
 * Internal Function Prototypes
 *******************************************************************************/
-int __sim7600__send_command(char* command);
-int __sim7600__wait_4response(char *expected_resp, uint16_t timeout_ms);
+int __sim7600__init_link(void);
+int __sim7600__scan_resp(at_chan_t* chan);
+uint16_t __sim7600__dispatch_line(at_chan_t* chan, const hal_uart_span_t* rx_span, uint16_t len);
+void __sim7600__stream_payload(at_chan_t* chan);
+void __sim7600__reader_task(void *pvParameters);
+void __sim7600__stream_begin(sim7600_http_chunk_cb_t on_chunk, void* ctx);
+int __sim7600__stream_wait(void);
+int __sim7600__init_engine(void);
+void __sim7600__engine_task(void *pvParameters);
+void __sim7600__ctrl_task(void *pvParameters);
+void __sim7600__run_cmd(sim7600_cmd_t* cmd);
+int __sim7600__run_job(const char* api, at_job_fn_t job, void* arg, uint8_t priority);
+int __sim7600__post_job(const char* api, at_job_fn_t job, void* arg, uint8_t priority);
+int __sim7600__exec(const char* command, const char* expected, uint16_t timeout_ms, uint8_t priority, char* resp, uint16_t resp_size);
+int __sim7600__transact(const char* command, const char* expected, uint16_t timeout_ms, char* resp, uint16_t resp_size, int* resp_len);
+sim7600_cmd_t* __sim7600__cmd_alloc(void);
+void __sim7600__cmd_free(sim7600_cmd_t* cmd);
+int __sim7600__cmd_queue(sim7600_cmd_t* cmd, uint8_t priority);
+int __sim7600__send_command(const char* command);
+int __sim7600__send_commandv(const struct iovec* iov, uint8_t iovcnt);
+int __sim7600__wait_4response(const char *expected_resp, uint16_t timeout_ms);
 int __sim7600__get_resp(char* resp, uint16_t maxlength);
+int __sim7600__get_resp_int(const char* prefix, int* value);
 int __sim7600__clearCert();
 
 int __sim7600__cal_rssi_from_cesq(char* cesq_response);
-int __sim7600__get_http_content_len(const char* resp);
-
-int __sim7600__httpsGET_send_req(char* url);
-int __sim7600__httpsPOST_send_req(char* url, char* JSONdata, char* agent);
+int __sim7600__rssi_dbm(int rsrp, int rsrq);
+
+int __sim7600__https_connect(const struct iovec* host);
+void __sim7600__https_disconnect(void);
+void __sim7600__https_done(int status);
+int __sim7600__httpsGET_send_req(char* url, uint32_t range_from);
+int __sim7600__httpsPOST_send_req(char* url, char* agent, const sim7600_http_body_t* body);
+
+at_sock_t* __sim7600__sock_find(int sock);
+int __sim7600__sock_select(int sock);
+void __sim7600__sock_from_urc(const char* line);
+int __sim7600__sock_rx_job(void* arg);
+
+at_chan_t* __sim7600__chan(void);
+int __sim7600__link_writev(at_chan_t* chan, const struct iovec* iov, uint8_t iovcnt);
+int __sim7600__probe_link(void);
+int __sim7600__switch_baudrate(uint32_t baudrate, uint8_t flow);
+int __sim7600__recover_baudrate(void);
+void __sim7600__link_silent(void);
+int __sim7600__cmux_start_job(void* arg);
+int __sim7600__cmux_stop_job(void* arg);
+
+void __sim7600__trace_begin(const struct iovec* iov, uint8_t iovcnt);
+void __sim7600__trace_rx(at_chan_t* chan, uint32_t len);
+void __sim7600__trace_result(sim7600_trace_outcome_t outcome);
+void __sim7600__trace_end(void);
+
+void __sim7600__stack_paint(uint8_t* frame);
+void __sim7600__stack_record(const char* api, const uint8_t* frame);
 /******************************************************************************
 * Internal Function Definitions
 *******************************************************************************/
+/**
+ * @brief Open the trace of a command about to be sent, closing the previous one. The verb is what follows "AT" up to
+ *        '=', '?' or the line end: "+CESQ", "#XHTTPCREQ". Engine task
+ */
+void __sim7600__trace_begin(const struct iovec* iov, uint8_t iovcnt)
+{
+    __sim7600__trace_end();
+    at_trace_txn_t txn = { .active = true, .outcome = SIM7600_TRACE_ERROR, .start_us = PORT_GET_TIME_US() };
+    const char* cmd = (const char*)iov[0].iov_base;
+    size_t idx = ( (iov[0].iov_len > 2) && (strncmp(cmd, "AT", 2) == 0) ) ? 2 : 0;
+    uint8_t verb_len = 0;
+    while( (idx < iov[0].iov_len) && (verb_len < SIM7600_TRACE_VERB_LEN) && (strchr("=?\r\n", cmd[idx]) == NULL) )
+        txn.verb[verb_len++] = cmd[idx++];
+    if(verb_len == 0)
+        memcpy(txn.verb, "AT", 3);
+    for(uint8_t seg = 0; seg < iovcnt; seg++)
+        txn.bytes_out += iov[seg].iov_len;
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    __sim7600__chan()->trace_txn = txn;
+    xSemaphoreGive(at_rx_lock);
+}
+
+// Response bytes for the open transaction of chan. Reader task, caller holds at_rx_lock
+void __sim7600__trace_rx(at_chan_t* chan, uint32_t len)
+{
+    if(!chan->trace_txn.active)
+        return;
+    if(chan->trace_txn.first_us == 0)
+        chan->trace_txn.first_us = PORT_GET_TIME_US();
+    chan->trace_txn.bytes_in += len;
+}
+
+// A response wait of the open transaction ended, the last one decides the outcome. Engine task
+void __sim7600__trace_result(sim7600_trace_outcome_t outcome)
+{
+    at_trace_txn_t* txn = &__sim7600__chan()->trace_txn;
+    txn->final_us = PORT_GET_TIME_US();
+    txn->outcome = outcome;
+}
+
+// Histogram bucket of a duration, see SIM7600_TRACE_BUCKET_US()
+static uint8_t __sim7600__trace_bucket(uint32_t us)
+{
+    uint8_t bucket = (us < 8) ? 0 : (uint8_t)(31 - __builtin_clz(us) - 2);
+    return MIN(bucket, SIM7600_TRACE_BUCKETS - 1);
+}
+
+/**
+ * @brief Close the open transaction and add it to the counters of its verb. Engine task, after every command or job
+ *        and before the next command is sent
+ */
+void __sim7600__trace_end(void)
+{
+    at_chan_t* chan = __sim7600__chan();
+    if( !chan->trace_txn.active || (at_trace_lock == NULL) )
+        return;
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    at_trace_txn_t txn = chan->trace_txn;
+    chan->trace_txn.active = false;
+    xSemaphoreGive(at_rx_lock);
+    if(txn.final_us == 0)
+        txn.final_us = PORT_GET_TIME_US(); // Send failed, no wait
+
+    xSemaphoreTake(at_trace_lock, portMAX_DELAY);
+    sim7600_trace_t* trace = NULL;
+    for(uint8_t idx = 0; (idx < at_trace_count) && (trace == NULL); idx++)
+    {
+        if(strcmp(at_trace[idx].verb, txn.verb) == 0)
+            trace = &at_trace[idx];
+    }
+    if(trace == NULL)
+    {
+        if(at_trace_count < AT_TRACE_MAX_VERBS)
+        {
+            trace = &at_trace[at_trace_count++];
+            memcpy(trace->verb, txn.verb, sizeof(trace->verb));
+        }
+        else
+        {
+            trace = &at_trace[AT_TRACE_MAX_VERBS - 1];
+            memcpy(trace->verb, "*", 2); // Table full, the last entry counts all other verbs
+        }
+    }
+    uint32_t final_us = (uint32_t)(txn.final_us - txn.start_us);
+    trace->count++;
+    trace->outcome[txn.outcome]++;
+    trace->final_hist[__sim7600__trace_bucket(final_us)]++;
+    trace->final_total_us += final_us;
+    if(final_us > trace->final_max_us)
+        trace->final_max_us = final_us;
+    if(txn.first_us != 0)
+    {
+        uint32_t first_us = (uint32_t)(txn.first_us - txn.start_us);
+        trace->first_hist[__sim7600__trace_bucket(first_us)]++;
+        trace->first_total_us += first_us;
+    }
+    trace->bytes_out += txn.bytes_out;
+    trace->bytes_in += txn.bytes_in;
+    xSemaphoreGive(at_trace_lock);
+}
+
+// Upper bound of the bucket holding the pct-th percentile, UINT32_MAX if it is the open-ended one
+static uint32_t __sim7600__trace_pct(const uint32_t* hist, uint8_t pct)
+{
+    uint32_t total = 0, seen = 0;
+    for(uint8_t bucket = 0; bucket < SIM7600_TRACE_BUCKETS; bucket++)
+        total += hist[bucket];
+    for(uint8_t bucket = 0; bucket < SIM7600_TRACE_BUCKETS - 1; bucket++)
+    {
+        seen += hist[bucket];
+        if( (total != 0) && (seen * 100ULL >= total * (uint64_t)pct) )
+            return SIM7600_TRACE_BUCKET_US(bucket + 1);
+    }
+    return (total != 0) ? UINT32_MAX : 0;
+}
+
+// Returns true and the value if field was stored within its freshness window
+bool __sim7600__state_get(sim7600_state_t field, long* value)
+{
+    bool fresh = false;
+    if(at_state_lock == NULL)
+        return false;
+    xSemaphoreTake(at_state_lock, portMAX_DELAY);
+    if(at_state[field].valid && (PORT_GET_SYSTIME_MS() - at_state[field].stamp_ms < at_state_ttl_ms[field]))
+    {
+        *value = at_state[field].value;
+        fresh = true;
+    }
+    xSemaphoreGive(at_state_lock);
+    return fresh;
+}
+
+void __sim7600__state_set(sim7600_state_t field, long value)
+{
+    if(at_state_lock == NULL)
+        return;
+    xSemaphoreTake(at_state_lock, portMAX_DELAY);
+    at_state[field] = (at_state_entry_t){ .value = value, .stamp_ms = PORT_GET_SYSTIME_MS(), .valid = true };
+    xSemaphoreGive(at_state_lock);
+}
+
+void __sim7600__state_invalidate(sim7600_state_t field)
+{
+    if(at_state_lock == NULL)
+        return;
+    xSemaphoreTake(at_state_lock, portMAX_DELAY);
+    at_state[field].valid = false;
+    xSemaphoreGive(at_state_lock);
+}
+
+// Functional mode change on its way: everything that depends on the radio has to be read again
+void __sim7600__state_cfun_changed(void)
+{
+    for(uint8_t field = 0; field < SIM7600_STATE_COUNT; field++)
+        __sim7600__state_invalidate((sim7600_state_t)field);
+}
+
+// Notifications the cache follows, whether or not the application registered a handler for them. Reader task
+void __sim7600__state_from_urc(const char* line)
+{
+    int rsrp, rsrq;
+    if(strncmp(line, "+CEREG:", 7) == 0)
+        __sim7600__state_invalidate(SIM7600_STATE_REG); // sim7600__connected() reads +COPS, ask again
+    else if(sscanf(line, "%%CESQ: %d,%*d,%d", &rsrp, &rsrq) == 2)
+    {
+        int rssi = __sim7600__rssi_dbm(rsrp, rsrq);
+        if(rssi != FAILURE)
+            __sim7600__state_set(SIM7600_STATE_RSSI, rssi);
+    }
+}
+
 /**
  * @brief Get the rssi from CESQ response string
  * @param cesq_response 
@@ -185,13 +846,22 @@ int __sim7600__httpsPOST_send_req(char* url, char* JSONdata, char* agent);
 int __sim7600__cal_rssi_from_cesq(char* cesq_response)
 {
     param_check(cesq_response != NULL);
-    int rsrq, rsrp, rssi;
+    int rsrq, rsrp;
     int status = sscanf(cesq_response, "+CESQ: %*d,%*d,%*d,%*d,%d,%d", &rsrq, &rsrp);
     if(status != 2)
         return FAILURE;
+    return __sim7600__rssi_dbm(rsrp, rsrq);
+}
+
+/**
+ * @brief RSSI from the RSRP (0..97) and RSRQ (0..34) indexes of +CESQ and %CESQ
+ * @return RSSI in dBm, FAILURE if both are unknown (255)
+ */
+int __sim7600__rssi_dbm(int rsrp, int rsrq)
+{
     if( (rsrp == 255) && (rsrq == 255) )
         return FAILURE; // Invalid response
-    rssi = (double)(10 * log10(6) + (rsrp - 140) - (rsrq - 19.5));
+    int rssi = (double)(10 * log10(6) + (rsrp - 140) - (rsrq - 19.5));
     return rssi;
 }
 
@@ -231,13 +901,13 @@ long __sim7600__get_unix_timestamp(const char* datetime)
 }
 
 /**
- * @brief Parse the URL to get the host and path
+ * @brief Split the URL into host and path, both pointing into url (nothing is copied or truncated)
  * 
  * @param url 
- * @param host 
- * @param path 
+ * @param host: Host part, not NUL-terminated
+ * @param path: Path part, "/" if the URL has none
  */
-int __sim7600__parse_url(const char* url, char* host, char* path)
+int __sim7600__parse_url(const char* url, struct iovec* host, struct iovec* path)
 {
     param_check(url != NULL);
     param_check(host != NULL);
@@ -245,655 +915,2376 @@ int __sim7600__parse_url(const char* url, char* host, char* path)
 
     /* Extract hostname and path from URL */
     const char* slash = strchr(url, '/');
+    host->iov_base = (void*)url;
     if (slash) 
     { 
         // '/' found, Get the length of the host by subtracting pointers
-        uint8_t host_len = slash - url;
-        memcpy(host, url, host_len);
-        host[host_len] = '\0';
-        strcpy(path, slash);
+        host->iov_len = slash - url;
+        path->iov_base = (void*)slash;
+        path->iov_len = strlen(slash);
     }
     else 
     {
         // No '/' found, assume that the entire URL is the host
-        strcpy(host, url);
-        path[0] = '/';
-        path[1] = '\0';
+        host->iov_len = strlen(url);
+        path->iov_base = "/";
+        path->iov_len = 1;
     }
     return SUCCESS;
 }
 
 /**
- * @brief: Get the content length from the response header lines
- * 
- * @param resp: The response header from the server 
- * @return int: The content length of the response body
+ * @brief Channel of the calling task: the control engine has its own while the multiplexer runs, every other task
+ *        (the engine, the functions it runs inline) uses the data channel
  */
-int __sim7600__get_http_content_len(const char* resp)
+at_chan_t* __sim7600__chan(void)
 {
-    param_check(resp != NULL);
-    int content_length;
-    char* content_length_str = strstr(resp, "Content-Length: ");
-    if(content_length_str == NULL)
-        return FAILURE; // Invalid response
-    if (sscanf(content_length_str, "Content-Length: %d", &content_length) != 1)
-    {
-        SIM7600_PRINTF("Invalid response\n");
-        return FAILURE; // Invalid response
-    }
-    return content_length;
+    if( (at_ctrl_task != NULL) && (xTaskGetCurrentTaskHandle() == at_ctrl_task) )
+        return &at_chan[AT_CHAN_CONTROL];
+    return &at_chan[AT_CHAN_DATA];
+}
+
+// The link delivers complete lines: the UART in line mode, or any multiplexer channel
+static bool __sim7600__link_lines(void)
+{
+    return at_cmux_active || at_line_mode;
+}
+
+/**
+ * @brief Wait for received bytes on the link of chan: its DLCI while the multiplexer runs, otherwise the UART
+ *
+ * @param line: Wait for a complete line rather than any byte
+ * @return int Bytes (or line length) available, 0 on timeout, FAILURE if chan has no link right now
+ */
+static int __sim7600__link_wait(at_chan_t* chan, bool line, uint32_t timeout_ms)
+{
+    if(at_cmux_active)
+        return line ? cmux__wait_line(chan->dlci, timeout_ms) : cmux__wait_rx(chan->dlci, timeout_ms);
+    if(chan != &at_chan[AT_CHAN_DATA])
+        return FAILURE; // Only the multiplexer has a control channel
+    return line ? hal__UARTWaitLine(AT_DEFAULT_UART_PORT, timeout_ms) : hal__UARTWaitRX(AT_DEFAULT_UART_PORT, timeout_ms);
 }
 
+// Zero-copy view of the next line (or all bytes) received on the link of chan, see hal__UARTPeekLine()
+static int __sim7600__link_peek(at_chan_t* chan, bool line, hal_uart_span_t* rx_span)
+{
+    if(at_cmux_active)
+        return line ? cmux__peek_line(chan->dlci, &rx_span[0], &rx_span[1]) : cmux__peek(chan->dlci, &rx_span[0], &rx_span[1]);
+    return line ? hal__UARTPeekLine(AT_DEFAULT_UART_PORT, &rx_span[0], &rx_span[1]) : hal__UARTPeek(AT_DEFAULT_UART_PORT, &rx_span[0], &rx_span[1]);
+}
 
-int __sim7600__send_command(char* command)
+static void __sim7600__link_consume(at_chan_t* chan, uint16_t len)
 {
-    param_check(command != NULL);
-#if (AT_FLUSH_RX_BEFORE_WRITE != 0)  //Clear AT RX buffer before sending command
-    hal__UARTFlushRX(AT_DEFAULT_UART_PORT);
-    mailbox__flush(&at_rx_data);        
-#endif /* End of (AT_FLUSH_RX_BEFORE_WRITE != 0) */
-    return hal__UARTWrite(AT_DEFAULT_UART_PORT, (uint8_t*) command, strnlen(command, AT_BUFFER_SIZE));
+    if(at_cmux_active)
+        cmux__consume(chan->dlci, len);
+    else
+        hal__UARTConsume(AT_DEFAULT_UART_PORT, len);
 }
 
 /**
- * @brief Waits for a response from the LTE modem and checks if it matches the expected response.
- * 
- * @param expected_resp The expected response from the LTE module.
- * @param timeout_ms The maximum time to wait for the response in milliseconds.
- * @return int Returns SUCCESS if the expected response is received within the timeout period, otherwise returns FAILURE.
+ * @brief Write to the link of chan, commands and raw data alike. While the multiplexer runs, the segments go out in
+ *        frames that other channels may come between
+ *
+ * @return int Bytes written, FAILURE on error
+ */
+int __sim7600__link_writev(at_chan_t* chan, const struct iovec* iov, uint8_t iovcnt)
+{
+    if(at_cmux_active)
+        return cmux__writev(chan->dlci, iov, iovcnt);
+    return hal__UARTWritev(AT_DEFAULT_UART_PORT, iov, iovcnt);
+}
+
+// Forget what is in the mailbox of chan. Caller holds at_rx_lock
+static void __sim7600__chan_flush(at_chan_t* chan)
+{
+    mailbox__flush(&chan->rx_data);
+    chan->scan_idx = 0;
+    at_parser__reset(&chan->parser);
+}
+
+/**
+ * @brief Feed the mailbox bytes of chan not scanned yet to its response tokenizer, up to the first final result.
+ *        Caller holds at_rx_lock.
+ *
+ * @return int AT_TOKEN_EXPECTED or an error token, AT_TOKEN_NONE if the response is not complete yet
  */
+int __sim7600__scan_resp(at_chan_t* chan)
+{
+    while( (chan->scan_idx < mailbox__get_len(&chan->rx_data)) || (chan->parser.pending != 0) )
+    {
+        at_match_t match;
+        const char* data = NULL;
+        uint16_t span_len = mailbox__peek(&chan->rx_data, chan->scan_idx, &data);
+        chan->scan_idx += at_parser__feed(&chan->parser, (const uint8_t*)data, span_len, &match);
+        if( (match.token != AT_TOKEN_NONE) && (match.token != AT_TOKEN_URC) && (match.token != AT_TOKEN_OK) )
+            return match.token; // Expected response or an error
+    }
+    return AT_TOKEN_NONE;
+}
 
-int __sim7600__wait_4response(char* expected_resp, uint16_t timeout_ms)
+/**
+ * @brief Route one line received on chan: an #XHTTPCRSP header to the response stream if one is open, to its URC
+ *        handler if one is registered for its prefix, otherwise into the mailbox of chan, waking its engine once the
+ *        response is complete
+ *
+ * @param rx_span: The line as seen through hal__UARTPeekLine (span 1 is the wrapped part)
+ * @param len: Line length, terminator included
+ * @return uint16_t Bytes used up, less than len if several lines came merged
+ */
+uint16_t __sim7600__dispatch_line(at_chan_t* chan, const hal_uart_span_t* rx_span, uint16_t len)
 {
-    uint8_t rcv_buf[AT_BUFFER_SIZE] = {0};  // Temp buffer to receive data from UART
-    uint16_t recv_idx = 0;
-    uint64_t max_recv_timeout = PORT_GET_SYSTIME_MS() + timeout_ms;
-    // Wait until maximum AT_DEFAULT_TIMEOUT_MS to receive expected_resp
-#if (TEST_DUMP_DATA_RECV == 1)
-SIM7600_INFO_PRINTF(" ======================================================================== ");
-#endif /* End of (TEST_DUMP_DATA_RECV == 1) */
-    while (PORT_GET_SYSTIME_MS() < max_recv_timeout)
+    at_urc_handler_t handler = {0};
+    uint16_t line_len = 0;
+    int result = AT_TOKEN_NONE;
+    bool wake = false;
+    char* line = chan->urc_line;
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    // Always copied, the state cache looks at every line
+    line_len = MIN(len, sizeof(chan->urc_line) - 1);
+    uint16_t head_len = MIN(line_len, rx_span[0].len);
+    memcpy(line, rx_span[0].data, head_len);
+    memcpy(&line[head_len], rx_span[1].data, line_len - head_len);
+    // Line ends inside a payload held up in the UART ring can overflow the HAL line queue, lines then come merged:
+    // only the first one is used up here, the rest comes back as the next line
+    const char* line_end = memchr(line, '\n', line_len);
+    hal_uart_span_t span[2] = { rx_span[0], rx_span[1] };
+    if( (line_end != NULL) && (line_end - line + 1 < len) )
     {
-        uint16_t resp_len = hal__UARTAvailable(AT_DEFAULT_UART_PORT);
-        if(recv_idx + resp_len > sizeof(rcv_buf) )
+        len = (uint16_t)(line_end - line + 1);
+        line_len = len;
+        span[0].len = MIN(span[0].len, len);
+        span[1].len = len - span[0].len;
+    }
+    while( (line_len > 0) && ((line[line_len - 1] == '\r') || (line[line_len - 1] == '\n')) )
+        line_len--;
+    line[line_len] = '\0';
+
+    // "#XHTTPCRSP:<len>,<state>" announces <len> raw payload bytes, only the final "#XHTTPCRSP:0,1" ends the wait.
+    // "#XRECV: <len>" does the same for socket data, the final "OK" follows the payload
+    unsigned long payload_len;
+    int payload_state;
+    if( (at_stream_cb != NULL) &&
+        (((sscanf(line, "#XHTTPCRSP:%lu,%d", &payload_len, &payload_state) == 2) && ((payload_len != 0) || (payload_state == 0))) ||
+         ((sscanf(line, "#XRECV:%lu", &payload_len) == 1) && (payload_len != 0))) )
+    {
+        chan->stream_remaining = payload_len;
+        __sim7600__trace_rx(chan, len);
+        xSemaphoreGive(at_rx_lock);
+        return len;
+    }
+
+    for(uint8_t idx = 0; idx < at_urc_handler_count; idx++)
+    {
+        if( (line_len >= at_urc_handler[idx].len) && (memcmp(line, at_urc_handler[idx].prefix, at_urc_handler[idx].len) == 0) )
+        {
+            handler = at_urc_handler[idx];
+            break;
+        }
+    }
+    // Socket events never reach the mailbox, they would end the wait of an unrelated command
+    bool sock_event = (handler.cb == NULL) && (strncmp(line, "#XAPOLL:", 8) == 0);
+    if( (handler.cb == NULL) && !sock_event )
+    {
+        __sim7600__trace_rx(chan, len);
+        for(uint8_t span_idx = 0; span_idx < 2; span_idx++)
         {
-            SIM7600_PRINTF("__sim7600__wait_4response(), Buffer overflow, discarded %dB\n", recv_idx + resp_len - sizeof(rcv_buf));
-            // Read until full and discard newest data
-            resp_len = sizeof(rcv_buf) - recv_idx;
+            if(span[span_idx].len != 0)
+                mailbox__put_data(&chan->rx_data, (const char*)span[span_idx].data, span[span_idx].len);
         }
-        if(resp_len > 0)
+        if(chan->waiting)
         {
-            hal__UARTRead(AT_DEFAULT_UART_PORT, &rcv_buf[recv_idx], resp_len);
-            recv_idx += resp_len;
-#if (TEST_DUMP_DATA_RECV == 1)
-            SIM7600_INFO_PRINT_HEX(&rcv_buf[recv_idx - resp_len], resp_len);
-SIM7600_INFO_PRINTF(" ======================================================================== ");
-#endif /* End of (TEST_DUMP_DATA_RECV == 1) */
-            if(strstr((char*)rcv_buf, "ERR") != NULL)
-                return FAILURE; // Error response received
-            else if(strstr((char*)rcv_buf, expected_resp) != NULL)
-            {
-                mailbox__put_data(&at_rx_data, (char*)rcv_buf, recv_idx);
-                return SUCCESS;
-            }
-            // If buffer full without receiving expected_resp, log and return FAILURE
-            if(recv_idx == sizeof(rcv_buf))
-            {
-                SIM7600_PRINTF("__sim7600__wait_4response(), Buffer full without receiving \"%s\"\n",expected_resp);
-                SIM7600_PRINTF("Try to increase buffer, current buffer payload: ");
-                for(uint8_t idx=0; idx<recv_idx; idx++)
-                {
-                    SIM7600_PRINTF("%c",rcv_buf[idx]);
-                }
-                SIM7600_PRINTF("\r\n");
-                return FAILURE;
-            }
+            result = __sim7600__scan_resp(chan);
+            // A full mailbox ends the wait too, the caller reports it
+            wake = (result != AT_TOKEN_NONE) || mailbox__is_full(&chan->rx_data);
+            chan->waiting = !wake;
         }
-        PORT_DELAY_MS(100); // Wait for UART buffer to fill up
     }
-    return FAILURE;
+    xSemaphoreGive(at_rx_lock);
+
+    if( (line[0] == '+') || (line[0] == '%') )
+        __sim7600__state_from_urc(line);
+    if(sock_event)
+        __sim7600__sock_from_urc(line);
+    if(handler.cb != NULL)
+        handler.cb(line, line_len, handler.ctx); // Outside the lock, a slow handler only delays the next line
+    if(wake)
+        xQueueSend(chan->resp_queue, &result, 0);
+    return len;
 }
 
-
-int __sim7600__get_resp(char* resp, uint16_t maxlength)
+/**
+ * @brief Pass the next bytes of the current #XHTTPCRSP payload from the link of chan to the stream callback, byte
+ *        exact: line ends inside the payload mean nothing. Gives up the payload if the stream was closed meanwhile
+ */
+void __sim7600__stream_payload(at_chan_t* chan)
 {
-    param_check(resp != NULL);
-    uint16_t cur_len = mailbox__get_len(&at_rx_data);
-    if(cur_len > maxlength)
+    hal_uart_span_t rx_span[2];
+    int avail_len = __sim7600__link_wait(chan, false, AT_READER_IDLE_MS);
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    if( (at_stream_cb == NULL) || (avail_len < 0) )
     {
-        SIM7600_PRINTF("__sim7600__get_resp(), Buffer overflow, current buffer length: %dB, maxlength: %dB, discarded %dB\n",
-                        cur_len, maxlength, cur_len - maxlength);
-        cur_len = maxlength;
+        chan->stream_remaining = 0; // Stream timed out or ended without the announced bytes, or the link changed
+        xSemaphoreGive(at_rx_lock);
+        return;
     }
-    if( cur_len != 0)
+    if( (avail_len > 0) && (__sim7600__link_peek(chan, false, rx_span) > 0) )
     {
-        cur_len = mailbox__get_data(&at_rx_data, resp, cur_len);
-        mailbox__flush(&at_rx_data);
+        uint16_t chunk_len = MIN((uint32_t)avail_len, chan->stream_remaining);
+        uint16_t left = chunk_len;
+        for(uint8_t span_idx = 0; (span_idx < 2) && (left > 0); span_idx++)
+        {
+            uint16_t part_len = MIN(rx_span[span_idx].len, left);
+            // Called under the lock so the stream cannot be closed while the callback runs
+            if( !at_stream_abort && (part_len != 0) && (at_stream_cb(rx_span[span_idx].data, part_len, at_stream_ctx) != SUCCESS) )
+                at_stream_abort = true;
+            left -= part_len;
+        }
+        __sim7600__link_consume(chan, chunk_len);
+        chan->stream_remaining -= chunk_len;
+        at_stream_bytes += chunk_len;
+        __sim7600__trace_rx(chan, chunk_len);
+        at_rx_lines++;
+        at_silent_timeouts = 0;
     }
-    return cur_len;
+    xSemaphoreGive(at_rx_lock);
 }
 
-int __sim7600__clearCert()
+/**
+ * @brief Reader task of one channel: blocks on its link and dispatches every line as it arrives, whether or not a
+ *        command is pending
+ */
+void __sim7600__reader_task(void *pvParameters)
 {
-    if (__sim7600__send_command("AT+CFUN=4\r\n") != SUCCESS)
-        return FAILURE; // Failed to send command
-
-    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-
-    // Check (list) to see if cert exists
-    if (__sim7600__send_command("AT%CMNG=1,12354,0\r\n") != SUCCESS)
-        return FAILURE; // Failed to send command
-
-    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-
-    char resp[AT_BUFFER_SIZE] = {0};
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
-    char* cert_str = strstr(resp, "%CMNG: 12354, 0");
-    if(cert_str == NULL)
-        return SUCCESS; // Cert does not exist, return success
-    else
+    at_chan_t* chan = (at_chan_t*)pvParameters;
+    hal_uart_span_t rx_span[2];
+    while(1)
     {
-        if (__sim7600__send_command("AT%CMNG=3,12354,0\r\n") != SUCCESS)
-            return FAILURE; // Failed to send command
-
-        if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-            return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+        if(chan->stream_remaining != 0)
+        {
+            __sim7600__stream_payload(chan);
+            continue;
+        }
+        bool line = __sim7600__link_lines();
+        int avail_len = __sim7600__link_wait(chan, line, AT_READER_IDLE_MS);
+        if(avail_len < 0)
+        {
+            // Port not installed yet, or no multiplexer for this channel
+            xSemaphoreTake(chan->link_sem, pdMS_TO_TICKS(AT_READER_IDLE_MS));
+            continue;
+        }
+        // Without line mode every chunk counts as solicited data. Stop after an #XHTTPCRSP header, payload follows
+        while( (chan->stream_remaining == 0) && ((avail_len = __sim7600__link_peek(chan, line, rx_span)) > 0) )
+        {
+#if (TEST_DUMP_DATA_RECV == 1)
+            SIM7600_INFO_PRINT_HEX(rx_span[0].data, rx_span[0].len);
+            if(rx_span[1].len != 0)
+                SIM7600_INFO_PRINT_HEX(rx_span[1].data, rx_span[1].len);
+#endif /* End of (TEST_DUMP_DATA_RECV == 1) */
+            at_rx_lines++;
+            at_silent_timeouts = 0;
+            __sim7600__link_consume(chan, __sim7600__dispatch_line(chan, rx_span, avail_len));
+        }
     }
-    return SUCCESS;
 }
 
-/******************************************************************************
+/**
+ * @brief Create the command pool, the per-priority queues and the engine task
+ *
+ * @return int SUCCESS if the engine task is running, otherwise FAILURE
+ */
+int __sim7600__init_engine(void)
+{
+    if(at_cmd_pool_lock == NULL)
+        at_cmd_pool_lock = xSemaphoreCreateMutex();
+    if(at_cmd_pending == NULL)
+        at_cmd_pending = xSemaphoreCreateCounting(AT_CMD_POOL_SIZE, 0);
+    if( (at_cmd_pool_lock == NULL) || (at_cmd_pending == NULL) )
+        return FAILURE;
+    for(uint8_t prio = 0; prio < SIM7600_PRIO_COUNT; prio++)
+    {
+        if(at_cmd_queue[prio] == NULL)
+            at_cmd_queue[prio] = xQueueCreate(AT_CMD_POOL_SIZE, sizeof(sim7600_cmd_t*));
+        if(at_cmd_queue[prio] == NULL)
+            return FAILURE;
+    }
+    for(uint8_t idx = 0; idx < AT_CMD_POOL_SIZE; idx++)
+    {
+        if(at_cmd_pool[idx].done == NULL)
+            at_cmd_pool[idx].done = xSemaphoreCreateBinary();
+        if(at_cmd_pool[idx].done == NULL)
+            return FAILURE;
+    }
+    if( (at_engine_task == NULL) &&
+        (xTaskCreate(__sim7600__engine_task, "lte_at_engine", AT_ENGINE_TASK_STACK_SIZE, NULL, AT_ENGINE_TASK_PRIORITY, &at_engine_task) != pdPASS) )
+        return FAILURE;
+    return SUCCESS;
+}
+
+/**
+ * @brief First use: set up the tokenizers, the lock and result queues, put the modem UART in line mode and start the
+ *        reader and engine tasks of the data channel. Safe to call from several tasks at once.
+ *
+ * @return int SUCCESS if both tasks are running, otherwise FAILURE
+ */
+int __sim7600__init_link(void)
+{
+    uint8_t state = AT_LINK_DOWN;
+    while(!__atomic_compare_exchange_n(&at_link_state, &state, AT_LINK_STARTING, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        if(state == AT_LINK_READY)
+            return SUCCESS;
+        PORT_DELAY_MS(1); // Another task is starting the link
+        state = AT_LINK_DOWN;
+    }
+
+    int ret_val = FAILURE;
+    do
+    {
+        if(at_rx_lock == NULL)
+            at_rx_lock = xSemaphoreCreateMutex();
+        if(at_state_lock == NULL)
+            at_state_lock = xSemaphoreCreateMutex();
+        if(at_trace_lock == NULL)
+            at_trace_lock = xSemaphoreCreateMutex();
+        if(at_pool_sem == NULL)
+            at_pool_sem = xSemaphoreCreateCounting(AT_POOL_BLOCKS, 0);
+        if( (at_rx_lock == NULL) || (at_state_lock == NULL) || (at_trace_lock == NULL) || (at_pool_sem == NULL) )
+            break;
+        uint8_t idx;
+        for(idx = 0; idx < AT_CHAN_COUNT; idx++)
+        {
+            at_chan_t* chan = &at_chan[idx];
+            if(chan->resp_queue == NULL)
+                chan->resp_queue = xQueueCreate(1, sizeof(int));
+            if(chan->link_sem == NULL)
+                chan->link_sem = xSemaphoreCreateBinary();
+            if( (chan->resp_queue == NULL) || (chan->link_sem == NULL) || (at_parser__init(&chan->parser) != SUCCESS) )
+                break;
+            for(uint8_t prefix = 0; prefix < sizeof(at_urc_prefix) / sizeof(at_urc_prefix[0]); prefix++)
+                at_parser__add(&chan->parser, at_urc_prefix[prefix], AT_TOKEN_URC, AT_PARSER_LINE_START);
+            at_parser__reset(&chan->parser);
+        }
+        if(idx != AT_CHAN_COUNT)
+            break;
+        at_line_mode = (hal__UARTLineMode(AT_DEFAULT_UART_PORT, true) == SUCCESS);
+        if( (at_reader_task == NULL) &&
+            (xTaskCreate(__sim7600__reader_task, "lte_at_reader", AT_READER_TASK_STACK_SIZE, &at_chan[AT_CHAN_DATA], AT_READER_TASK_PRIORITY, &at_reader_task) != pdPASS) )
+            break;
+        ret_val = __sim7600__init_engine();
+    } while(0);
+    __atomic_store_n(&at_link_state, (ret_val == SUCCESS) ? AT_LINK_READY : AT_LINK_DOWN, __ATOMIC_RELEASE);
+    return ret_val;
+}
+
+/**
+ * @brief Send a command assembled from several segments (prefix, payload, suffix...) without staging it in a buffer,
+ *        on the channel of the calling engine
+ *
+ * @param iov: Command segments, sent back to back
+ * @param iovcnt: Number of segments
+ * @return int SUCCESS if ok, otherwise FAILURE
+ */
+int __sim7600__send_commandv(const struct iovec* iov, uint8_t iovcnt)
+{
+    param_check(iov != NULL);
+    if(__sim7600__init_link() != SUCCESS)
+        return FAILURE;
+    at_chan_t* chan = __sim7600__chan();
+    __sim7600__trace_begin(iov, iovcnt);
+    if( (iov[0].iov_len >= 8) && (memcmp(iov[0].iov_base, "AT+CFUN=", 8) == 0) )
+        __sim7600__state_cfun_changed(); // Whoever sends it, sim7600__power_on() included
+#if (AT_FLUSH_RX_BEFORE_WRITE != 0)  //Drop the rest of the previous response, URCs with a handler never reach the mailbox
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    __sim7600__chan_flush(chan); // The other channel's response, if one is on its way, stays where it is
+    xSemaphoreGive(at_rx_lock);
+#endif /* End of (AT_FLUSH_RX_BEFORE_WRITE != 0) */
+    if (__sim7600__link_writev(chan, iov, iovcnt) < 0)
+        return FAILURE;
+    return SUCCESS;
+}
+
+int __sim7600__send_command(const char* command)
+{
+    param_check(command != NULL);
+    struct iovec iov[] = { IOV_STR(command) };
+    return __sim7600__send_commandv(iov, IOV_COUNT(iov));
+}
+
+/**
+ * @brief Waits for a response from the LTE modem and checks if it matches the expected response.
+ *        ERROR, +CME ERROR and +CMS ERROR only count at the start of a line, so payload text cannot fail the wait.
+ *        Sleeps on the result queue of the caller's channel, its reader task scans each line as it arrives.
+ *
+ * @param expected_resp The expected response from the LTE module, matched anywhere in a line.
+ * @param timeout_ms The maximum time to wait for the response in milliseconds.
+ * @return int Returns SUCCESS if the expected response is received within the timeout period, otherwise returns FAILURE.
+ */
+
+int __sim7600__wait_4response(const char* expected_resp, uint16_t timeout_ms)
+{
+    int result = AT_TOKEN_NONE;
+    bool waiting;
+    if(at_link_state != AT_LINK_READY)
+        return FAILURE;
+    at_chan_t* chan = __sim7600__chan();
+    uint32_t start_lines = at_rx_lines;
+
+    // The response may already be (partly) in the mailbox, scan that first
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    if(at_parser__expect(&chan->parser, expected_resp) != SUCCESS)
+    {
+        xSemaphoreGive(at_rx_lock);
+        return FAILURE;
+    }
+    result = __sim7600__scan_resp(chan);
+    chan->waiting = waiting = (result == AT_TOKEN_NONE) && !mailbox__is_full(&chan->rx_data);
+    xSemaphoreGive(at_rx_lock);
+
+    if(waiting && (xQueueReceive(chan->resp_queue, &result, pdMS_TO_TICKS(timeout_ms)) != pdTRUE))
+    {
+        xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+        bool posted = !chan->waiting; // The reader finished the wait just as it timed out
+        chan->waiting = false;
+        xSemaphoreGive(at_rx_lock);
+        if(!posted || (xQueueReceive(chan->resp_queue, &result, pdMS_TO_TICKS(AT_READER_IDLE_MS)) != pdTRUE))
+        {
+            __sim7600__trace_result(SIM7600_TRACE_TIMEOUT);
+            // Nothing at all came back, count it towards declaring the link dead
+            if(at_rx_lines == start_lines)
+                __sim7600__link_silent();
+            return FAILURE;
+        }
+    }
+
+    __sim7600__trace_result((result == AT_TOKEN_EXPECTED) ? SIM7600_TRACE_OK : SIM7600_TRACE_ERROR);
+    if(result == AT_TOKEN_EXPECTED)
+        return SUCCESS;
+    if(result == AT_TOKEN_NONE)
+    {
+        // Buffer full without receiving expected_resp
+        SIM7600_PRINTF("__sim7600__wait_4response(), Buffer full without receiving \"%s\", %luB discarded so far\n",
+                        expected_resp, (unsigned long)chan->rx_data.overflow);
+        mailbox_logdata(&chan->rx_data);
+    }
+    return FAILURE; // Error response received
+}
+
+
+/**
+ * @brief Hand over the response up to the end of the line that ended the wait (everything when the wait failed).
+ *        Lines received after it stay in the mailbox for the next wait, e.g. #XHTTPCRSP data right behind #XHTTPCREQ.
+ *
+ * @param resp: Output, not NUL-terminated
+ * @param maxlength: Longer responses are truncated
+ * @return int Number of bytes copied into resp
+ */
+int __sim7600__get_resp(char* resp, uint16_t maxlength)
+{
+    param_check(resp != NULL);
+    if(at_link_state != AT_LINK_READY)
+        return 0;
+    at_chan_t* chan = __sim7600__chan();
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    uint16_t resp_len = mailbox__get_len(&chan->rx_data);
+    int eol = mailbox__find(&chan->rx_data, chan->scan_idx, '\n');
+    if(eol != FAILURE)
+        resp_len = eol + 1;
+    uint16_t cur_len = resp_len;
+    if(cur_len > maxlength)
+    {
+        SIM7600_PRINTF("__sim7600__get_resp(), Buffer overflow, current buffer length: %dB, maxlength: %dB, discarded %dB\n",
+                        cur_len, maxlength, cur_len - maxlength);
+        cur_len = maxlength;
+    }
+    if( resp_len != 0)
+    {
+        mailbox__get_data(&chan->rx_data, resp, cur_len);
+        mailbox__drop(&chan->rx_data, resp_len - cur_len);
+        // In line mode the mailbox only holds whole lines, what is left starts a new one
+        chan->scan_idx = 0;
+        at_parser__reset(&chan->parser);
+    }
+    xSemaphoreGive(at_rx_lock);
+    return cur_len;
+}
+
+/**
+ * @brief Take the response like __sim7600__get_resp() and read the number behind prefix, e.g. "#XHTTPCREQ: 1"
+ *
+ * @param prefix: Text in front of the number, whitespace after it is skipped
+ * @return int SUCCESS if ok, FAILURE if prefix or the number is missing or no pool block came free
+ */
+int __sim7600__get_resp_int(const char* prefix, int* value)
+{
+    char* resp = __sim7600__pool_get();
+    if(resp == NULL)
+        return FAILURE;
+    resp[__sim7600__get_resp(resp, AT_POOL_BLOCK_SIZE - 1)] = '\0';
+    char* found = strstr(resp, prefix);
+    int ret_val = ( (found != NULL) && (sscanf(found + strlen(prefix), "%d", value) == 1) ) ? SUCCESS : FAILURE;
+    if(ret_val != SUCCESS)
+        SIM7600_PRINTF("Invalid response, no \"%s\" value\n", prefix);
+    __sim7600__pool_put(resp);
+    return ret_val;
+}
+
+/**
+ * @brief One command/response exchange: send command, wait for expected, then hand over the response lines
+ *
+ * @param resp: Optional buffer for the response, NUL-terminated. Filled on failure too (error text)
+ * @param resp_len: Number of bytes stored in resp
+ * @return int SUCCESS if expected was received within timeout_ms, otherwise FAILURE
+ */
+int __sim7600__transact(const char* command, const char* expected, uint16_t timeout_ms, char* resp, uint16_t resp_size, int* resp_len)
+{
+    int status = FAILURE;
+    if( (__sim7600__send_command(command) == SUCCESS) && (__sim7600__wait_4response(expected, timeout_ms) == SUCCESS) )
+        status = SUCCESS;
+    *resp_len = 0;
+    if( (resp != NULL) && (resp_size > 0) )
+    {
+        *resp_len = __sim7600__get_resp(resp, resp_size - 1);
+        resp[*resp_len] = '\0';
+    }
+    return status;
+}
+
+sim7600_cmd_t* __sim7600__cmd_alloc(void)
+{
+    sim7600_cmd_t* cmd = NULL;
+    xSemaphoreTake(at_cmd_pool_lock, portMAX_DELAY);
+    for(uint8_t idx = 0; idx < AT_CMD_POOL_SIZE; idx++)
+    {
+        if(!at_cmd_pool[idx].in_use)
+        {
+            cmd = &at_cmd_pool[idx];
+            SemaphoreHandle_t done = cmd->done;
+            memset(cmd, 0, sizeof(*cmd));
+            cmd->done = done;
+            cmd->in_use = true;
+            break;
+        }
+    }
+    xSemaphoreGive(at_cmd_pool_lock);
+    return cmd;
+}
+
+void __sim7600__cmd_free(sim7600_cmd_t* cmd)
+{
+    xSemaphoreTake(at_cmd_pool_lock, portMAX_DELAY);
+    cmd->in_use = false;
+    xSemaphoreGive(at_cmd_pool_lock);
+}
+
+int __sim7600__cmd_queue(sim7600_cmd_t* cmd, uint8_t priority)
+{
+    if(priority >= SIM7600_PRIO_COUNT)
+        priority = SIM7600_PRIO_COUNT - 1;
+    // Status queries go to the control channel while the multiplexer runs, so a transfer cannot hold them up
+    if( at_ctrl_active && (cmd->job == NULL) && (priority == SIM7600_PRIO_HIGH) )
+        return (xQueueSend(at_ctrl_queue, &cmd, 0) == pdTRUE) ? SUCCESS : FAILURE;
+    if(xQueueSend(at_cmd_queue[priority], &cmd, 0) != pdTRUE)
+        return FAILURE; // Cannot happen, every queue holds the whole pool
+    xSemaphoreGive(at_cmd_pending);
+    return SUCCESS;
+}
+
+#if (AT_STACK_PROFILE == 1)
+// Lowest engine stack address the profile looks at: the stack start, or AT_ENGINE_TASK_STACK_SIZE below frame
+// where the port gives tasks a larger stack (host)
+static uint8_t* __sim7600__stack_floor(const uint8_t* frame)
+{
+    uint8_t* start = pxTaskGetStackStart(NULL);
+    if( (start == NULL) || (frame - start <= AT_STACK_PAINT_MARGIN) )
+        return NULL;
+    return (frame - start > AT_ENGINE_TASK_STACK_SIZE) ? (uint8_t*)frame - AT_ENGINE_TASK_STACK_SIZE : start;
+}
+
+/**
+ * @brief Engine task: fill the free stack below the caller's frame with AT_STACK_FILL_BYTE, except the
+ *        AT_STACK_PAINT_MARGIN this call needs itself. Costs a memset of the free stack per command
+ */
+void __sim7600__stack_paint(uint8_t* frame)
+{
+    uint8_t* floor = __sim7600__stack_floor(frame);
+    if(floor != NULL)
+        memset(floor, AT_STACK_FILL_BYTE, frame - floor - AT_STACK_PAINT_MARGIN);
+}
+
+/**
+ * @brief Engine task: find the deepest byte overwritten since __sim7600__stack_paint(frame) and keep the maximum for api
+ */
+void __sim7600__stack_record(const char* api, const uint8_t* frame)
+{
+    const uint8_t* deepest = __sim7600__stack_floor(frame);
+    if( (deepest == NULL) || (api == NULL) )
+        return;
+    while( (deepest < frame - AT_STACK_PAINT_MARGIN) && (*deepest == AT_STACK_FILL_BYTE) )
+        deepest++;
+    uint32_t used = (uint32_t)(frame - deepest);
+
+    xSemaphoreTake(at_trace_lock, portMAX_DELAY);
+    sim7600_stack_usage_t* usage = NULL;
+    for(uint8_t idx = 0; (idx < at_stack_usage_count) && (usage == NULL); idx++)
+    {
+        if(strcmp(at_stack_usage[idx].api, api) == 0)
+            usage = &at_stack_usage[idx];
+    }
+    if( (usage == NULL) && (at_stack_usage_count < AT_STACK_MAX_APIS) )
+    {
+        usage = &at_stack_usage[at_stack_usage_count++];
+        usage->api = api;
+    }
+    if(usage != NULL)
+    {
+        usage->calls++;
+        if(used > usage->max_bytes)
+            usage->max_bytes = used;
+    }
+    xSemaphoreGive(at_trace_lock);
+}
+#endif /* End of (AT_STACK_PROFILE == 1) */
+
+/**
+ * @brief Run one queued command or job on the calling engine task and complete it
+ */
+void __sim7600__run_cmd(sim7600_cmd_t* cmd)
+{
+#if (AT_STACK_PROFILE == 1)
+    uint8_t frame;
+    __sim7600__stack_paint(&frame);
+#endif /* End of (AT_STACK_PROFILE == 1) */
+    if(cmd->job != NULL)
+        cmd->status = cmd->job(cmd->job_arg);
+    else
+        cmd->status = __sim7600__transact(cmd->command, cmd->expected, cmd->timeout_ms, cmd->resp, cmd->resp_size, &cmd->resp_len);
+    __sim7600__trace_end();
+#if (AT_STACK_PROFILE == 1)
+    __sim7600__stack_record((cmd->job != NULL) ? cmd->api : "command", &frame);
+#endif /* End of (AT_STACK_PROFILE == 1) */
+
+    if(cmd->detached)
+        __sim7600__cmd_free(cmd);
+    else if(cmd->cb != NULL)
+    {
+        cmd->cb(cmd, cmd->status, cmd->resp, (uint16_t)cmd->resp_len, cmd->ctx);
+        __sim7600__cmd_free(cmd);
+    }
+    else
+        xSemaphoreGive(cmd->done);
+}
+
+/**
+ * @brief Engine task: the only task that talks to the modem. Runs the oldest command of the highest non-empty
+ *        priority, then the next one right away, so the link never waits for the submitting task to wake up
+ */
+void __sim7600__engine_task(void *pvParameters)
+{
+    (void)pvParameters;
+    while(1)
+    {
+        sim7600_cmd_t* cmd = NULL;
+        xSemaphoreTake(at_cmd_pending, portMAX_DELAY);
+        for(uint8_t prio = 0; (prio < SIM7600_PRIO_COUNT) && (cmd == NULL); prio++)
+        {
+            if(xQueueReceive(at_cmd_queue[prio], &cmd, 0) != pdTRUE)
+                cmd = NULL;
+        }
+        if(cmd != NULL)
+            __sim7600__run_cmd(cmd);
+    }
+}
+
+/**
+ * @brief Control engine task, only while the multiplexer runs: the SIM7600_PRIO_HIGH single commands on their own
+ *        channel, next to whatever the engine task is doing. Commands queued just before the multiplexer closed go
+ *        back to the engine task
+ */
+void __sim7600__ctrl_task(void *pvParameters)
+{
+    (void)pvParameters;
+    while(1)
+    {
+        sim7600_cmd_t* cmd = NULL;
+        if(xQueueReceive(at_ctrl_queue, &cmd, portMAX_DELAY) != pdTRUE)
+            continue;
+        xSemaphoreTake(at_ctrl_busy, portMAX_DELAY);
+        if(at_ctrl_active)
+            __sim7600__run_cmd(cmd);
+        else if( (xQueueSend(at_cmd_queue[SIM7600_PRIO_HIGH], &cmd, 0) == pdTRUE) )
+            xSemaphoreGive(at_cmd_pending);
+        xSemaphoreGive(at_ctrl_busy);
+    }
+}
+
+/**
+ * @brief Run job(arg) on the engine task between two queued commands and wait for it. Used by the public functions
+ *        that need several exchanges in a row without another task's command in between
+ *
+ * @param api: Name of the public function, its stack use is reported under it
+ * @return int What job returned, FAILURE if it could not be queued
+ */
+int __sim7600__run_job(const char* api, at_job_fn_t job, void* arg, uint8_t priority)
+{
+    if( (at_engine_task != NULL) && (xTaskGetCurrentTaskHandle() == at_engine_task) )
+        return job(arg); // Already on the engine, e.g. sim7600__power_on() from sim7600__setCA()
+    if(__sim7600__init_link() != SUCCESS)
+        return FAILURE;
+    sim7600_cmd_t* cmd = __sim7600__cmd_alloc();
+    if(cmd == NULL)
+        return FAILURE;
+    cmd->job = job;
+    cmd->job_arg = arg;
+    cmd->api = api;
+    if(__sim7600__cmd_queue(cmd, priority) != SUCCESS)
+    {
+        __sim7600__cmd_free(cmd);
+        return FAILURE;
+    }
+    xSemaphoreTake(cmd->done, portMAX_DELAY); // Jobs end on their own command timeouts
+    int status = cmd->status;
+    __sim7600__cmd_free(cmd);
+    return status;
+}
+
+/**
+ * @brief Queue job(arg) on the engine task and return at once, e.g. from the reader task that must not block.
+ *        arg must stay valid until the job ran
+ *
+ * @return int SUCCESS if queued, FAILURE if all AT_CMD_POOL_SIZE slots are busy
+ */
+int __sim7600__post_job(const char* api, at_job_fn_t job, void* arg, uint8_t priority)
+{
+    sim7600_cmd_t* cmd = __sim7600__cmd_alloc();
+    if(cmd == NULL)
+        return FAILURE;
+    cmd->job = job;
+    cmd->job_arg = arg;
+    cmd->api = api;
+    cmd->detached = true;
+    if(__sim7600__cmd_queue(cmd, priority) != SUCCESS)
+    {
+        __sim7600__cmd_free(cmd);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Blocking single command through the engine queue
+ *
+ * @return int Response length if expected was received, otherwise FAILURE
+ */
+int __sim7600__exec(const char* command, const char* expected, uint16_t timeout_ms, uint8_t priority, char* resp, uint16_t resp_size)
+{
+    if( (at_engine_task != NULL) && (xTaskGetCurrentTaskHandle() == at_engine_task) )
+    {
+        int resp_len;
+        if(__sim7600__transact(command, expected, timeout_ms, resp, resp_size, &resp_len) != SUCCESS)
+            return FAILURE;
+        return resp_len;
+    }
+    sim7600_cmd_req_t req = { .command = command, .expected = expected, .timeout_ms = timeout_ms, .priority = priority,
+                              .resp = resp, .resp_size = resp_size };
+    sim7600_cmd_t* cmd = sim7600__cmd_submit(&req);
+    if(cmd == NULL)
+        return FAILURE;
+    return sim7600__cmd_wait(cmd, SIM7600_WAIT_FOREVER);
+}
+
+/**
+ * @brief Check that the modem answers a bare "AT" at the current host rate
+ *
+ * @return int SUCCESS if the modem replied "OK", otherwise FAILURE
+ */
+int __sim7600__probe_link(void)
+{
+    for(uint8_t retry = 0; retry < AT_BAUD_PROBE_RETRY; retry++)
+    {
+        if (__sim7600__send_command("AT\r\n") != SUCCESS)
+            return FAILURE; // Failed to send command
+        if (__sim7600__wait_4response("OK", AT_BAUD_PROBE_TIMEOUT_MS) == SUCCESS)
+            return SUCCESS;
+    }
+    return FAILURE;
+}
+
+/**
+ * @brief Implements [AT+IPR=<baudrate>], then moves the host UART to the new rate and probes the link
+ *
+ * @param baudrate: The new baud rate
+ * @param flow: HAL_UART_FLOW_NONE or HAL_UART_FLOW_RTS_CTS
+ * @return int SUCCESS if the modem answers at the new rate, otherwise FAILURE
+ */
+int __sim7600__switch_baudrate(uint32_t baudrate, uint8_t flow)
+{
+    char at_send_buffer[32] = {0};
+    snprintf(at_send_buffer, sizeof(at_send_buffer), "AT+IPR=%lu\r\n", (unsigned long)baudrate);
+    if (__sim7600__send_command(at_send_buffer) != SUCCESS)
+        return FAILURE; // Failed to send command
+
+    // "OK" still comes back at the old rate, the modem switches right after it
+    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
+        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+
+    if (hal__UARTConfigure(AT_DEFAULT_UART_PORT, baudrate, flow) != SUCCESS)
+        return FAILURE;
+    at_cur_baudrate = baudrate;
+    at_cur_flow = flow;
+
+    return __sim7600__probe_link();
+}
+
+/**
+ * @brief Find the rate the modem is answering at and bring both sides back to AT_DEFAULT_BAUDRATE
+ *
+ * @return int SUCCESS if the link answers at AT_DEFAULT_BAUDRATE, otherwise FAILURE
+ */
+int __sim7600__recover_baudrate(void)
+{
+    int ret_val = FAILURE;
+    bool was_switching = at_baud_switching;
+    at_baud_switching = true;
+    // Default rate first: covers a modem reset as well as a switch that never took effect
+    for(uint8_t idx = 0; idx < sizeof(at_baudrate_list) / sizeof(at_baudrate_list[0]); idx++)
+    {
+        if (hal__UARTConfigure(AT_DEFAULT_UART_PORT, at_baudrate_list[idx], at_cur_flow) != SUCCESS)
+            break;
+        at_cur_baudrate = at_baudrate_list[idx];
+        if (__sim7600__probe_link() != SUCCESS)
+            continue;
+
+        if (at_cur_baudrate == AT_DEFAULT_BAUDRATE)
+            ret_val = SUCCESS;
+        else
+            ret_val = __sim7600__switch_baudrate(AT_DEFAULT_BAUDRATE, at_cur_flow);
+        break;
+    }
+    SIM7600_PRINTF("__sim7600__recover_baudrate(), link %s at %lu baud\n", (ret_val == SUCCESS) ? "restored" : "lost", (unsigned long)at_cur_baudrate);
+    at_baud_switching = was_switching;
+    return ret_val;
+}
+
+/**
+ * @brief Called when a wait times out without a single byte received. After AT_LINK_LOST_THRESHOLD
+ *        consecutive silent timeouts above the default rate, fall back to AT_DEFAULT_BAUDRATE
+ */
+void __sim7600__link_silent(void)
+{
+    if(at_baud_switching || at_cmux_active || (at_cur_baudrate == AT_DEFAULT_BAUDRATE))
+        return; // A silent channel says nothing about the rate while the multiplexer runs
+    if(++at_silent_timeouts < AT_LINK_LOST_THRESHOLD)
+        return;
+    at_silent_timeouts = 0;
+    SIM7600_PRINTF("Modem stopped answering at %lu baud, falling back to %lu\n", (unsigned long)at_cur_baudrate, AT_DEFAULT_BAUDRATE);
+    __sim7600__recover_baudrate();
+}
+
+int __sim7600__clearCert()
+{
+    if (__sim7600__send_command("AT+CFUN=4\r\n") != SUCCESS)
+        return FAILURE; // Failed to send command
+
+    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
+        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+
+    // Check (list) to see if cert exists
+    if (__sim7600__send_command("AT%CMNG=1,12354,0\r\n") != SUCCESS)
+        return FAILURE; // Failed to send command
+
+    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
+        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+
+    char* resp = __sim7600__pool_get();
+    if(resp == NULL)
+        return FAILURE;
+    resp[__sim7600__get_resp(resp, AT_POOL_BLOCK_SIZE - 1)] = '\0';
+    char* cert_str = strstr(resp, "%CMNG: 12354, 0");
+    __sim7600__pool_put(resp);
+    if(cert_str == NULL)
+        return SUCCESS; // Cert does not exist, return success
+    else
+    {
+        if (__sim7600__send_command("AT%CMNG=3,12354,0\r\n") != SUCCESS)
+            return FAILURE; // Failed to send command
+
+        if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
+            return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+    }
+    return SUCCESS;
+}
+
+/******************************************************************************
 * Function Definitions
 *******************************************************************************/
 /*
- *  Implements [AT+CFUN=1] (Enables LTE modem.)
- *  Waits for "OK" response. Returns SUCCESS if ok. Returns FAILURE if error.
+ * Routes every line starting with prefix (e.g. "+CEREG:") to cb on the modem reader task instead of the response
+ * mailbox, whether or not a command is pending. prefix is not copied. Lines matching no handler, including
+ * #XHTTPCRSP data, still go to the response of the pending command.
+ * Returns SUCCESS if ok. Returns FAILURE if the handler table is full or the reader task cannot start.
+ */
+int sim7600__register_urc(const char* prefix, sim7600_urc_cb_t cb, void* ctx)
+{
+    param_check(prefix != NULL);
+    param_check(cb != NULL);
+    size_t len = strlen(prefix);
+    param_check( (len > 0) && (len < AT_URC_LINE_SIZE) );
+    if(__sim7600__init_link() != SUCCESS)
+        return FAILURE;
+
+    int ret_val = FAILURE;
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    if(at_urc_handler_count < AT_URC_MAX_HANDLERS)
+    {
+        at_urc_handler[at_urc_handler_count++] = (at_urc_handler_t){ .prefix = prefix, .len = (uint16_t)len, .cb = cb, .ctx = ctx };
+        ret_val = SUCCESS;
+    }
+    xSemaphoreGive(at_rx_lock);
+    return ret_val;
+}
+
+/*
+ * Sets how long a cached field stays valid (0: always ask the modem). The state cache answers sim7600__power_off(),
+ * sim7600__connected(), sim7600__get_rssi() and sim7600__get_SimPresent() without a round trip while fresh.
+ * Returns SUCCESS if ok. Returns FAILURE if field is out of range.
+ */
+int sim7600__set_state_ttl(sim7600_state_t field, uint32_t ttl_ms)
+{
+    param_check(field < SIM7600_STATE_COUNT);
+    at_state_ttl_ms[field] = ttl_ms;
+    return SUCCESS;
+}
+
+/*
+ * Copies the counters of the idx-th command verb, in the order the verbs were first sent. Reading them costs no
+ * modem traffic, recording them costs a clock read and a table update per command.
+ * Returns SUCCESS if ok. Returns FAILURE if idx is past the last verb seen.
+ */
+int sim7600__get_trace(uint8_t idx, sim7600_trace_t* trace)
+{
+    param_check(trace != NULL);
+    if(at_trace_lock == NULL)
+        return FAILURE; // Nothing sent yet
+    int ret_val = FAILURE;
+    xSemaphoreTake(at_trace_lock, portMAX_DELAY);
+    if(idx < at_trace_count)
+    {
+        *trace = at_trace[idx];
+        ret_val = SUCCESS;
+    }
+    xSemaphoreGive(at_trace_lock);
+    return ret_val;
+}
+
+void sim7600__reset_trace(void)
+{
+    if(at_trace_lock == NULL)
+        return;
+    xSemaphoreTake(at_trace_lock, portMAX_DELAY);
+    memset(at_trace, 0, sizeof(at_trace));
+    at_trace_count = 0;
+    xSemaphoreGive(at_trace_lock);
+}
+
+/*
+ * Prints one line per command verb: transactions, outcomes, time to first byte and to the final result (average,
+ * 50th and 90th percentile as bucket upper bounds, maximum) and bytes moved. Then the final result histogram of each verb.
+ */
+void sim7600__dump_trace(void)
+{
+    sim7600_trace_t trace;
+    printf("%-15s %6s %5s %5s %5s %9s %9s %9s %9s %9s %9s %9s %9s\n", "verb", "count", "ok", "err", "tmo",
+           "first avg", "p50", "p90", "final avg", "p50", "p90", "max[us]", "out/in[B]");
+    for(uint8_t idx = 0; sim7600__get_trace(idx, &trace) == SUCCESS; idx++)
+    {
+        uint32_t first_count = 0;
+        for(uint8_t bucket = 0; bucket < SIM7600_TRACE_BUCKETS; bucket++)
+            first_count += trace.first_hist[bucket];
+        printf("%-15s %6lu %5lu %5lu %5lu %9lu %9lu %9lu %9lu %9lu %9lu %9lu %llu/%llu\n", trace.verb, (unsigned long)trace.count,
+               (unsigned long)trace.outcome[SIM7600_TRACE_OK], (unsigned long)trace.outcome[SIM7600_TRACE_ERROR],
+               (unsigned long)trace.outcome[SIM7600_TRACE_TIMEOUT],
+               (unsigned long)((first_count != 0) ? trace.first_total_us / first_count : 0),
+               (unsigned long)__sim7600__trace_pct(trace.first_hist, 50), (unsigned long)__sim7600__trace_pct(trace.first_hist, 90),
+               (unsigned long)((trace.count != 0) ? trace.final_total_us / trace.count : 0),
+               (unsigned long)__sim7600__trace_pct(trace.final_hist, 50), (unsigned long)__sim7600__trace_pct(trace.final_hist, 90),
+               (unsigned long)trace.final_max_us, (unsigned long long)trace.bytes_out, (unsigned long long)trace.bytes_in);
+    }
+    for(uint8_t idx = 0; sim7600__get_trace(idx, &trace) == SUCCESS; idx++)
+    {
+        printf("%-15s", trace.verb);
+        for(uint8_t bucket = 0; bucket < SIM7600_TRACE_BUCKETS; bucket++)
+        {
+            if(trace.final_hist[bucket] != 0)
+                printf(" >=%luus:%lu", (unsigned long)SIM7600_TRACE_BUCKET_US(bucket), (unsigned long)trace.final_hist[bucket]);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * Copies the deepest engine task stack use measured for the idx-th public function, in the order they first ran.
+ * The engine repaints its free stack before every command, so each function is measured on its own.
+ * Returns SUCCESS if ok. Returns FAILURE if idx is past the last function or AT_STACK_PROFILE is 0.
+ */
+int sim7600__get_stack_usage(uint8_t idx, sim7600_stack_usage_t* usage)
+{
+    param_check(usage != NULL);
+    int ret_val = FAILURE;
+#if (AT_STACK_PROFILE == 1)
+    if(at_trace_lock == NULL)
+        return FAILURE; // Nothing run yet
+    xSemaphoreTake(at_trace_lock, portMAX_DELAY);
+    if(idx < at_stack_usage_count)
+    {
+        *usage = at_stack_usage[idx];
+        ret_val = SUCCESS;
+    }
+    xSemaphoreGive(at_trace_lock);
+#endif /* End of (AT_STACK_PROFILE == 1) */
+    return ret_val;
+}
+
+/*
+ * Prints the engine stack use per public function against AT_ENGINE_TASK_STACK_SIZE, and how many pool blocks
+ * were lent out at once. Callers of the public functions only need their own frames, no response buffers.
+ */
+void sim7600__dump_stack_usage(void)
+{
+    sim7600_stack_usage_t usage;
+    uint32_t deepest = 0;
+    printf("%-28s %8s %10s\n", "engine stack", "calls", "max[B]");
+    for(uint8_t idx = 0; sim7600__get_stack_usage(idx, &usage) == SUCCESS; idx++)
+    {
+        printf("%-28s %8lu %10lu\n", usage.api, (unsigned long)usage.calls, (unsigned long)usage.max_bytes);
+        deepest = MAX(deepest, usage.max_bytes);
+    }
+#if (AT_STACK_PROFILE == 1)
+    // The engine repaints its stack before every command, so the FreeRTOS high-water mark only covers the last one
+    uint32_t never_used = (deepest < AT_ENGINE_TASK_STACK_SIZE) ? AT_ENGINE_TASK_STACK_SIZE - deepest : 0;
+#else
+    uint32_t never_used = (at_engine_task != NULL) ? uxTaskGetStackHighWaterMark(at_engine_task) : 0;
+#endif /* End of (AT_STACK_PROFILE == 1) */
+    printf("Engine task: %uB stack, %luB never used. Buffer pool: %u x %uB, peak %lu in use\n", AT_ENGINE_TASK_STACK_SIZE,
+           (unsigned long)never_used, AT_POOL_BLOCKS, (unsigned)AT_POOL_BLOCK_SIZE,
+           (unsigned long)__atomic_load_n(&at_pool_peak, __ATOMIC_RELAXED));
+}
+
+/*
+ *  Implements [AT+CFUN=1] (Enables LTE modem.)
+ *  Waits for "OK" response. Returns SUCCESS if ok. Returns FAILURE if error.
+ */
+int sim7600__power_on(void)
+{
+    if (__sim7600__exec("AT+CFUN=1\r\n", "OK", AT_DEFAULT_TIMEOUT_MS, SIM7600_PRIO_NORMAL, NULL, 0) < 0)
+        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+    __sim7600__state_set(SIM7600_STATE_CFUN, 1);
+    return SUCCESS;
+} 
+
+/*
+ * Implements [AT+IFC=2,2] (RTS/CTS) if hw_flowctrl is set, then [AT+IPR=<rate>] with the highest supported rate
+ * not above max_baudrate that the link answers at. Falls back to the next lower rate when a switch is not answered.
+ * Returns SUCCESS if ok (the link may stay at AT_DEFAULT_BAUDRATE). Returns FAILURE if the modem does not answer at all.
+ */
+int __sim7600__negotiate_baudrate(uint32_t max_baudrate, bool hw_flowctrl)
+{
+    if(at_cmux_active)
+    {
+        SIM7600_PRINTF("Baud rate is fixed while the multiplexer runs, call sim7600__cmux_stop() first\n");
+        return FAILURE;
+    }
+    int ret_val = FAILURE;
+    at_baud_switching = true;
+    do
+    {
+        if (__sim7600__probe_link() != SUCCESS)
+            break; // Modem must answer at the current rate first
+
+        uint8_t flow = HAL_UART_FLOW_NONE;
+        if (hw_flowctrl)
+        {
+            if ( (__sim7600__send_command("AT+IFC=2,2\r\n") == SUCCESS) &&
+                 (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) == SUCCESS) &&
+                 (hal__UARTConfigure(AT_DEFAULT_UART_PORT, at_cur_baudrate, HAL_UART_FLOW_RTS_CTS) == SUCCESS) &&
+                 (__sim7600__probe_link() == SUCCESS) )
+            {
+                flow = HAL_UART_FLOW_RTS_CTS;
+            }
+            else
+            {
+                // RTS/CTS not wired or not accepted, keep going without it
+                hal__UARTConfigure(AT_DEFAULT_UART_PORT, at_cur_baudrate, HAL_UART_FLOW_NONE);
+                __sim7600__send_command("AT+IFC=0,0\r\n");
+                __sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS);
+            }
+        }
+        at_cur_flow = flow;
+        ret_val = SUCCESS;
+
+        // Highest rate first, stop at the first one the link answers at
+        for(int8_t idx = sizeof(at_baudrate_list) / sizeof(at_baudrate_list[0]) - 1; idx >= 0; idx--)
+        {
+            uint32_t baudrate = at_baudrate_list[idx];
+            if ( (baudrate > max_baudrate) || (baudrate == at_cur_baudrate) )
+                continue;
+            if ( baudrate < at_cur_baudrate )
+                break; // Already running faster
+            if (__sim7600__switch_baudrate(baudrate, flow) == SUCCESS)
+                break;
+            SIM7600_PRINTF("No answer at %lu baud, falling back\n", (unsigned long)baudrate);
+            if (__sim7600__recover_baudrate() != SUCCESS)
+            {
+                ret_val = FAILURE;
+                break;
+            }
+        }
+    } while(0);
+    at_baud_switching = false;
+    SIM7600_PRINTF("Modem link: %lu baud, flow control %s\n", (unsigned long)at_cur_baudrate, (at_cur_flow == HAL_UART_FLOW_RTS_CTS) ? "RTS/CTS" : "off");
+    return ret_val;
+}
+
+int __sim7600__negotiate_baudrate_job(void* arg)
+{
+    at_baudrate_args_t* args = (at_baudrate_args_t*)arg;
+    return __sim7600__negotiate_baudrate(args->max_baudrate, args->hw_flowctrl);
+}
+
+// The rate change must not be interleaved with other commands: runs as one engine job
+int sim7600__negotiate_baudrate(uint32_t max_baudrate, bool hw_flowctrl)
+{
+    at_baudrate_args_t args = { .max_baudrate = max_baudrate, .hw_flowctrl = hw_flowctrl };
+    return __sim7600__run_job(__func__, __sim7600__negotiate_baudrate_job, &args, SIM7600_PRIO_NORMAL);
+}
+
+// Start the control channel reader and engine tasks on first use, they idle while the multiplexer is closed
+static int __sim7600__ctrl_init(void)
+{
+    if(at_ctrl_queue == NULL)
+        at_ctrl_queue = xQueueCreate(AT_CMD_POOL_SIZE, sizeof(sim7600_cmd_t*));
+    if(at_ctrl_busy == NULL)
+        at_ctrl_busy = xSemaphoreCreateMutex();
+    if( (at_ctrl_queue == NULL) || (at_ctrl_busy == NULL) )
+        return FAILURE;
+    if( (at_ctrl_reader_task == NULL) &&
+        (xTaskCreate(__sim7600__reader_task, "lte_at_ctrl_rd", AT_READER_TASK_STACK_SIZE, &at_chan[AT_CHAN_CONTROL], AT_READER_TASK_PRIORITY, &at_ctrl_reader_task) != pdPASS) )
+        return FAILURE;
+    if( (at_ctrl_task == NULL) &&
+        (xTaskCreate(__sim7600__ctrl_task, "lte_at_ctrl", AT_CTRL_TASK_STACK_SIZE, NULL, AT_CTRL_TASK_PRIORITY, &at_ctrl_task) != pdPASS) )
+        return FAILURE;
+    return SUCCESS;
+}
+
+// Drop whatever both channels hold and wake their readers, the link under them just changed
+static void __sim7600__chan_reset_all(void)
+{
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    for(uint8_t idx = 0; idx < AT_CHAN_COUNT; idx++)
+    {
+        __sim7600__chan_flush(&at_chan[idx]);
+        at_chan[idx].stream_remaining = 0;
+    }
+    xSemaphoreGive(at_rx_lock);
+    for(uint8_t idx = 0; idx < AT_CHAN_COUNT; idx++)
+        xSemaphoreGive(at_chan[idx].link_sem);
+}
+
+/*
+ * Implements [AT+CMUX=0], then opens AT_CMUX_DLCI_DATA and AT_CMUX_DLCI_CONTROL. URCs are handled on whichever
+ * channel they arrive. Returns SUCCESS if ok. Returns FAILURE if error, the link is left in plain AT mode.
+ */
+int __sim7600__cmux_start_job(void* arg)
+{
+    (void)arg;
+    if(at_cmux_active)
+        return SUCCESS;
+    if( (__sim7600__ctrl_init() != SUCCESS) ||
+        (__sim7600__send_command(AT_CMUX_CMD) != SUCCESS) || (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS) )
+        return FAILURE;
+
+    int ret_val = FAILURE;
+    at_cmux_active = true; // From here on the readers wait on their DLCI
+    do
+    {
+        if(cmux__start(AT_DEFAULT_UART_PORT) != SUCCESS)
+            break;
+        if( (cmux__open(AT_CMUX_DLCI_DATA) != SUCCESS) || (cmux__open(AT_CMUX_DLCI_CONTROL) != SUCCESS) )
+        {
+            cmux__stop();
+            break;
+        }
+        ret_val = SUCCESS;
+    } while(0);
+    if(ret_val != SUCCESS)
+    {
+        at_cmux_active = false;
+        at_line_mode = (hal__UARTLineMode(AT_DEFAULT_UART_PORT, true) == SUCCESS);
+        __sim7600__chan_reset_all();
+        SIM7600_PRINTF("Modem did not open the multiplexer channels, staying in plain AT mode\n");
+        return FAILURE;
+    }
+    __sim7600__chan_reset_all();
+    at_ctrl_active = true;
+    SIM7600_PRINTF("Modem link: multiplexed, DLCI %u data, DLCI %u control\n", AT_CMUX_DLCI_DATA, AT_CMUX_DLCI_CONTROL);
+    return SUCCESS;
+}
+
+/*
+ * Closes the multiplexer once the control engine finished its command, then checks the plain AT link.
+ * Returns SUCCESS if ok. Returns FAILURE if error.
+ */
+int __sim7600__cmux_stop_job(void* arg)
+{
+    (void)arg;
+    if(!at_cmux_active)
+        return SUCCESS;
+    at_ctrl_active = false; // New status queries queue for this engine again
+    xSemaphoreTake(at_ctrl_busy, portMAX_DELAY);
+    xSemaphoreGive(at_ctrl_busy);
+    int ret_val = cmux__stop();
+    at_cmux_active = false;
+    at_line_mode = (hal__UARTLineMode(AT_DEFAULT_UART_PORT, true) == SUCCESS);
+    __sim7600__chan_reset_all();
+    if(__sim7600__probe_link() != SUCCESS)
+        ret_val = FAILURE;
+    SIM7600_PRINTF("Modem link: plain AT\n");
+    return ret_val;
+}
+
+// Both run as engine jobs: nothing else is sent on the data channel while the link changes under it
+int sim7600__cmux_start(void)
+{
+    return __sim7600__run_job(__func__, __sim7600__cmux_start_job, NULL, SIM7600_PRIO_NORMAL);
+}
+
+int sim7600__cmux_stop(void)
+{
+    return __sim7600__run_job(__func__, __sim7600__cmux_stop_job, NULL, SIM7600_PRIO_NORMAL);
+}
+
+/*
+ * Implements [AT+CFUN=0] (Disables LTE modem.)
+ * Waits for "OK" response. Returns SUCCESS if ok. Returns FAILURE if error.
+ */
+int sim7600__power_off(void)
+{
+    // CFUN=0 causes writing to NVM. When using CFUN=0, take NVM wear into account
+    //  => Ready curent mode first to avoid unnecessary NVM writes  
+    // Check the current functional mode, if already in power off mode, return SUCCESS. Otherwise force to power off
+    long cached_mode;
+    if(__sim7600__state_get(SIM7600_STATE_CFUN, &cached_mode) && (cached_mode == 0))
+        return SUCCESS; // Known to be off, no need to ask
+    char* resp = __sim7600__pool_get();
+    if(resp == NULL)
+        return FAILURE;
+    int cur_func_mode = -1;
+    do
+    {
+        if (__sim7600__exec("AT+CFUN?\r\n", "OK", AT_DEFAULT_TIMEOUT_MS, SIM7600_PRIO_NORMAL, resp, AT_POOL_BLOCK_SIZE) < 0)
+            break;
+
+        char* cur_func_mode_str = strstr(resp, "+CFUN: ");
+        if(cur_func_mode_str == NULL)
+            break;
+
+        //Get first token to extract current functional mode
+        cur_func_mode_str = strtok(cur_func_mode_str, "\n");
+        if(cur_func_mode_str == NULL)
+            break; // Invalid response 
+        if(sscanf(cur_func_mode_str, "+CFUN: %d ", &cur_func_mode) != 1)
+            break; // Invalid response
+        __sim7600__state_set(SIM7600_STATE_CFUN, cur_func_mode);
+    }while(0);
+    __sim7600__pool_put(resp);
+    if(cur_func_mode == 0)
+        return SUCCESS; // Already in power off mode
+
+    if (__sim7600__exec("AT+CFUN=0\r\n", "OK", AT_DEFAULT_TIMEOUT_MS, SIM7600_PRIO_NORMAL, NULL, 0) < 0)
+        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+    at_https_session.connected = false; // Radio off, the modem dropped the HTTPS connection
+    __sim7600__state_set(SIM7600_STATE_CFUN, 0);
+    return SUCCESS;
+}
+
+/*
+ * Implements [AT+CESQ] (Signal Quality Report), Waits for Response, Returns RSSI value in dBm.
+ * https://infocenter.nordicsemi.com/topic/ref_at_commands/REF/at_commands/mob_termination_ctrl_status/cesq_set.html 
+ * Example:
+ * "AT+CESQ"
+ * "+CESQ: 99,99,255,255,31,62 <CR><LF> OK"
+ */
+int sim7600__get_rssi(void)
+{
+    long cached_rssi;
+    if(__sim7600__state_get(SIM7600_STATE_RSSI, &cached_rssi))
+        return cached_rssi;
+
+    char* resp = __sim7600__pool_get();
+    if(resp == NULL)
+        return FAILURE;
+    int rssi = FAILURE;
+    do
+    {
+        if (__sim7600__exec("AT+CESQ\r\n", "OK", AT_DEFAULT_TIMEOUT_MS, SIM7600_PRIO_HIGH, resp, AT_POOL_BLOCK_SIZE) < 0)
+            break; // Failed to receive resp (no "OK" received within timeout")
+
+        char* cesq_response_str = strstr(resp, "+CESQ: ");
+        if(cesq_response_str == NULL)
+            break; // Invalid response
+
+        //Get first token to extract RSSI
+        cesq_response_str = strtok(cesq_response_str, "\n");
+        if(cesq_response_str == NULL)
+            break; // Invalid response
+
+        rssi = __sim7600__cal_rssi_from_cesq(cesq_response_str);
+        if(rssi != FAILURE)
+            __sim7600__state_set(SIM7600_STATE_RSSI, rssi);
+    } while(0);
+    __sim7600__pool_put(resp);
+    return rssi;
+}
+
+/*
+ * Implements [AT+COPS?] 
+ * Expected Response: +COPS: (<status>,"long","short","numeric",<AcT>) // AcT - Access Technology
+ * returns 1 if connected, 0 if not connected, -1 if error 
+ * //https://infocenter.nordicsemi.com/topic/ref_at_commands/REF/at_commands/nw_service/cops_read.html
+ */
+int sim7600__connected(void)
+{
+    long cached_reg;
+    if(__sim7600__state_get(SIM7600_STATE_REG, &cached_reg))
+        return cached_reg;
+
+    char* resp = __sim7600__pool_get();
+    if(resp == NULL)
+        return FAILURE;
+    int connected = FAILURE;
+    do
+    {
+        if (__sim7600__exec("AT+COPS?\r\n", "OK", AT_DEFAULT_TIMEOUT_MS, SIM7600_PRIO_HIGH, resp, AT_POOL_BLOCK_SIZE) < 0)
+            break; // Failed to receive resp (no "OK" received within timeout")
+
+        char* cops_response_str = strstr(resp, "ERROR");
+        if(cops_response_str != NULL)
+            break; // Invalid response
+
+        cops_response_str = strstr(resp, "+COPS: ");
+        if(cops_response_str == NULL)
+            break; // Invalid response
+
+        int network_status;
+        if (sscanf(cops_response_str, "+COPS: %d", &network_status) != 1)
+            break;
+
+        connected = (network_status == 2) ? 1 : 0;
+        __sim7600__state_set(SIM7600_STATE_REG, connected);
+    } while(0);
+    __sim7600__pool_put(resp);
+    return connected;
+}
+
+/*
+ * Send +CPIN=? 
+ * returns 1 if SIM is present (Resp == "READY"), 0 if not present (???), -1 if error
+ */
+int sim7600__get_SimPresent(void)
+{
+    long cached_sim;
+    if(__sim7600__state_get(SIM7600_STATE_SIM, &cached_sim))
+        return cached_sim;
+
+    // Wait for the final "OK": with the reader task, a trailing "OK" would otherwise end the next command's wait
+    char* resp = __sim7600__pool_get();
+    if(resp == NULL)
+        return FAILURE;
+    int ret_val = FAILURE; // No answer, SIM missing or locked
+    if( (__sim7600__exec("AT+CPIN?\r\n", "OK", AT_DEFAULT_TIMEOUT_MS, SIM7600_PRIO_HIGH, resp, AT_POOL_BLOCK_SIZE) >= 0) &&
+        (strstr(resp, "+CPIN: READY") != NULL) )
+    {
+        __sim7600__state_set(SIM7600_STATE_SIM, 1);
+        ret_val = 1;
+    }
+    __sim7600__pool_put(resp);
+    return ret_val;
+}
+
+/*
+ * Implements [AT#CARRIER="time","read"] to get time returns seconds since UTC time 0. 
+ * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/CARRIER_AT_commands.html#lwm2m-carrier-library-xcarrier
  */
-int sim7600__power_on(void)
+long sim7600__get_time(void)
 {
-    if (__sim7600__send_command("AT+CFUN=1\r\n") != SUCCESS)
-        return FAILURE; // Failed to send command
+    char* resp = __sim7600__pool_get();
+    if(resp == NULL)
+        return FAILURE;
+    long unix_timestamp = FAILURE;
+    if (__sim7600__exec("AT#XCARRIER=\"time\"\r\n", "OK", AT_DEFAULT_TIMEOUT_MS, SIM7600_PRIO_HIGH, resp, AT_POOL_BLOCK_SIZE) >= 0)
+    {
+        // Parse response given example: #XCARRIER: UTC_TIME: 2022-12-30T14:56:46Z, UTC_OFFSET: 60, TIMEZONE: Europe/Paris
+        char* utc_date_time_str = strstr(resp, "UTC_TIME: ");
+        if(utc_date_time_str != NULL)
+            unix_timestamp = __sim7600__get_unix_timestamp(utc_date_time_str); // FAILURE if invalid
+    }
+    __sim7600__pool_put(resp);
+    return unix_timestamp;
+}
+
+/*
+ * calls "__sim7600__clearCert()" to clear the certificate, if it exists.
+ * Then, Implements [AT%CMNG=0,12354,0,\"<ca>\"] to set CA certificate,
+ *  where <ca> represents the contents of ca, with the null terminator removed.
+ *  Then, enables the modem using "sim7600__power_on()" Returns 0 if ok. Returns -1 if error.
+ * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/Generic_AT_commands.html#native-tls-cmng-xcmng
+ */
+int __sim7600__setCA(void* arg)
+{
+    char* ca = (char*)arg;
+    if (__sim7600__clearCert() != SUCCESS)
+        return FAILURE; // Failed to clear certificate 
 
+    // Stream the certificate straight from the caller, it is far larger than any command buffer
+    struct iovec at_cmd[] = { IOV_STR("AT%CMNG=0,12354,0,"), IOV_STR(ca), IOV_STR("\r\n") };
+    if (__sim7600__send_commandv(at_cmd, IOV_COUNT(at_cmd)) != SUCCESS)
+        return FAILURE; // Failed to send command
+        
     if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
         return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-
+    if ( sim7600__power_on() != SUCCESS)
+        return FAILURE; // Failed to power on
     return SUCCESS;
-} 
+}
 
-/*
- * Implements [AT+CFUN=0] (Disables LTE modem.)
- * Waits for "OK" response. Returns SUCCESS if ok. Returns FAILURE if error.
+int sim7600__setCA(char* ca)
+{
+    return __sim7600__run_job(__func__, __sim7600__setCA, ca, SIM7600_PRIO_NORMAL);
+}
+
+/**
+ * @brief Open the response stream before the request goes out, so no #XHTTPCRSP payload can slip into the mailbox
+ *
+ * @param on_chunk: Gets each payload piece on the reader task, returns SUCCESS to keep going
  */
-int sim7600__power_off(void)
+void __sim7600__stream_begin(sim7600_http_chunk_cb_t on_chunk, void* ctx)
 {
-    // CFUN=0 causes writing to NVM. When using CFUN=0, take NVM wear into account
-    //  => Ready curent mode first to avoid unnecessary NVM writes  
-    // Check the current functional mode, if already in power off mode, return SUCCESS. Otherwise force to power off
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    at_stream_cb = on_chunk;
+    at_stream_ctx = ctx;
+    at_stream_abort = false;
+    at_stream_bytes = 0;
+    xSemaphoreGive(at_rx_lock);
+}
+
+/**
+ * @brief Wait for the final "#XHTTPCRSP:0,1" and close the stream. The timeout restarts whenever payload arrives,
+ *        so a long download only fails if it stalls for AT_HTTP_RESPONSE_TIMEOUT_MS
+ *
+ * @return int SUCCESS if the whole response was delivered, FAILURE on timeout, error or if the callback refused a chunk
+ */
+int __sim7600__stream_wait(void)
+{
+    int ret_val;
+    uint32_t seen_bytes;
     do
     {
-        if (__sim7600__send_command("AT+CFUN?\r\n") != SUCCESS)
-            break;
-        if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-            break;
+        seen_bytes = at_stream_bytes;
+        ret_val = __sim7600__wait_4response("#XHTTPCRSP:0,1", AT_HTTP_RESPONSE_TIMEOUT_MS);
+    } while( (ret_val != SUCCESS) && (at_stream_bytes != seen_bytes) );
+
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    if(at_stream_abort)
+        ret_val = FAILURE;
+    at_stream_cb = NULL;
+    at_stream_ctx = NULL;
+    xSemaphoreGive(at_rx_lock);
+    if(ret_val != SUCCESS)
+        SIM7600_PRINTF("HTTP response incomplete after %luB\n", (unsigned long)at_stream_bytes);
+    return ret_val;
+}
 
-        char resp[AT_BUFFER_SIZE] = {0};
-        int resp_len = __sim7600__get_resp(resp, sizeof(resp));
+// Chunk callback of sim7600__httpsGET()/POST(): keep what fits, count the rest
+int __sim7600__http_collect(const uint8_t* data, uint16_t len, void* ctx)
+{
+    at_http_collect_t* collect = (at_http_collect_t*)ctx;
+    uint16_t copy_len = MIN(len, collect->size - 1 - collect->len);
+    memcpy(&collect->buf[collect->len], data, copy_len);
+    collect->len += copy_len;
+    collect->buf[collect->len] = '\0';
+    collect->dropped += len - copy_len;
+    return SUCCESS; // Keep going even when full, the exchange must complete
+}
 
-        int cur_func_mode;
-        char* cur_func_mode_str = strstr(resp, "+CFUN: ");
-        if(cur_func_mode_str == NULL)
-            break;
+/**
+ * @brief One response header line: the status code from the first, the body length from Content-Length
+ */
+void __sim7600__http_header_line(at_http_body_collect_t* collect)
+{
+    collect->line[collect->line_len] = '\0';
+    if(collect->lines++ == 0)
+    {
+        if(sscanf(collect->line, "HTTP/%*s %d", &collect->status) != 1)
+            collect->status = 0;
+    }
+    else if(strncasecmp(collect->line, "Content-Length:", 15) == 0)
+        collect->content_len = strtol(&collect->line[15], NULL, 10);
+    collect->line_len = 0;
+}
 
-        //Get first token to extract current functional mode
-        cur_func_mode_str = strtok(cur_func_mode_str, "\n");
-        if(cur_func_mode_str == NULL)
-            break; // Invalid response 
-        if(sscanf(cur_func_mode_str, "+CFUN: %d ", &cur_func_mode) != 1)
-            break; // Invalid response
-        
-        if(cur_func_mode == 0)
-            return SUCCESS; // Already in power off mode
+// Chunk callback of sim7600__httpsGET_body(): headers and body may share a chunk and the header may span several,
+// so the header end is found byte by byte. Nothing in the body is interpreted
+int __sim7600__http_body_collect(const uint8_t* data, uint16_t len, void* ctx)
+{
+    at_http_body_collect_t* collect = (at_http_body_collect_t*)ctx;
+    uint16_t idx = 0;
+    while( !collect->in_body && (idx < len) )
+    {
+        char chr = (char)data[idx++];
+        if(chr == '\n')
+        {
+            if(collect->line_len != 0)
+                __sim7600__http_header_line(collect);
+            else
+            {
+                collect->in_body = true; // Empty line ends the header
+                if(collect->status == 200)
+                    collect->skip = collect->range_from; // Range not supported, the whole body follows
+                if( (collect->on_body != NULL) && ((collect->status / 100) != 2) )
+                    collect->skip = UINT32_MAX; // Error page, not body data
+            }
+        }
+        else if( (chr != '\r') && (collect->line_len < sizeof(collect->line) - 1) )
+            collect->line[collect->line_len++] = chr;
+    }
+    uint32_t skip_len = MIN((uint32_t)(len - idx), collect->skip);
+    collect->received += len - idx;
+    collect->skip -= skip_len;
+    idx += skip_len;
+    uint32_t body_len = len - idx;
+    if(collect->on_body != NULL)
+    {
+        collect->len += body_len;
+        return (body_len != 0) ? collect->on_body(&data[idx], body_len, collect->ctx) : SUCCESS;
+    }
+    uint32_t copy_len = MIN(body_len, collect->size - collect->len);
+    if(copy_len != 0)
+        memcpy(&collect->buf[collect->len], &data[idx], copy_len);
+    collect->len += copy_len;
+    collect->dropped += body_len - copy_len;
+    return SUCCESS; // Keep going even when full, the exchange must complete
+}
 
-    }while(0);
+/**
+ * @brief Make sure the SLM has an HTTPS connection to host: keeps the open one if it goes to the same host and was
+ *        used within AT_HTTP_IDLE_TIMEOUT_MS, otherwise closes it and runs a new TCP + TLS handshake
+ *
+ * @param host: Host name, not NUL-terminated
+ * @return int SUCCESS if connected, at_https_session.reused tells whether the handshake was skipped. Otherwise FAILURE
+ */
+int __sim7600__https_connect(const struct iovec* host)
+{
+    int status;
+
+    at_https_session.reused = at_https_session.connected && (host->iov_len <= AT_HTTP_HOST_MAX_LEN) &&
+                              (strlen(at_https_session.host) == host->iov_len) &&
+                              (memcmp(at_https_session.host, host->iov_base, host->iov_len) == 0) &&
+                              (PORT_GET_SYSTIME_MS() - at_https_session.last_use_ms < AT_HTTP_IDLE_TIMEOUT_MS);
+    if(at_https_session.reused)
+        return SUCCESS;
+    if(at_https_session.connected)
+        __sim7600__https_disconnect(); // Other host or idle too long
 
-    if (__sim7600__send_command("AT+CFUN=0\r\n") != SUCCESS)
+    struct iovec at_con_cmd[] = { IOV_STR("AT#XHTTPCCON=1,\""), *host, IOV_STR("\",443,12354\r\n") };
+    // Connect to HTTPS server using IPv4
+    if (__sim7600__send_commandv(at_con_cmd, IOV_COUNT(at_con_cmd)) != SUCCESS)
         return FAILURE; // Failed to send command
-    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-        
+
+    // The result line comes once the TLS session is up (or failed)
+    if (__sim7600__wait_4response("#XHTTPCCON:", AT_HTTP_CONNECT_TIMEOUT_MS) != SUCCESS)
+        return FAILURE; // Failed to receive resp (no "#XHTTPCCON" received within timeout")
+
+    if (__sim7600__get_resp_int("#XHTTPCCON:", &status) != SUCCESS)
+        return FAILURE; // Invalid response
+    if(status != 1)
+        return FAILURE; // Failed to connect to server
+
+    // Connected either way so the next request closes it. A host too long to remember is stored empty and never reused
+    at_https_session.host[0] = '\0';
+    if(host->iov_len <= AT_HTTP_HOST_MAX_LEN)
+    {
+        memcpy(at_https_session.host, host->iov_base, host->iov_len);
+        at_https_session.host[host->iov_len] = '\0';
+    }
+    at_https_session.connected = true;
+    at_https_session.last_use_ms = PORT_GET_SYSTIME_MS();
     return SUCCESS;
 }
 
-/*
- * Implements [AT+CESQ] (Signal Quality Report), Waits for Response, Returns RSSI value in dBm.
- * https://infocenter.nordicsemi.com/topic/ref_at_commands/REF/at_commands/mob_termination_ctrl_status/cesq_set.html 
- * Example:
- * "AT+CESQ"
- * "+CESQ: 99,99,255,255,31,62 <CR><LF> OK"
+/**
+ * @brief Implements [AT#XHTTPCCON=0]. The session counts as closed whatever the modem answers
  */
-int sim7600__get_rssi(void)
+void __sim7600__https_disconnect(void)
 {
-    if (__sim7600__send_command("AT+CESQ\r\n") != SUCCESS)
+    at_https_session.connected = false;
+    at_https_session.reused = false;
+    if(__sim7600__send_command("AT#XHTTPCCON=0\r\n") == SUCCESS)
+        __sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS);
+}
+
+/**
+ * @brief Request finished: keep the session for the next one, or drop it after an error (the state of the
+ *        connection is unknown then)
+ */
+void __sim7600__https_done(int status)
+{
+    if(status == SUCCESS)
+        at_https_session.last_use_ms = PORT_GET_SYSTIME_MS();
+    else if(at_https_session.connected)
+        __sim7600__https_disconnect();
+}
+
+/**
+ * @brief Send the HTTPS GET request line on the connected session
+ * 
+ * @param path: The path to GET, not NUL-terminated
+ * @param range_from: Non-zero: ask for the body from this offset on ("Range: bytes=<range_from>-")
+ * @return int SUCCESS if ok. Returns FAILURE if error.
+ */
+int __sim7600__httpsGET_req(const struct iovec* path, uint32_t range_from)
+{
+    int status;
+    char range[40] = "";
+
+    if(range_from != 0)
+        snprintf(range, sizeof(range), "\",\"Range: bytes=%lu-\r\n", (unsigned long)range_from);
+    struct iovec at_req_cmd[] = { IOV_STR("AT#XHTTPCREQ=\"GET\",\""), *path, IOV_STR(range), IOV_STR("\"\r\n") };
+    if (__sim7600__send_commandv(at_req_cmd, IOV_COUNT(at_req_cmd)) != SUCCESS)
         return FAILURE; // Failed to send command
+
+    if (__sim7600__wait_4response("#XHTTPCREQ", AT_HTTP_REQUEST_TIMEOUT_MS) != SUCCESS)
+        return FAILURE; // Failed to receive resp (no "#XHTTPCREQ" received within timeout")
+
+    if (__sim7600__get_resp_int("#XHTTPCREQ:", &status) != SUCCESS)
+        return FAILURE; // Invalid response
+
+    if(status < 0)
+        return FAILURE; // Failed to send request
     
-    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+    return SUCCESS;
+}
+
+/**
+ * @brief Connect (or reuse the open session) and send HTTPS GET request to the server.
+ *        A request failing on a reused session is retried once on a fresh connection, the server may have closed it
+ * 
+ * @param url: The URL to send the GET request to
+ * @param range_from: Body offset to start from, 0 for the whole body
+ * @return int SUCCESS if ok. Returns FAILURE if error.
+ */
+int __sim7600__httpsGET_send_req(char* url, uint32_t range_from)
+{
+    struct iovec host, path;
+
+    /* Extract hostname and path from URL */
+    __sim7600__parse_url(url, &host, &path);
+    SIM7600_PRINTF("Host: %.*s\n", (int)host.iov_len, (char*)host.iov_base);
+    SIM7600_PRINTF("Path: %.*s\n", (int)path.iov_len, (char*)path.iov_base);
+
+    while(1)
+    {
+        if(__sim7600__https_connect(&host) != SUCCESS)
+            return FAILURE;
+        bool reused = at_https_session.reused;
+        if(__sim7600__httpsGET_req(&path, range_from) == SUCCESS)
+            return SUCCESS;
+        __sim7600__https_disconnect();
+        if(!reused)
+            return FAILURE;
+    }
+}
+
+/**
+ * @brief Send the request body while the SLM is in data mode, straight from body->data or in AT_HTTP_BODY_BLOCK_SIZE
+ *        blocks from body->read. The UART write blocks while the modem holds CTS, so the body never outruns it
+ *
+ * @param sent: Body bytes taken from the source so far, a request is only repeated while this is 0
+ * @return int SUCCESS once body->len bytes are sent, FAILURE if the source ran dry or aborted, or the write failed
+ */
+int __sim7600__https_send_body(const sim7600_http_body_t* body, uint32_t* sent)
+{
+    if(body->data != NULL)
+    {
+        struct iovec iov = { .iov_base = (void*)body->data, .iov_len = body->len };
+        *sent = body->len;
+        __sim7600__chan()->trace_txn.bytes_out += body->len;
+        return (__sim7600__link_writev(__sim7600__chan(), &iov, 1) < 0) ? FAILURE : SUCCESS;
+    }
+    uint8_t* block = (uint8_t*)__sim7600__pool_get();
+    if(block == NULL)
+        return FAILURE;
+    int ret_val = SUCCESS;
+    while(*sent < body->len)
+    {
+        int block_len = body->read(block, MIN(AT_HTTP_BODY_BLOCK_SIZE, body->len - *sent), body->ctx);
+        if(block_len <= 0)
+        {
+            SIM7600_PRINTF("HTTP body source stopped after %luB of %luB\n", (unsigned long)*sent, (unsigned long)body->len);
+            ret_val = FAILURE; // The session is dropped, the modem is left waiting for the rest
+            break;
+        }
+        struct iovec iov = { .iov_base = block, .iov_len = MIN((uint32_t)block_len, body->len - *sent) };
+        if(__sim7600__link_writev(__sim7600__chan(), &iov, 1) < 0)
+        {
+            ret_val = FAILURE;
+            break;
+        }
+        *sent += iov.iov_len;
+        __sim7600__chan()->trace_txn.bytes_out += iov.iov_len;
+    }
+    __sim7600__pool_put((char*)block);
+    return ret_val;
+}
+
+/* 
+ * Implements [AT#XHTTPCREQ=\"POST\",\"/myurl\",\"User-Agent: <agent>\r\n\",\"<content_type>\",<content_length>] on the
+ * connected session, waits for "#XHTTPCREQ: 1" (SLM in data mode) and sends exactly <content_length> body bytes, where
+ * <agent>:     is the contents of agent, with the null terminator removed
+ * Returns      0 if ok. Returns -1 if error.
+ * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/HTTPC_AT_commands.html
+*/
+int __sim7600__httpsPOST_req(const struct iovec* path, char* agent, const sim7600_http_body_t* body, uint32_t* sent)
+{
+    int status;
+    char content_len[12];
+
+    // Connected to server, send POST request. The body length goes in the command, no text limit on the body
+    snprintf(content_len, sizeof(content_len), "%lu", (unsigned long)body->len);
+    struct iovec at_req_cmd[] = { IOV_STR("AT#XHTTPCREQ=\"POST\",\""), *path, IOV_STR("\",\"User-Agent: "), IOV_STR(agent),
+                                  IOV_STR("\r\n\",\""), IOV_STR(body->content_type), IOV_STR("\","), IOV_STR(content_len),
+                                  IOV_STR("\r\n") };
+    if (__sim7600__send_commandv(at_req_cmd, IOV_COUNT(at_req_cmd)) != SUCCESS)
+        return FAILURE; // Failed to send command
 
-    char resp[AT_BUFFER_SIZE] = {0};
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
+    if (__sim7600__wait_4response("#XHTTPCREQ", AT_HTTP_REQUEST_TIMEOUT_MS) != SUCCESS)
+        return FAILURE; // Failed to receive resp (no "#XHTTPCREQ" received within timeout")
 
-    char* cesq_response_str = strstr(resp, "+CESQ: ");
-    if(cesq_response_str == NULL)
+    if (__sim7600__get_resp_int("#XHTTPCREQ:", &status) != SUCCESS)
         return FAILURE; // Invalid response
+    if( (body->len == 0) && (status == 0) )
+        return SUCCESS; // No body, request already sent
+    if(status != 1) // Modem ready for the payload
+        return FAILURE;
 
-    //Get first token to extract RSSI
-    cesq_response_str = strtok(cesq_response_str, "\n");
-    if(cesq_response_str == NULL)
+    if (__sim7600__https_send_body(body, sent) != SUCCESS)
+        return FAILURE;
+
+    // The SLM leaves data mode after <content_length> bytes and reports the request
+    if (__sim7600__wait_4response("#XHTTPCREQ", AT_HTTP_REQUEST_TIMEOUT_MS) != SUCCESS)
+        return FAILURE; // Failed to receive resp (no "#XHTTPCREQ" received within timeout")
+
+    if (__sim7600__get_resp_int("#XHTTPCREQ:", &status) != SUCCESS)
         return FAILURE; // Invalid response
-    
-    int rssi = __sim7600__cal_rssi_from_cesq(cesq_response_str);
 
-    return rssi;
+
+    if(status < 0)
+        return FAILURE; // Failed to send request
+        
+    return SUCCESS;
+}
+
+/**
+ * @brief Connect (or reuse the open session) and send HTTPS POST request and its body to the server.
+ *        Retried once on a fresh connection like __sim7600__httpsGET_send_req(), unless body bytes were already taken
+ *
+ * @return int SUCCESS if ok. Returns FAILURE if error.
+ */
+int __sim7600__httpsPOST_send_req(char* url, char* agent, const sim7600_http_body_t* body)
+{
+    struct iovec host, path;
+    uint32_t sent = 0;
+
+    /* Extract hostname and path from URL */
+    __sim7600__parse_url(url, &host, &path);
+    SIM7600_PRINTF("Host: %.*s\n", (int)host.iov_len, (char*)host.iov_base);
+    SIM7600_PRINTF("Path: %.*s\n", (int)path.iov_len, (char*)path.iov_base);
+
+    while(1)
+    {
+        if(__sim7600__https_connect(&host) != SUCCESS)
+            return FAILURE;
+        bool reused = at_https_session.reused;
+        if(__sim7600__httpsPOST_req(&path, agent, body, &sent) == SUCCESS)
+            return SUCCESS;
+        __sim7600__https_disconnect();
+        if(!reused || (sent != 0))
+            return FAILURE;
+    }
+}
+
+int __sim7600__httpsPOST_stream(char* url, char* agent, const sim7600_http_body_t* body, sim7600_http_chunk_cb_t on_chunk, void* ctx)
+{
+    __sim7600__stream_begin(on_chunk, ctx);
+    if(__sim7600__httpsPOST_send_req(url, agent, body) != SUCCESS)
+    {
+        SIM7600_PRINTF("Failed to send HTTP POST request \n");
+        __sim7600__stream_begin(NULL, NULL);
+        return FAILURE; // Failed to send request
+    }
+    int ret_val = __sim7600__stream_wait();
+    __sim7600__https_done(ret_val);
+    return ret_val;
+}
+
+/* 
+ * If url = "google.com/myurl" Implements [AT#XHTTPCCON=1,\"google.com\",443,12354], waits for a valid reply
+ * then implements [AT#XHTTPCREQ=\"POST\",\"/myurl\",\"User-Agent: <agent>\r\n\",\"application/json\",<len>] and sends
+ * JSONdata (without the null terminator, any length) in data mode.
+ * Returns      0 if ok. Returns -1 if error. Returns response in response char array. 
+ * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/HTTPC_AT_commands.html
+*/
+int __sim7600__httpsPOST(char* url, char* JSONdata, char* agent, char* http_response, uint16_t maxlength)
+{
+    at_http_collect_t collect = { .buf = http_response, .size = maxlength };
+    sim7600_http_body_t body = { .content_type = "application/json", .len = strlen(JSONdata), .data = JSONdata };
+    http_response[0] = '\0';
+    int ret_val = __sim7600__httpsPOST_stream(url, agent, &body, __sim7600__http_collect, &collect);
+    if(collect.dropped != 0)
+        SIM7600_PRINTF("sim7600__httpsPOST(), Buffer overflow by %lu \n", (unsigned long)collect.dropped);
+    SIM7600_PRINTF("HTTP Response : \n %s\n", http_response);
+    return ret_val;
+}
+
+int __sim7600__httpsGET_stream(char* url, uint32_t range_from, sim7600_http_chunk_cb_t on_chunk, void* ctx)
+{
+    __sim7600__stream_begin(on_chunk, ctx);
+    if(__sim7600__httpsGET_send_req(url, range_from) != SUCCESS)
+    {
+        SIM7600_PRINTF("Failed to send HTTP GET request \n");
+        __sim7600__stream_begin(NULL, NULL);
+        return FAILURE; // Failed to send request
+    }
+    SIM7600_PRINTF("Waiting for HTTP response... \n");
+    int ret_val = __sim7600__stream_wait();
+    __sim7600__https_done(ret_val);
+    return ret_val;
+}
+
+int __sim7600__httpsGET(char* url, char* http_response, uint16_t maxlength)
+{
+    at_http_collect_t collect = { .buf = http_response, .size = maxlength };
+    http_response[0] = '\0';
+    int ret_val = __sim7600__httpsGET_stream(url, 0, __sim7600__http_collect, &collect);
+    if(collect.dropped != 0)
+        SIM7600_PRINTF("sim7600__httpsGET(), Buffer overflow by %lu \n", (unsigned long)collect.dropped);
+    SIM7600_PRINTF("HTTP Response : \n %s\n", http_response);
+    return ret_val;
+}
+
+int __sim7600__httpsPOST_job(void* arg)
+{
+    at_https_args_t* args = (at_https_args_t*)arg;
+    return __sim7600__httpsPOST(args->url, args->JSONdata, args->agent, args->http_response, args->maxlength);
+}
+
+int __sim7600__httpsGET_job(void* arg)
+{
+    at_https_args_t* args = (at_https_args_t*)arg;
+    return __sim7600__httpsGET(args->url, args->http_response, args->maxlength);
+}
+
+int __sim7600__httpsGET_stream_job(void* arg)
+{
+    at_stream_args_t* args = (at_stream_args_t*)arg;
+    return __sim7600__httpsGET_stream(args->url, args->range_from, args->on_chunk, args->ctx);
+}
+
+int __sim7600__httpsPOST_stream_job(void* arg)
+{
+    at_stream_args_t* args = (at_stream_args_t*)arg;
+    return __sim7600__httpsPOST_stream(args->url, args->agent, args->body, args->on_chunk, args->ctx);
+}
+
+// Transfers hold the modem for the whole exchange, queued behind SIM7600_PRIO_HIGH and SIM7600_PRIO_NORMAL commands
+int sim7600__httpsPOST(char* url, char* JSONdata, char* agent, char* http_response, uint16_t maxlength)
+{
+    at_https_args_t args = { .url = url, .JSONdata = JSONdata, .agent = agent, .http_response = http_response, .maxlength = maxlength };
+    return __sim7600__run_job(__func__, __sim7600__httpsPOST_job, &args, SIM7600_PRIO_BULK);
+}
+
+int sim7600__httpsGET(char* url, char* http_response, uint16_t maxlength)
+{
+    at_https_args_t args = { .url = url, .http_response = http_response, .maxlength = maxlength };
+    return __sim7600__run_job(__func__, __sim7600__httpsGET_job, &args, SIM7600_PRIO_BULK);
+}
+
+/*
+ * HTTPS POST of a body of any size to url ("host/path"): the length goes in the request and the body follows in
+ * the SLM data mode, from body->data or pulled block by block from body->read on the modem engine task. The response
+ * is handed to on_chunk as sim7600__httpsGET_stream() does.
+ * Returns SUCCESS if the whole response was delivered. Returns FAILURE if error, timeout or aborted by a callback.
+ */
+int sim7600__httpsPOST_stream(char* url, char* agent, const sim7600_http_body_t* body, sim7600_http_chunk_cb_t on_chunk, void* ctx)
+{
+    param_check(url != NULL);
+    param_check(agent != NULL);
+    param_check( (body != NULL) && (body->content_type != NULL) && ((body->data != NULL) || (body->read != NULL)) );
+    param_check(on_chunk != NULL);
+    at_stream_args_t args = { .url = url, .agent = agent, .body = body, .on_chunk = on_chunk, .ctx = ctx };
+    return __sim7600__run_job(__func__, __sim7600__httpsPOST_stream_job, &args, SIM7600_PRIO_BULK);
+}
+
+int __sim7600__httpsClose_job(void* arg)
+{
+    (void)arg;
+    if(at_https_session.connected)
+        __sim7600__https_disconnect();
+    return SUCCESS;
 }
 
 /*
- * Implements [AT+COPS?] 
- * Expected Response: +COPS: (<status>,"long","short","numeric",<AcT>) // AcT - Access Technology
- * returns 1 if connected, 0 if not connected, -1 if error 
- * //https://infocenter.nordicsemi.com/topic/ref_at_commands/REF/at_commands/nw_service/cops_read.html
+ * Implements [AT#XHTTPCCON=0] if an HTTPS session is kept open, e.g. before sleeping.
+ * Returns SUCCESS. The next request reconnects.
  */
-int sim7600__connected(void)
+int sim7600__httpsClose(void)
 {
-    if (__sim7600__send_command("AT+COPS?\r\n") != SUCCESS)
-        return FAILURE; // Failed to send command
-
-    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-
-    char resp[AT_BUFFER_SIZE] = {0};
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
-
-    char* cops_response_str = strstr(resp, "ERROR");
-    if(cops_response_str != NULL)
-        return FAILURE; // Invalid response
+    return __sim7600__run_job(__func__, __sim7600__httpsClose_job, NULL, SIM7600_PRIO_NORMAL);
+}
 
-    cops_response_str = strstr(resp, "+COPS: ");
-    if(cops_response_str == NULL)
-        return FAILURE; // Invalid response
+/*
+ * HTTPS GET of url ("host/path") without buffering the response: every #XHTTPCRSP payload is handed to on_chunk
+ * as it arrives, byte exact (headers first, then the body). on_chunk runs on the modem reader task and must not call
+ * the driver. Returning anything but SUCCESS from it drops the rest of the response.
+ * Returns SUCCESS if the whole response was delivered. Returns FAILURE if error, timeout or aborted by on_chunk.
+ */
+int sim7600__httpsGET_stream(char* url, sim7600_http_chunk_cb_t on_chunk, void* ctx)
+{
+    param_check(url != NULL);
+    param_check(on_chunk != NULL);
+    at_stream_args_t args = { .url = url, .on_chunk = on_chunk, .ctx = ctx };
+    return __sim7600__run_job(__func__, __sim7600__httpsGET_stream_job, &args, SIM7600_PRIO_BULK);
+}
 
-    int network_status;
-    if (sscanf(cops_response_str, "+COPS: %d", &network_status) != 1)
+/**
+ * @brief HTTPS GET through the body collector and the checks on what came back
+ *
+ * @param api: Public function, for the stack profile and the log
+ * @return int Body bytes stored or delivered, FAILURE if error, overflow, error status (streamed) or short body
+ */
+int __sim7600__httpsGET_collect(const char* api, char* url, at_http_body_collect_t* collect, int* http_status)
+{
+    at_stream_args_t args = { .url = url, .range_from = collect->range_from, .on_chunk = __sim7600__http_body_collect, .ctx = collect };
+    int ret_val = __sim7600__run_job(api, __sim7600__httpsGET_stream_job, &args, SIM7600_PRIO_BULK);
+    if(http_status != NULL)
+        *http_status = collect->status;
+    if(ret_val != SUCCESS)
         return FAILURE;
-
-    if(network_status == 2)
-        return 1; // Connected
-    else
-        return 0; // Not connected
-    return FAILURE;
+    if( (collect->on_body != NULL) && ((collect->status / 100) != 2) )
+    {
+        SIM7600_PRINTF("%s(), HTTP status %d\n", api, collect->status);
+        return FAILURE;
+    }
+    if(collect->dropped != 0)
+    {
+        SIM7600_PRINTF("%s(), Buffer overflow by %lu \n", api, (unsigned long)collect->dropped);
+        return FAILURE;
+    }
+    if( (collect->content_len >= 0) && ((uint32_t)collect->content_len != collect->received) )
+    {
+        SIM7600_PRINTF("%s(), %luB of %ldB body received\n", api, (unsigned long)collect->received, collect->content_len);
+        return FAILURE;
+    }
+    return (int)collect->len;
 }
 
 /*
- * Send +CPIN=? 
- * returns 1 if SIM is present (Resp == "READY"), 0 if not present (???), -1 if error
+ * HTTPS GET of url ("host/path") with the body stored byte exact in body: NUL, CR and LF bytes and AT syntax come
+ * through as they are, each #XHTTPCRSP piece is copied by its announced length. The headers are left out.
+ * http_status (optional) receives the status code.
+ * Returns the body length if ok. Returns FAILURE if error, if the body does not fit in size bytes or is shorter
+ * than its Content-Length.
  */
-int sim7600__get_SimPresent(void)
+int sim7600__httpsGET_body(char* url, uint8_t* body, uint32_t size, int* http_status)
 {
-    if (__sim7600__send_command("AT+CPIN?\r\n") != SUCCESS)
-        return FAILURE; // Failed to send command
-
-    if (__sim7600__wait_4response("READY", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "READY" received within timeout")
-
-    return 1;
+    param_check(url != NULL);
+    param_check( (body != NULL) || (size == 0) );
+    at_http_body_collect_t collect = { .buf = body, .size = size, .content_len = -1 };
+    return __sim7600__httpsGET_collect(__func__, url, &collect, http_status);
 }
 
 /*
- * Implements [AT#CARRIER="time","read"] to get time returns seconds since UTC time 0. 
- * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/CARRIER_AT_commands.html#lwm2m-carrier-library-xcarrier
+ * HTTPS GET of url ("host/path") from body offset range_from on ("Range: bytes=<range_from>-" unless 0), the body
+ * alone handed to on_body as it arrives, e.g. to resume a download. A server ignoring the range answers 200 with the
+ * whole body, the first range_from bytes are dropped then. Returning anything but SUCCESS from on_body drops the rest.
+ * Unlike other chunk callbacks on_body may block for a while to slow the transfer down (e.g. flash writes): the reader
+ * task stops draining the UART and RTS holds the modem off. It must return within AT_HTTP_RESPONSE_TIMEOUT_MS.
+ * Returns the number of body bytes delivered if ok. Returns FAILURE if error, aborted, the status is not 2xx or the
+ * body is shorter than its Content-Length; what was delivered before is valid.
  */
-long sim7600__get_time(void)
+int sim7600__httpsGET_range(char* url, uint32_t range_from, sim7600_http_chunk_cb_t on_body, void* ctx, int* http_status)
 {
-    if (__sim7600__send_command("AT#XCARRIER=\"time\"\r\n") != SUCCESS)
-        return FAILURE; // Failed to send command
-
-    if(__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-
-    char resp[AT_BUFFER_SIZE] = {0};
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
-
-    // Parse response given example: #XCARRIER: UTC_TIME: 2022-12-30T14:56:46Z, UTC_OFFSET: 60, TIMEZONE: Europe/Paris
-    char* utc_date_time_str = strstr(resp, "UTC_TIME: ");
-    if(utc_date_time_str == NULL)
-        return FAILURE; // Invalid response
-
-    long unix_timestamp = __sim7600__get_unix_timestamp(utc_date_time_str);
-    if(unix_timestamp == FAILURE)
-        return FAILURE; // Invalid response
-
-    return unix_timestamp;
+    param_check(url != NULL);
+    param_check(on_body != NULL);
+    at_http_body_collect_t collect = { .on_body = on_body, .ctx = ctx, .range_from = range_from, .content_len = -1 };
+    return __sim7600__httpsGET_collect(__func__, url, &collect, http_status);
 }
 
-/*
- * calls "__sim7600__clearCert()" to clear the certificate, if it exists.
- * Then, Implements [AT%CMNG=0,12354,0,\"<ca>\"] to set CA certificate,
- *  where <ca> represents the contents of ca, with the null terminator removed.
- *  Then, enables the modem using "sim7600__power_on()" Returns 0 if ok. Returns -1 if error.
- * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/Generic_AT_commands.html#native-tls-cmng-xcmng
+/**
+ * @brief Open socket with this handle. The engine task is the only writer, other tasks hold at_rx_lock
+ *
+ * @return at_sock_t* The slot, NULL if sock is not open
  */
-int sim7600__setCA(char* ca)
+at_sock_t* __sim7600__sock_find(int sock)
 {
-    if (__sim7600__clearCert() != SUCCESS)
-        return FAILURE; // Failed to clear certificate 
+    for(uint8_t idx = 0; idx < SIM7600_SOCK_MAX; idx++)
+    {
+        if(at_sock[idx].in_use && (at_sock[idx].handle == sock))
+            return &at_sock[idx];
+    }
+    return NULL;
+}
 
-    char at_tx_buffer[AT_BUFFER_SIZE] = {0};
-    snprintf(at_tx_buffer, sizeof(at_tx_buffer), "AT%%CMNG=0,12354,0,%s\r\n", ca); //FAULT
-    if (__sim7600__send_command(at_tx_buffer) != SUCCESS)
-        return FAILURE; // Failed to send command
-        
-    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-    if ( sim7600__power_on() != SUCCESS)
-        return FAILURE; // Failed to power on
+/**
+ * @brief Implements [AT#XSOCKETSELECT=<sock>] unless sock is already the one the SLM commands act on
+ *
+ * @return int SUCCESS if ok, otherwise FAILURE
+ */
+int __sim7600__sock_select(int sock)
+{
+    char at_select_cmd[32];
+    if(sock == at_sock_selected)
+        return SUCCESS;
+    at_sock_selected = -1;
+    snprintf(at_select_cmd, sizeof(at_select_cmd), "AT#XSOCKETSELECT=%d\r\n", sock);
+    if( (__sim7600__send_command(at_select_cmd) != SUCCESS) || (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS) )
+        return FAILURE;
+    at_sock_selected = sock;
     return SUCCESS;
 }
 
 /**
- * @brief Parse the response from the server and extract content
+ * @brief Implements [AT#XSOCKET=0] on the selected socket and forgets it, whatever the modem answers
  *
- * @param resp_input: The response from the modem
- * @param resp_output: The HTTP response output
- * @param body_max_size: The maximum size of the body
+ * @return int SUCCESS if the modem closed it, otherwise FAILURE
  */
-int __sim7600__https_parse_response(char* resp_input, char* resp_output, int resp_max_len)
+int __sim7600__sock_release(at_sock_t* slot)
 {
-    char* p_process = NULL;
-    int recv_content_len = 0;
-    int recv_state = 0;
-    int recv_cur_len = 0;
-    // Split the response by newline characters
-    char *line = strtok((char *)resp_input, "\n");
-
-    while (line != NULL)
+    int ret_val = FAILURE;
+    if( (__sim7600__send_command("AT#XSOCKET=0\r\n") == SUCCESS) && (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) == SUCCESS) )
+        ret_val = SUCCESS;
+    at_sock_selected = -1;
+    if(slot != NULL)
     {
-        p_process = strstr(line, "#XHTTPCRSP:");
-        if(p_process != NULL)
-        {
-            // Get received length and status
-            if (sscanf(p_process, "#XHTTPCRSP:%d,%d", &recv_content_len, &recv_state) != 2)
-            {
-                SIM7600_PRINTF("Invalid response, current processing %s\n", line);
-                continue;
-            }
-            if(recv_state == 0)
-            {
-//            	SIM7600_PRINTF("Receiving %dB \n", recv_content_len);
-            }
-            else if(recv_state == 1)
-                return SUCCESS;
-        }
-        else //Processing HTTP response
-        {
-            // Check total length of response to prevent buffer overflow
-            if(recv_cur_len + strlen(line) > resp_max_len)
-            {
-                SIM7600_PRINTF("__sim7600__https_parse_response(), Buffer overflow by %d \n", recv_cur_len + strlen(line) - resp_max_len);
-                // Fill until resp_output[resp_max_len] is full and discard the rest
-                if(recv_cur_len < resp_max_len)
-                    strncat(resp_output, line, resp_max_len - recv_cur_len);    //Fill until resp_output[resp_max_len] is full
-                recv_cur_len += strlen(line); // Make sure that in the end, we know how many bytes are lost due to buffer overflow
-            }
-            else
-            {
-                // Append response to response buffer
-                strcat(resp_output, line);
-                recv_cur_len += strlen(line);
-                // Append "\n" which removed by strtok()
-                if(recv_cur_len + 1 < resp_max_len)
-                {
-                    strcat(resp_output, "\n");
-                    recv_cur_len += 1;
-                }
-            }
-        }
-        line = strtok(NULL, "\n");
+        xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+        slot->in_use = false;
+        xSemaphoreGive(at_rx_lock);
     }
-    return FAILURE;
+    return ret_val;
 }
 
 /**
- * @brief Connect and Send HTTPS GET request to the server
- * 
- * @param url: The URL to send the GET request to
- * @return int SUCCESS if ok. Returns FAILURE if error.
+ * @brief Reader task: "#XAPOLL: <handle>,<revents>" says a socket with a receive callback has data (or hung up).
+ *        Queues one receive job per socket, which drains everything that arrived until it runs
  */
-int __sim7600__httpsGET_send_req(char* url)
+void __sim7600__sock_from_urc(const char* line)
 {
-    int status;
-    char resp[AT_BUFFER_SIZE] = {0};
-    char at_send_buffer[255] = {0};
-    char host[100] = {0};
-    char path[100] = {0};
-    char* response_data;
-
-    /* Extract hostname and path from URL */
-    __sim7600__parse_url(url, host, path);
-    SIM7600_PRINTF("Host: %s\n", host);
-    SIM7600_PRINTF("Path: %s\n", path);
-
-    snprintf(at_send_buffer, sizeof(at_send_buffer), "AT#XHTTPCCON=1,\"%s\",443,12354\r\n", host);
-    // Connect to HTTPS server using IPv4
-    if (__sim7600__send_command(at_send_buffer) != SUCCESS)
-        return FAILURE; // Failed to send command
-	
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
-
-    if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
-
-    response_data = strstr(resp, "#XHTTPCCON");
-    if(response_data == NULL)
-        return FAILURE; // Invalid response
-
-    if (sscanf(response_data, "#XHTTPCCON: %d", &status) != 1)
+    int handle, revents;
+    bool post = false;
+    if(sscanf(line, "#XAPOLL:%d,%d", &handle, &revents) != 2)
+        return;
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    at_sock_t* slot = __sim7600__sock_find(handle);
+    if( (slot != NULL) && (slot->on_rx != NULL) && ((revents & (AT_SOCK_POLLIN | AT_SOCK_POLLHUP_ERR)) != 0) )
     {
-        SIM7600_PRINTF("Invalid response\n");
-        return FAILURE; // Invalid response
+        if(revents & AT_SOCK_POLLHUP_ERR)
+            slot->hangup = true;
+        post = !slot->rx_queued;
+        slot->rx_queued = true;
     }
-    if(status != 1)
-        return FAILURE; // Failed to connect to server
-
-    // Connected to server, send GET request
-    memset(at_send_buffer, 0, strlen(at_send_buffer));
-    snprintf(at_send_buffer, sizeof(at_send_buffer), "AT#XHTTPCREQ=\"GET\",\"%s\"\r\n", path);
-    if (__sim7600__send_command(at_send_buffer) != SUCCESS)
-        return FAILURE; // Failed to send command
+    xSemaphoreGive(at_rx_lock);
 
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
+    if(post && (__sim7600__post_job("sim7600__sock_rx", __sim7600__sock_rx_job, slot, SIM7600_PRIO_NORMAL) != SUCCESS))
+    {
+        xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+        slot->rx_queued = false; // The next #XAPOLL tries again
+        xSemaphoreGive(at_rx_lock);
+        SIM7600_PRINTF("Socket %d data left in the modem, no free command slot\n", handle);
+    }
+}
 
-    if (__sim7600__wait_4response("#XHTTPCREQ", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+// Stream callback of the receive job: socket data straight to the application
+int __sim7600__sock_deliver(const uint8_t* data, uint16_t len, void* ctx)
+{
+    at_sock_t* slot = (at_sock_t*)ctx;
+    slot->on_rx(slot->handle, data, len, slot->ctx);
+    return SUCCESS;
+}
 
-    resp_len = __sim7600__get_resp(resp, sizeof(resp));
+// Stream callback of sim7600__sock_recv(): keep what fits, count the rest
+int __sim7600__sock_collect(const uint8_t* data, uint16_t len, void* ctx)
+{
+    at_sock_io_args_t* args = (at_sock_io_args_t*)ctx;
+    uint16_t copy_len = MIN(len, args->len - args->received);
+    memcpy(&args->buf[args->received], data, copy_len);
+    args->received += copy_len;
+    args->dropped += len - copy_len;
+    return SUCCESS;
+}
 
-    response_data = strstr(resp, "XHTTPCREQ");
-    if(response_data == NULL)
-    	return FAILURE;
-    if (sscanf(response_data, "XHTTPCREQ: %d", &status) != 1)
+/**
+ * @brief Implements [AT#XRECV=<timeout>[,<flags>]] on the selected socket, the "#XRECV: <len>" payload handed to on_data
+ *
+ * @return int Payload bytes received, 0 if none (the SLM answers ERROR when nothing came in time), FAILURE if error
+ */
+int __sim7600__sock_recv_once(uint32_t timeout_s, sim7600_http_chunk_cb_t on_data, void* ctx)
+{
+    char at_recv_cmd[32];
+    if(timeout_s == 0)
+        snprintf(at_recv_cmd, sizeof(at_recv_cmd), "AT#XRECV=0,%u\r\n", AT_SOCK_MSG_DONTWAIT);
+    else
+        snprintf(at_recv_cmd, sizeof(at_recv_cmd), "AT#XRECV=%lu\r\n", (unsigned long)timeout_s);
+    __sim7600__stream_begin(on_data, ctx);
+    if(__sim7600__send_command(at_recv_cmd) != SUCCESS)
     {
-        SIM7600_PRINTF("Invalid response\n");
-        return FAILURE; // Invalid response
+        __sim7600__stream_begin(NULL, NULL);
+        return FAILURE;
     }
+    __sim7600__wait_4response("OK", timeout_s * 1000 + AT_DEFAULT_TIMEOUT_MS);
+    int received = (int)at_stream_bytes;
+    __sim7600__stream_begin(NULL, NULL);
+    return received;
+}
 
-    if(status < 0)
-        return FAILURE; // Failed to send request
-    
+/**
+ * @brief Receive job posted by __sim7600__sock_from_urc(): pull everything the modem buffered for the socket, then
+ *        report a hang-up if there was one
+ */
+int __sim7600__sock_rx_job(void* arg)
+{
+    at_sock_t* slot = (at_sock_t*)arg;
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    slot->rx_queued = false; // Data reported from now on gets a new job
+    xSemaphoreGive(at_rx_lock);
+    if( !slot->in_use || (slot->on_rx == NULL) )
+        return SUCCESS; // Closed meanwhile
+    if(__sim7600__sock_select(slot->handle) != SUCCESS)
+        return FAILURE;
+    while(__sim7600__sock_recv_once(0, __sim7600__sock_deliver, slot) > 0);
+    if(slot->hangup)
+    {
+        slot->hangup = false;
+        slot->on_rx(slot->handle, NULL, 0, slot->ctx);
+    }
     return SUCCESS;
 }
 
-/* 
- * then implements [AT#XHTTPCREQ=\"POST\",\"/myurl\",\"User-Agent: <agent>\r\n\",\"application/json\","<JSONdata>\"]  where
- * <agent>:     is the contents of agent, with the null terminator removed
- * <JSONdata>:  is the contents of JSONdata, with the null terminator removed. 
- * Returns      0 if ok. Returns -1 if error. Returns response in response char array. 
- * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/HTTPC_AT_commands.html
-*/
-int __sim7600__httpsPOST_send_req(char* url, char* JSONdata, char* agent)
+/*
+ * Implements [AT#XSOCKET=1,<type>,0] (or [AT#XSSOCKET=1,<type>,0,12354] for TLS/DTLS with the certificate of
+ * sim7600__setCA()) and [AT#XCONNECT="<host>",<port>]. UDP sockets are connected too, so send and receive need no
+ * address. With a receive callback, [AT#XAPOLL=1,1] makes the SLM report incoming data.
+ * Returns      the socket handle if ok. Returns -1 if error, the modem socket is closed again.
+ * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/SOCK_AT_commands.html
+ */
+int __sim7600__sock_open_job(void* arg)
 {
-    int status;
-    char resp[AT_BUFFER_SIZE] = {0};
-    char at_send_buffer[255] = {0};
-    char host[100] = {0};
-    char path[100] = {0};
-    char* response_data;
+    at_sock_open_args_t* args = (at_sock_open_args_t*)arg;
+    at_sock_t* slot = NULL;
+    int handle, status;
+    char type[4], port[6];
 
-    /* Extract hostname and path from URL */
-    __sim7600__parse_url(url, host, path);
-    SIM7600_PRINTF("Host: %s\n", host);
-    SIM7600_PRINTF("Path: %s\n", path);
+    for(uint8_t idx = 0; (idx < SIM7600_SOCK_MAX) && (slot == NULL); idx++)
+    {
+        if(!at_sock[idx].in_use)
+            slot = &at_sock[idx];
+    }
+    if(slot == NULL)
+    {
+        SIM7600_PRINTF("All %u sockets in use\n", SIM7600_SOCK_MAX);
+        return FAILURE;
+    }
 
-    snprintf(at_send_buffer, sizeof(at_send_buffer), "AT#XHTTPCCON=1,\"%s\",443,12354\r\n", host);
-    // Connect to HTTPS server using IPv4
-    if (__sim7600__send_command(at_send_buffer) != SUCCESS)
+    snprintf(type, sizeof(type), "%d", (int)args->type);
+    struct iovec at_open_cmd[] = { IOV_STR(args->secure ? "AT#XSSOCKET=1," : "AT#XSOCKET=1,"), IOV_STR(type),
+                                   IOV_STR(args->secure ? ",0,12354\r\n" : ",0\r\n") };
+    if (__sim7600__send_commandv(at_open_cmd, IOV_COUNT(at_open_cmd)) != SUCCESS)
         return FAILURE; // Failed to send command
-
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
-
     if (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
-
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
-
-    response_data = strstr(resp, "#XHTTPCCON");
-    if(response_data == NULL)
+        return FAILURE; // No socket left in the modem, or no network
+    if ( (__sim7600__get_resp_int(args->secure ? "#XSSOCKET:" : "#XSOCKET:", &handle) != SUCCESS) || (handle < 0) )
         return FAILURE; // Invalid response
+    at_sock_selected = handle; // The SLM selects a new socket
 
-    if (sscanf(response_data, "#XHTTPCCON: %d", &status) != 1)
+    snprintf(port, sizeof(port), "%u", args->port);
+    struct iovec at_con_cmd[] = { IOV_STR("AT#XCONNECT=\""), IOV_STR(args->host), IOV_STR("\","), IOV_STR(port), IOV_STR("\r\n") };
+    if( (__sim7600__send_commandv(at_con_cmd, IOV_COUNT(at_con_cmd)) != SUCCESS) ||
+        (__sim7600__wait_4response("#XCONNECT:", AT_SOCK_CONNECT_TIMEOUT_MS) != SUCCESS) ||
+        (__sim7600__get_resp_int("#XCONNECT:", &status) != SUCCESS) || (status != 1) )
     {
-        SIM7600_PRINTF("Invalid response\n");
-        return FAILURE; // Invalid response
+        SIM7600_PRINTF("Failed to connect socket %d to %s:%s\n", handle, args->host, port);
+        __sim7600__sock_release(NULL);
+        return FAILURE;
     }
 
-    if(status != 1)
-        return FAILURE; // Failed to connect to server
-
-    // Connected to server, send POST request
-    memset(at_send_buffer, 0, strlen(at_send_buffer));
-    snprintf(at_send_buffer, sizeof(at_send_buffer), "AT#XHTTPCREQ=\"POST\",\"%s\",\"User-Agent: %s\r\n\Content-Type: application/json\r\n\"", path, agent);
-    if (__sim7600__send_command(at_send_buffer) != SUCCESS)
-        return FAILURE; // Failed to send command
-
-    if (__sim7600__wait_4response("#XHTTPCREQ", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+    xSemaphoreTake(at_rx_lock, portMAX_DELAY);
+    *slot = (at_sock_t){ .in_use = true, .handle = handle, .on_rx = args->on_rx, .ctx = args->ctx };
+    xSemaphoreGive(at_rx_lock);
 
-    resp_len = __sim7600__get_resp(resp, sizeof(resp));
-    response_data = strstr(resp, "XHTTPCREQ");
-    if(response_data == NULL)
-        return FAILURE;
-    if(sscanf(response_data, "XHTTPCREQ: %d", &status) != 1)
+    // Polls every open socket, sent again so the new one is included
+    if( (args->on_rx != NULL) &&
+        ((__sim7600__send_command("AT#XAPOLL=1,1\r\n") != SUCCESS) || (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)) )
     {
-        SIM7600_PRINTF("Invalid response\n");
-        return FAILURE; // Invalid response
-    }
-    if(status != 1) // Send data payload
+        __sim7600__sock_release(slot);
         return FAILURE;
+    }
+    return handle;
+}
 
-    memset(at_send_buffer, 0, strlen(at_send_buffer));
-    snprintf(at_send_buffer, sizeof(at_send_buffer), "%s\r\n", JSONdata);
-    if (__sim7600__send_command(at_send_buffer) != SUCCESS)
-        return FAILURE; // Failed to send command
+/*
+ * Implements [AT#XSEND] on the socket, then sends data and the "+++" terminator in data mode and waits for
+ * "#XDATAMODE: 0". UDP sends one datagram.
+ * Returns      len if ok. Returns -1 if error.
+ */
+int __sim7600__sock_send_job(void* arg)
+{
+    at_sock_io_args_t* args = (at_sock_io_args_t*)arg;
+    int status;
 
-    if (__sim7600__wait_4response("#XHTTPCREQ", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
-        return FAILURE; // Failed to receive resp (no "OK" received within timeout")
+    if(__sim7600__sock_find(args->sock) == NULL)
+        return FAILURE; // Not open
+    if(__sim7600__sock_select(args->sock) != SUCCESS)
+        return FAILURE;
+    if( (__sim7600__send_command("AT#XSEND\r\n") != SUCCESS) || (__sim7600__wait_4response("OK", AT_DEFAULT_TIMEOUT_MS) != SUCCESS) )
+        return FAILURE; // SLM not in data mode
 
-    resp_len = __sim7600__get_resp(resp, sizeof(resp));
-    response_data = strstr(resp, "XHTTPCREQ");
-    if(response_data == NULL)
+    // One write: the SLM only takes the terminator at the end of a received chunk, "+++" inside data stays data
+    struct iovec at_data[] = { { .iov_base = (void*)args->data, .iov_len = args->len }, IOV_STR(AT_SOCK_QUIT_STR) };
+    if(__sim7600__link_writev(__sim7600__chan(), at_data, IOV_COUNT(at_data)) < 0)
         return FAILURE;
-    if(sscanf(response_data, "XHTTPCREQ: %d", &status) != 1)
-    {
-        SIM7600_PRINTF("Invalid response format\n");
-        return FAILURE; // Invalid response
-    }
-        
-    if(status < 0)
-        return FAILURE; // Failed to send request
-        
-    return SUCCESS;
+    __sim7600__chan()->trace_txn.bytes_out += args->len + strlen(AT_SOCK_QUIT_STR);
+
+    if( (__sim7600__wait_4response("#XDATAMODE:", AT_SOCK_SEND_TIMEOUT_MS) != SUCCESS) ||
+        (__sim7600__get_resp_int("#XDATAMODE:", &status) != SUCCESS) || (status != 0) )
+        return FAILURE; // Data not handed to the modem
+    return args->len;
 }
 
-/* 
- * If url = "google.com/myurl" Implements [AT#XHTTPCCON=1,\"google.com\",443,12354], waits for a valid reply
- * then implements [AT#XHTTPCREQ=\"POST\",\"/myurl\",\"User-Agent: <agent>\r\n\",\"application/json\","<JSONdata>\"]  where
- * <agent>:     is the contents of agent, with the null terminator removed
- * <JSONdata>:  is the contents of JSONdata, with the null terminator removed. 
- * Returns      0 if ok. Returns -1 if error. Returns response in response char array. 
- * https://developer.nordicsemi.com/nRF_Connect_SDK/doc/latest/nrf/applications/serial_lte_modem/doc/HTTPC_AT_commands.html
-*/
-int sim7600__httpsPOST(char* url, char* JSONdata, char* agent, char* http_response, uint16_t maxlength)
+int __sim7600__sock_recv_job(void* arg)
 {
-    if(__sim7600__httpsPOST_send_req(url, JSONdata, agent) != SUCCESS)
-    {
-        SIM7600_PRINTF("Failed to send HTTP POST request \n");
-        return FAILURE; // Failed to send request
-    }
-    char resp[AT_BUFFER_SIZE] = {0};
-    
-    mailbox__flush(&at_rx_data);
-	
-	vTaskDelay(3000 / portTICK_PERIOD_MS);
+    at_sock_io_args_t* args = (at_sock_io_args_t*)arg;
+    at_sock_t* slot = __sim7600__sock_find(args->sock);
+    if( (slot == NULL) || (slot->on_rx != NULL) )
+        return FAILURE; // Not open, or its data goes to the callback
+    if(__sim7600__sock_select(args->sock) != SUCCESS)
+        return FAILURE;
+    uint32_t timeout_s = MIN((args->timeout_ms + 999) / 1000, AT_SOCK_RECV_MAX_S);
+    if(__sim7600__sock_recv_once(timeout_s, __sim7600__sock_collect, args) == FAILURE)
+        return FAILURE;
+    if(args->dropped != 0)
+        SIM7600_PRINTF("sim7600__sock_recv(), Buffer overflow by %lu \n", (unsigned long)args->dropped);
+    return args->received;
+}
 
-    if (__sim7600__wait_4response("#XHTTPCRSP:0,1", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
+int __sim7600__sock_close_job(void* arg)
+{
+    at_sock_t* slot = __sim7600__sock_find(*(int*)arg);
+    if(slot == NULL)
+        return FAILURE; // Not open
+    if(__sim7600__sock_select(slot->handle) != SUCCESS)
     {
-        SIM7600_PRINTF("Failed to receive full HTTP response within timeout, trying to parse whatever receive... \n");
+        __sim7600__sock_release(slot); // Gone in the modem already, forget it
+        return FAILURE;
     }
+    return __sim7600__sock_release(slot);
+}
 
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
-        
-    #if (TEST_USED_SAMPLE_HTTP_RESP == 1)   // Overwrite resp with sample HTTP response
-    memset(resp, 0, AT_BUFFER_SIZE);
-    strncpy(resp, HTTP_RESP_EXAMPLE, AT_BUFFER_SIZE);
-    #endif /* End of (TEST_USED_SAMPLE_HTTP_RESP == 1) */
-
-
-    int ret_val = __sim7600__https_parse_response(resp, http_response, maxlength - 1);
-    SIM7600_PRINTF("HTTP Response : \n %s\n", http_response);
-    return ret_val;
+/*
+ * Opens a TCP or UDP socket to host:port that stays open across any number of sends, for telemetry without an HTTP
+ * request per message. Received data is handed to on_rx as it arrives (on the modem reader task, or the engine task
+ * for the end-of-stream call with len 0), or left in the modem for sim7600__sock_recv() if on_rx is NULL.
+ * Returns the socket handle if ok. Returns FAILURE if error (no free socket, DNS, connect or handshake failed).
+ */
+int sim7600__sock_open(sim7600_sock_type_t type, bool secure, const char* host, uint16_t port, sim7600_sock_rx_cb_t on_rx, void* ctx)
+{
+    param_check(host != NULL);
+    param_check( (type == SIM7600_SOCK_TCP) || (type == SIM7600_SOCK_UDP) );
+    at_sock_open_args_t args = { .type = type, .secure = secure, .host = host, .port = port, .on_rx = on_rx, .ctx = ctx };
+    return __sim7600__run_job(__func__, __sim7600__sock_open_job, &args, SIM7600_PRIO_NORMAL);
+}
 
+/*
+ * Sends len bytes on the socket. Returns len if ok. Returns FAILURE if error.
+ */
+int sim7600__sock_send(int sock, const void* data, uint16_t len)
+{
+    param_check( (data != NULL) && (len != 0) );
+    at_sock_io_args_t args = { .sock = sock, .data = data, .len = len };
+    return __sim7600__run_job(__func__, __sim7600__sock_send_job, &args, SIM7600_PRIO_NORMAL);
 }
 
-int sim7600__httpsGET(char* url, char* http_response, uint16_t maxlength)
+/*
+ * Waits up to timeout_ms (whole seconds, at most AT_SOCK_RECV_MAX_S, 0 to only take what is buffered) for data on a
+ * socket opened without on_rx. Bytes beyond size are dropped.
+ * Returns the number of bytes stored in buf, 0 if nothing came. Returns FAILURE if error.
+ */
+int sim7600__sock_recv(int sock, uint8_t* buf, uint16_t size, uint32_t timeout_ms)
 {
-    
-     if(__sim7600__httpsGET_send_req(url) != SUCCESS)
-     {
-         SIM7600_PRINTF("Failed to send HTTP GET request \n");
-         return FAILURE; // Failed to send request
-     }
-    char resp[AT_BUFFER_SIZE] = {0};
+    param_check( (buf != NULL) && (size != 0) );
+    at_sock_io_args_t args = { .sock = sock, .buf = buf, .len = size, .timeout_ms = timeout_ms };
+    return __sim7600__run_job(__func__, __sim7600__sock_recv_job, &args, SIM7600_PRIO_NORMAL);
+}
 
-    SIM7600_PRINTF("Waiting for HTTP response... \n");
-    mailbox__flush(&at_rx_data);
+/*
+ * Closes the socket. The handle is released even if the modem does not answer.
+ * Returns SUCCESS if ok. Returns FAILURE if error.
+ */
+int sim7600__sock_close(int sock)
+{
+    return __sim7600__run_job(__func__, __sim7600__sock_close_job, &sock, SIM7600_PRIO_NORMAL);
+}
 
-	vTaskDelay(3000 / portTICK_PERIOD_MS);
-    if (__sim7600__wait_4response("#XHTTPCRSP:0,1", AT_DEFAULT_TIMEOUT_MS) != SUCCESS)
+/*
+ * Copies req->command and req->expected into a free slot and queues it at req->priority. The engine task runs the
+ * queued commands one after the other, so any number of tasks can submit at the same time.
+ * Returns the handle if ok. Returns NULL if error (all AT_CMD_POOL_SIZE slots busy, command or expected too long).
+ */
+sim7600_cmd_t* sim7600__cmd_submit(const sim7600_cmd_req_t* req)
+{
+    if( (req == NULL) || (req->command == NULL) || (req->expected == NULL) ||
+        (strlen(req->command) > SIM7600_CMD_MAX_LEN) || (strlen(req->expected) > AT_PARSER_MAX_EXPECTED_LEN) )
+        return NULL;
+    if(__sim7600__init_link() != SUCCESS)
+        return NULL;
+    sim7600_cmd_t* cmd = __sim7600__cmd_alloc();
+    if(cmd == NULL)
+        return NULL;
+    strcpy(cmd->command, req->command);
+    strcpy(cmd->expected, req->expected);
+    cmd->timeout_ms = req->timeout_ms;
+    cmd->resp = req->resp;
+    cmd->resp_size = req->resp_size;
+    cmd->cb = req->cb;
+    cmd->ctx = req->ctx;
+    if(__sim7600__cmd_queue(cmd, req->priority) != SUCCESS)
     {
-        SIM7600_PRINTF("Failed to receive full HTTP response within timeout, trying to parse whatever receive... \n");
+        __sim7600__cmd_free(cmd);
+        return NULL;
     }
-    int resp_len = __sim7600__get_resp(resp, sizeof(resp));
-    
-    #if (TEST_USED_SAMPLE_HTTP_RESP == 1)   // Overwrite resp with sample HTTP response
-    memset(resp, 0, AT_BUFFER_SIZE);
-    strncpy(resp, HTTP_RESP_EXAMPLE, AT_BUFFER_SIZE);
-    #endif /* End of (TEST_USED_SAMPLE_HTTP_RESP == 1) */
-
-    int ret_val = __sim7600__https_parse_response(resp, http_response, maxlength - 1);
-    SIM7600_PRINTF("HTTP Response : \n %s\n", http_response);
+    return cmd;
+}
 
+/*
+ * Blocks until the command submitted without a callback completes, then releases the handle.
+ * Returns the response length if the expected text was received. Returns FAILURE if error or timeout,
+ * after a timeout the handle stays valid and must be waited for again.
+ */
+int sim7600__cmd_wait(sim7600_cmd_t* cmd, uint32_t timeout_ms)
+{
+    param_check(cmd != NULL);
+    param_check(cmd->in_use && (cmd->cb == NULL));
+    TickType_t ticks = (timeout_ms == SIM7600_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    if(xSemaphoreTake(cmd->done, ticks) != pdTRUE)
+        return FAILURE;
+    int ret_val = (cmd->status == SUCCESS) ? cmd->resp_len : FAILURE;
+    __sim7600__cmd_free(cmd);
     return ret_val;
 }
 
@@ -902,10 +3293,13 @@ extern const char howmyssl_ca[];
 extern const char httpbin_ca[];
 void lte_modem_custom_task(void *pvParameters)
 {
+    static char http_resp_buffer[2048]; // Not on the task stack, see the stack size in main.c
     SIM7600_PRINTF("Testing HTTP Parser started \r\n");
     SIM7600_PRINTF("************************************* START *************************************");
     SIM7600_PRINTF("\n\r");
     SIM7600_PRINTF("\n\r");
+
+    sim7600__negotiate_baudrate(AT_MAX_BAUDRATE, AT_USE_HW_FLOWCTRL);
     
     while(1) 
     {
@@ -916,7 +3310,6 @@ void lte_modem_custom_task(void *pvParameters)
             {
                 SIM7600_PRINTF("[TESTING] HTTPS GET \r\n");
                 char url[] = "howsmyssl.com/a/check";
-                char http_resp_buffer[2048] = {0};
                 sim7600__httpsGET(url , http_resp_buffer, sizeof(http_resp_buffer));
                 SIM7600_PRINTF("\r\n===================================================\r\n");
                 SIM7600_PRINTF("HTTP Response: %s\n", http_resp_buffer);
@@ -927,7 +3320,6 @@ void lte_modem_custom_task(void *pvParameters)
             case 1:
             {
                 SIM7600_PRINTF("[TESTING] HTTPS POST \r\n");
-                char http_resp_buffer[2048] = {0};
                 char agent[] = "slm";
                 char url[] = "httpbin.org/post";
                 char json_data[] = "{\"foo1\":\"bar1\",\"foo2\":\"bar2\"}";
@@ -946,6 +3338,10 @@ void lte_modem_custom_task(void *pvParameters)
             }
         }
         SIM7600_PRINTF("\r\n===================================================\r\n");
+#if (AT_STACK_PROFILE == 1)
+        sim7600__dump_stack_usage();
+#endif /* End of (AT_STACK_PROFILE == 1) */
+        hal__getStackSize();
         g_test = (g_test + 1) % 2;
         vTaskDelay(1000 / portTICK_PERIOD_MS);
     }
@@ -0,0 +1,167 @@
+#ifndef SIM7600_H
+#define SIM7600_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Serial LTE driver for the nRF9160 SLM on the modem UART (AT_DEFAULT_UART_PORT), see nrf_slte.h for the command reference
+/*------------------------------------------------------------------------------*/
+/*							 Includes and dependencies						    */
+/*------------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+/*------------------------------------------------------------------------------*/
+/*					  		   Preprocessor Constants						    */
+/*------------------------------------------------------------------------------*/
+#define SIM7600_CMD_MAX_LEN         (128U)          // Longest command line sim7600__cmd_submit() accepts
+#define SIM7600_WAIT_FOREVER        (0xFFFFFFFFUL)  // sim7600__cmd_wait() timeout
+#define SIM7600_TRACE_VERB_LEN      (15U)           // Longer command verbs are truncated in sim7600_trace_t
+#define SIM7600_TRACE_BUCKETS       (24U)           // Latency histogram buckets, see SIM7600_TRACE_BUCKET_US()
+#define SIM7600_SOCK_MAX            (4U)            // Sockets open at once through sim7600__sock_open()
+
+// Lower bound of histogram bucket b in us: bucket 0 is [0, 8us), bucket b is [4us << b, 8us << b), the last one (from 33.5 s) open-ended
+#define SIM7600_TRACE_BUCKET_US(b)  ((b) == 0 ? 0UL : (4UL << (b)))
+
+/*------------------------------------------------------------------------------*/
+/*							 	    Typedefs								    */
+/*------------------------------------------------------------------------------*/
+// Unsolicited result handler. line is NUL-terminated without the line end and only valid during the call.
+// Runs on the modem reader task: must not block, use sim7600__cmd_submit() with a callback to query the modem from here
+typedef void (*sim7600_urc_cb_t)(const char *line, uint16_t len, void *ctx);
+
+// HTTP response payload piece, len bytes at data (not NUL-terminated, may hold any byte value).
+// Runs on the modem reader task: must not block or call the driver. Return 0 to keep receiving, -1 to drop the rest
+typedef int (*sim7600_http_chunk_cb_t)(const uint8_t *data, uint16_t len, void *ctx);
+
+// Socket data, len bytes at data (not NUL-terminated, may hold any byte value). len 0 (data NULL): the peer closed the
+// connection or the socket failed, close it. Runs on a modem task: must not block or call the driver
+typedef void (*sim7600_sock_rx_cb_t)(int sock, const uint8_t *data, uint16_t len, void *ctx);
+
+typedef enum
+{
+    SIM7600_SOCK_TCP = 1,           // Stream
+    SIM7600_SOCK_UDP = 2,           // Datagram, connected to one peer
+} sim7600_sock_type_t;
+
+typedef enum
+{
+    SIM7600_PRIO_HIGH = 0,          // Short status queries, run before anything queued below
+    SIM7600_PRIO_NORMAL,
+    SIM7600_PRIO_BULK,              // HTTPS transfers
+    SIM7600_PRIO_COUNT
+} sim7600_prio_t;
+
+// HTTP request body source: write up to size bytes of the body to buf. Runs on the modem engine task.
+// Returns the number of bytes written, 0 or -1 aborts the request
+typedef int (*sim7600_http_body_cb_t)(uint8_t *buf, uint16_t size, void *ctx);
+
+typedef struct
+{
+    const char *content_type;       // e.g. "application/json"
+    uint32_t len;                   // Exact body length, sent ahead of the body
+    const void *data;               // Whole body in memory, or NULL to pull it from read
+    sim7600_http_body_cb_t read;
+    void *ctx;
+} sim7600_http_body_t;
+
+// Modem state kept by the driver, see sim7600__set_state_ttl()
+typedef enum
+{
+    SIM7600_STATE_CFUN = 0,         // Functional mode, from sim7600__power_on()/power_off()
+    SIM7600_STATE_REG,              // sim7600__connected(), dropped on +CEREG notifications
+    SIM7600_STATE_RSSI,             // sim7600__get_rssi(), refreshed by %CESQ notifications
+    SIM7600_STATE_SIM,              // sim7600__get_SimPresent()
+    SIM7600_STATE_COUNT
+} sim7600_state_t;
+
+typedef enum
+{
+    SIM7600_TRACE_OK = 0,           // Expected response received
+    SIM7600_TRACE_ERROR,            // ERROR / +CME ERROR / +CMS ERROR, full mailbox or send failure
+    SIM7600_TRACE_TIMEOUT,
+    SIM7600_TRACE_OUTCOMES
+} sim7600_trace_outcome_t;
+
+// Counters of one command verb ("+CESQ", "#XHTTPCCON"...), see sim7600__get_trace(). A transaction runs from sending
+// the command to the last response wait before the next command, e.g. AT#XHTTPCREQ includes the whole HTTP response
+typedef struct
+{
+    char verb[SIM7600_TRACE_VERB_LEN + 1];
+    uint32_t count;
+    uint32_t outcome[SIM7600_TRACE_OUTCOMES];
+    uint32_t first_hist[SIM7600_TRACE_BUCKETS];     // Time to the first response byte, transactions without one are left out
+    uint32_t final_hist[SIM7600_TRACE_BUCKETS];     // Time to the final result (or the timeout)
+    uint64_t first_total_us;
+    uint64_t final_total_us;
+    uint32_t final_max_us;
+    uint64_t bytes_out;                             // Command line and data mode payload
+    uint64_t bytes_in;                              // Response lines and HTTP payload, URCs with a handler excluded
+} sim7600_trace_t;
+
+// Deepest modem engine task stack use of one public function, see sim7600__get_stack_usage()
+typedef struct
+{
+    const char *api;                // Public function, "command" for single commands (status queries, sim7600__cmd_submit())
+    uint32_t calls;
+    uint32_t max_bytes;             // Below the engine loop frame
+} sim7600_stack_usage_t;
+
+typedef struct sim7600_cmd sim7600_cmd_t;
+
+// Command completion. status is 0 if the expected text was received, -1 otherwise. resp is the request buffer (NULL if none).
+// Runs on the modem engine task: the blocking sim7600__ functions run inline from here, sim7600__cmd_wait() must not be used
+typedef void (*sim7600_cmd_cb_t)(sim7600_cmd_t *cmd, int status, char *resp, uint16_t resp_len, void *ctx);
+
+typedef struct
+{
+    const char *command;            // Full command line including "\r\n", copied
+    const char *expected;           // Text that completes the command, e.g. "OK", copied
+    uint16_t timeout_ms;
+    uint8_t priority;               // sim7600_prio_t
+    char *resp;                     // Optional, receives the NUL-terminated response lines. Must stay valid until completion
+    uint16_t resp_size;
+    sim7600_cmd_cb_t cb;            // NULL: collect the result with sim7600__cmd_wait()
+    void *ctx;
+} sim7600_cmd_req_t;
+
+/*-----------------------------------------------------------------------------*/
+/*							    Function prototypes					     	   */
+/*-----------------------------------------------------------------------------*/
+int sim7600__power_on(void); //Implements [AT+CFUN=1]. Returns 0 if ok. Returns -1 if error.
+int sim7600__power_off(void); //Implements [AT+CFUN=0] unless already off. Returns 0 if ok. Returns -1 if error.
+int sim7600__negotiate_baudrate(uint32_t max_baudrate, bool hw_flowctrl); //Moves the modem link to the fastest rate up to max_baudrate that answers. Returns 0 if ok. Returns -1 if the modem does not answer.
+int sim7600__cmux_start(void); //Implements [AT+CMUX=0] and runs the modem link as GSM 07.10 channels: SIM7600_PRIO_HIGH commands get their own channel and engine task, so status queries are answered during transfers. Call after sim7600__negotiate_baudrate(). Returns 0 if ok. Returns -1 if error, the link stays plain AT.
+int sim7600__cmux_stop(void); //Close the multiplexer, the modem link goes back to plain AT commands. Returns 0 if ok. Returns -1 if error.
+int sim7600__get_rssi(void); //Implements [AT+CESQ]. Returns RSSI in dBm, -1 if error.
+int sim7600__connected(void); //Implements [AT+COPS?]. Returns 1 if connected, 0 if not connected, -1 if error.
+int sim7600__get_SimPresent(void); //Implements [AT+CPIN?]. Returns 1 if SIM is ready, -1 if error.
+long sim7600__get_time(void); //Implements [AT#XCARRIER="time"]. Returns seconds since UTC time 0, -1 if error.
+int sim7600__setCA(char* ca); //Implements [AT%CMNG=0,12354,0,"<ca>"] after clearing the old certificate. Returns 0 if ok. Returns -1 if error.
+int sim7600__httpsGET(char* url, char* http_response, uint16_t maxlength); //HTTPS GET of url ("host/path"), reusing the open session to the same host. The NUL-terminated response (headers and body) is meant for text, see sim7600__httpsGET_body(). Returns 0 if ok. Returns -1 if error.
+int sim7600__httpsPOST(char* url, char* JSONdata, char* agent, char* http_response, uint16_t maxlength); //HTTPS POST of JSONdata (any length) to url ("host/path"). Returns 0 if ok. Returns -1 if error.
+int sim7600__httpsGET_body(char* url, uint8_t* body, uint32_t size, int* http_status); //HTTPS GET of url ("host/path") for binary downloads: the body alone, byte exact, its length returned. Returns the body length if ok. Returns -1 if error or the body does not fit.
+int sim7600__httpsGET_range(char* url, uint32_t range_from, sim7600_http_chunk_cb_t on_body, void* ctx, int* http_status); //HTTPS GET of url ("host/path") from body offset range_from on (HTTP Range), the body alone handed to on_body as it arrives. Returns the number of body bytes delivered if ok. Returns -1 if error.
+int sim7600__httpsGET_stream(char* url, sim7600_http_chunk_cb_t on_chunk, void* ctx); //HTTPS GET of url ("host/path"), each response payload piece handed to on_chunk as it arrives, in constant memory. Returns 0 if ok. Returns -1 if error.
+int sim7600__httpsPOST_stream(char* url, char* agent, const sim7600_http_body_t* body, sim7600_http_chunk_cb_t on_chunk, void* ctx); //HTTPS POST of a body of any size, from memory or a read callback, response handed to on_chunk. Returns 0 if ok. Returns -1 if error.
+int sim7600__httpsClose(void); //Implements [AT#XHTTPCCON=0] if a session is open. The HTTPS functions keep the connection for the next request to the same host. Returns 0.
+int sim7600__sock_open(sim7600_sock_type_t type, bool secure, const char* host, uint16_t port, sim7600_sock_rx_cb_t on_rx, void* ctx); //Implements [AT#XSOCKET=1,<type>,0] ([AT#XSSOCKET=...] if secure) and [AT#XCONNECT="<host>",<port>]. Data is pushed to on_rx as it arrives, or pulled with sim7600__sock_recv() if NULL. Returns the socket if ok. Returns -1 if error.
+int sim7600__sock_send(int sock, const void* data, uint16_t len); //Implements [AT#XSEND] in data mode, one datagram for UDP. Returns len if ok. Returns -1 if error.
+int sim7600__sock_recv(int sock, uint8_t* buf, uint16_t size, uint32_t timeout_ms); //Implements [AT#XRECV=<timeout>] for a socket opened without on_rx. Returns the number of bytes received, 0 if none within timeout_ms. Returns -1 if error.
+int sim7600__sock_close(int sock); //Implements [AT#XSOCKET=0]. Returns 0 if ok. Returns -1 if error, the socket is released anyway.
+int sim7600__set_state_ttl(sim7600_state_t field, uint32_t ttl_ms); //How long a cached field answers status queries without asking the modem, 0 to always ask. Returns 0 if ok. Returns -1 if error.
+int sim7600__get_trace(uint8_t idx, sim7600_trace_t* trace); //Copy the counters of the idx-th command verb seen since start-up or sim7600__reset_trace(). Returns 0 if ok. Returns -1 if idx is past the last verb.
+void sim7600__reset_trace(void); //Clear all per-command counters.
+void sim7600__dump_trace(void); //Print count, outcomes, latency percentiles and bytes per command verb, then the non-empty histogram buckets.
+int sim7600__get_stack_usage(uint8_t idx, sim7600_stack_usage_t* usage); //Copy the engine stack use of the idx-th public function run so far. Returns 0 if ok. Returns -1 if idx is past the last one or stack profiling is off.
+void sim7600__dump_stack_usage(void); //Print the engine stack use per public function, the engine task high-water mark and the buffer pool peak.
+int sim7600__register_urc(const char* prefix, sim7600_urc_cb_t cb, void* ctx); //Route lines starting with prefix (e.g. "+CEREG:") to cb instead of the command response. Returns 0 if ok. Returns -1 if error (table full).
+sim7600_cmd_t* sim7600__cmd_submit(const sim7600_cmd_req_t* req); //Queue a command for the modem engine and return at once. Returns a handle, NULL if error (all slots busy, command too long).
+int sim7600__cmd_wait(sim7600_cmd_t* cmd, uint32_t timeout_ms); //Wait for a command submitted without callback and release the handle. Returns the response length if ok, -1 if error. On timeout returns -1 and the handle stays valid.
+void lte_modem_custom_task(void *pvParameters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM7600_H */